@@ -0,0 +1,272 @@
+#include <omp.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "calib_batch.hpp"
+
+namespace yac {
+
+static size_t nb_images(const std::string &image_dir) {
+  std::vector<std::string> image_files;
+  if (list_dir(image_dir, image_files) != 0) {
+    return 0;
+  }
+  return image_files.size();
+}
+
+int calib_batch_job_setup(calib_batch_job_t &job,
+                          const std::string &config_file,
+                          const calib_batch_options_t &opts) {
+  job = calib_batch_job_t{};
+  job.config_file = config_file;
+
+  // Parse calibration config, config_t does not return on a missing file
+  if (file_exists(config_file) == false) {
+    LOG_ERROR("Config file [%s] not found!", config_file.c_str());
+    return -1;
+  }
+  config_t config{config_file};
+  if (config.ok == false) {
+    LOG_ERROR("Failed to load config file [%s]!", config_file.c_str());
+    return -1;
+  }
+  std::string data_path;
+  bool imshow = false;
+  if (parse(config, "settings.data_path", data_path) != 0 ||
+      parse(config, "settings.results_fpath", job.results_fpath) != 0) {
+    LOG_ERROR("Failed to parse settings in [%s]!", config_file.c_str());
+    return -1;
+  }
+  parse(config, "settings.imshow", imshow, true);
+  if (imshow) {
+    LOG_ERROR("Batch calibration requires settings.imshow: false in [%s]!",
+              config_file.c_str());
+    return -1;
+  }
+
+  calib_target_t calib_target;
+  if (calib_target_load(calib_target, config_file, "calib_target") != 0) {
+    LOG_ERROR("Failed to load calib target in [%s]!", config_file.c_str());
+    return -1;
+  }
+
+  calib_solver_options_t solver_opts;
+  if (calib_solver_options_load(solver_opts, config_file) != 0) {
+    LOG_ERROR("Failed to load solver options in [%s]!", config_file.c_str());
+    return -1;
+  }
+
+  // Mono or stereo calibration, reserve one thread per camera or the solver
+  // threads if more, at most the whole budget. The solver is clamped to the
+  // reservation when the job runs.
+  const bool stereo = (yaml_has_key(config, "cam1") == 0);
+  const int nb_cams = (stereo) ? 2 : 1;
+  const int threads = std::max(nb_cams, solver_opts.num_threads);
+  job.type = (stereo) ? "stereo" : "mono";
+  job.threads = std::min(threads, std::max(opts.max_threads, 1));
+  if (threads > job.threads) {
+    LOG_WARN("[%s] solver.num_threads clamped to %d!",
+             config_file.c_str(),
+             job.threads);
+  }
+
+  // Estimate peak memory: the image being processed plus the corners of all
+  // images, kept as AprilGrids and residual blocks during the solve
+  const size_t nb_tags = calib_target.tag_rows * calib_target.tag_cols;
+  for (int i = 0; i < nb_cams; i++) {
+    const std::string cam = "cam" + std::to_string(i);
+    vec2_t resolution{0.0, 0.0};
+    if (parse(config, cam + ".resolution", resolution) != 0) {
+      LOG_ERROR("Failed to parse [%s] in [%s]!", cam.c_str(),
+                config_file.c_str());
+      return -1;
+    }
+    const size_t image_memory = resolution(0) * resolution(1) * 3;
+    const size_t image_dir_size = nb_images(data_path + "/" + cam + "/data");
+    job.memory += image_memory;
+    job.memory += image_dir_size * nb_tags * 4 * opts.corner_memory;
+  }
+
+  return 0;
+}
+
+static void calib_batch_job_run(calib_batch_job_t &job) {
+  // Bound OpenMP and solver threads of this job to its reservation
+  omp_set_num_threads(job.threads);
+
+  LOG_INFO("Calibrating [%s]", job.config_file.c_str());
+  struct timespec t_start = tic();
+  if (job.type == "stereo") {
+    job.retval = calib_stereo_solve(job.config_file);
+  } else {
+    job.retval = calib_mono_solve(job.config_file);
+  }
+  job.time = toc(&t_start);
+
+  if (job.retval != 0) {
+    LOG_ERROR("Failed to calibrate [%s]!", job.config_file.c_str());
+  }
+}
+
+int calib_batch_run(const std::vector<std::string> &configs,
+                    const calib_batch_options_t &opts,
+                    std::vector<calib_batch_job_t> &jobs) {
+  struct timespec t_start = tic();
+  jobs.clear();
+  jobs.resize(configs.size());
+
+  // Resources in use by running jobs
+  std::mutex mutex;
+  std::condition_variable resources_freed;
+  int threads_used = 0;
+  size_t memory_used = 0;
+  size_t nb_running = 0;
+
+  // Start jobs in order once they fit in the budget
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < configs.size(); i++) {
+    calib_batch_job_t &job = jobs[i];
+    if (calib_batch_job_setup(job, configs[i], opts) != 0) {
+      LOG_ERROR("Failed to setup batch job [%s]!", configs[i].c_str());
+      job.retval = -1;
+      continue;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      resources_freed.wait(lock, [&]() {
+        const int threads = threads_used + job.threads;
+        const size_t memory = memory_used + job.memory;
+        const bool threads_ok = (threads <= opts.max_threads);
+        const bool memory_ok = (memory <= opts.max_memory);
+        return nb_running == 0 || (threads_ok && memory_ok);
+      });
+      if (job.memory > opts.max_memory) {
+        LOG_WARN("[%s] exceeds the memory budget, running it alone!",
+                 job.config_file.c_str());
+      }
+      threads_used += job.threads;
+      memory_used += job.memory;
+      nb_running++;
+    }
+
+    workers.emplace_back([&job, &mutex, &resources_freed, &threads_used,
+                          &memory_used, &nb_running]() {
+      calib_batch_job_run(job);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      threads_used -= job.threads;
+      memory_used -= job.memory;
+      nb_running--;
+      resources_freed.notify_all();
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  // Summary
+  size_t nb_failed = 0;
+  for (const auto &job : jobs) {
+    nb_failed += (job.retval == 0) ? 0 : 1;
+  }
+  const real_t total_time = toc(&t_start);
+  LOG_INFO("Batch calibration of %zu configs took %f [s], %zu failed",
+           jobs.size(), total_time, nb_failed);
+  if (opts.summary_fpath != "") {
+    if (calib_batch_save_summary(opts.summary_fpath, jobs, total_time) != 0) {
+      LOG_ERROR("Failed to save summary to [%s]!", opts.summary_fpath.c_str());
+      return -1;
+    }
+  }
+
+  return (nb_failed == 0) ? 0 : -1;
+}
+
+int calib_batch_save_summary(const std::string &save_path,
+                             const std::vector<calib_batch_job_t> &jobs,
+                             const real_t total_time) {
+  // Open summary file
+  FILE *outfile = fopen(save_path.c_str(), "w");
+  if (outfile == NULL) {
+    return -1;
+  }
+
+  size_t nb_failed = 0;
+  for (const auto &job : jobs) {
+    nb_failed += (job.retval == 0) ? 0 : 1;
+  }
+  fprintf(outfile, "nb_jobs: %zu\n", jobs.size());
+  fprintf(outfile, "nb_failed: %zu\n", nb_failed);
+  fprintf(outfile, "total_time: %f  # [s]\n", total_time);
+  fprintf(outfile, "\n");
+
+  // Save outcome of each job, with the calibrated camera parameters
+  fprintf(outfile, "jobs:\n");
+  for (const auto &job : jobs) {
+    const char *status = (job.retval == 0) ? "ok" : "failed";
+    fprintf(outfile, "  - config_file: \"%s\"\n", job.config_file.c_str());
+    fprintf(outfile, "    type: \"%s\"\n", job.type.c_str());
+    fprintf(outfile, "    status: \"%s\"\n", status);
+    fprintf(outfile, "    time: %f  # [s]\n", job.time);
+    fprintf(outfile, "    threads: %d\n", job.threads);
+    fprintf(outfile, "    memory_estimate: %zu  # [bytes]\n", job.memory);
+    fprintf(outfile, "    results_fpath: \"%s\"\n", job.results_fpath.c_str());
+    if (job.retval != 0) {
+      continue;
+    }
+
+    const int nb_cams = (job.type == "stereo") ? 2 : 1;
+    for (int i = 0; i < nb_cams; i++) {
+      const std::string cam = "cam" + std::to_string(i);
+      calib_params_t params;
+      if (calib_params_load(params, job.results_fpath, cam) != 0) {
+        continue;
+      }
+      const auto proj_params = vec2str(params.proj_params);
+      const auto dist_params = vec2str(params.dist_params);
+      fprintf(outfile, "    %s_proj_params: %s\n", cam.c_str(),
+              proj_params.c_str());
+      fprintf(outfile, "    %s_dist_params: %s\n", cam.c_str(),
+              dist_params.c_str());
+    }
+  }
+
+  // Finish up
+  fclose(outfile);
+
+  return 0;
+}
+
+int calib_batch_solve(const std::string &config_file) {
+  // Parse batch config
+  std::vector<std::string> configs;
+  calib_batch_options_t opts;
+  real_t max_memory = opts.max_memory / 1e9;
+  if (file_exists(config_file) == false) {
+    LOG_ERROR("Config file [%s] not found!", config_file.c_str());
+    return -1;
+  }
+  config_t config{config_file};
+  if (config.ok == false) {
+    LOG_ERROR("Failed to load config file [%s]!", config_file.c_str());
+    return -1;
+  }
+  if (parse(config, "settings.configs", configs) != 0 ||
+      parse(config, "settings.summary_fpath", opts.summary_fpath) != 0) {
+    LOG_ERROR("Failed to parse settings in [%s]!", config_file.c_str());
+    return -1;
+  }
+  parse(config, "settings.max_threads", opts.max_threads, true);
+  parse(config, "settings.max_memory", max_memory, true);
+  parse(config, "settings.corner_memory", opts.corner_memory, true);
+  opts.max_memory = max_memory * 1e9;
+
+  // Calibrate
+  std::vector<calib_batch_job_t> jobs;
+  return calib_batch_run(configs, opts, jobs);
+}
+
+} //  namespace yac
@@ -0,0 +1,103 @@
+#ifndef YAC_CALIB_BATCH_HPP
+#define YAC_CALIB_BATCH_HPP
+
+#include <iostream>
+#include <string>
+#include <memory>
+
+#include "core.hpp"
+#include "calib_data.hpp"
+#include "calib_mono.hpp"
+#include "calib_stereo.hpp"
+
+namespace yac {
+
+/**
+ * Batch calibration options. Jobs run concurrently as long as the sum of
+ * their threads and estimated memory stays within `max_threads` and
+ * `max_memory`. A job that exceeds the budget on its own runs alone.
+ */
+struct calib_batch_options_t {
+  int max_threads = 4;            ///< Thread budget shared by all jobs
+  size_t max_memory = 4e9;        ///< Memory budget [bytes]
+  size_t corner_memory = 2048;    ///< Memory estimate per corner [bytes]
+  std::string summary_fpath = ""; ///< Consolidated summary output
+
+  calib_batch_options_t() {}
+  ~calib_batch_options_t() {}
+};
+
+/**
+ * Batch calibration job, one per calibration config file.
+ */
+struct calib_batch_job_t {
+  std::string config_file;
+  std::string type;          ///< "mono" or "stereo"
+  std::string results_fpath; ///< Results file written by the solve
+  int threads = 1;           ///< Threads reserved for cameras and solver
+  size_t memory = 0;         ///< Estimated peak memory [bytes]
+
+  int retval = -1;           ///< Return value of the solve
+  real_t time = 0.0;         ///< Wall-clock time taken [s]
+
+  calib_batch_job_t() {}
+  ~calib_batch_job_t() {}
+};
+
+/**
+ * Setup batch calibration `job` from calibration config file `config_file`,
+ * see `calib_mono_solve()` and `calib_stereo_solve()`. The config is a stereo
+ * calibration if it has a `cam1` entry. The job reserves one thread per camera
+ * or `solver.num_threads` if more, at most `max_threads`. The peak memory is
+ * estimated from the largest image and the number of corners the captured
+ * images may yield, assuming `corner_memory` bytes per corner. Interactive
+ * settings are rejected, `settings.imshow` must be false for batch
+ * calibration. A missing config file or settings entry fails the setup,
+ * leaving `job` marked failed.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_batch_job_setup(calib_batch_job_t &job,
+                          const std::string &config_file,
+                          const calib_batch_options_t &opts =
+                              calib_batch_options_t());
+
+/**
+ * Run calibration `configs` concurrently within the thread and memory budget
+ * in `opts`, starting them in order. Each job limits its OpenMP threads
+ * (preprocessing, stereo stage 1) and solver threads to the threads it
+ * reserved. The outcome of every config is returned in `jobs`, and written as
+ * a yaml summary to `opts.summary_fpath` if set.
+ *
+ * @returns 0 if all calibrations succeeded, else -1
+ */
+int calib_batch_run(const std::vector<std::string> &configs,
+                    const calib_batch_options_t &opts,
+                    std::vector<calib_batch_job_t> &jobs);
+
+/**
+ * Save consolidated summary of batch calibration `jobs` to `save_path`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_batch_save_summary(const std::string &save_path,
+                             const std::vector<calib_batch_job_t> &jobs,
+                             const real_t total_time);
+
+/**
+ * Run batch calibration. This function assumes that the path to
+ * `config_file` is a yaml file of the form:
+ *
+ *     settings:
+ *       configs: ["/data/unit0/calib.yaml", "/data/unit1/calib.yaml"]
+ *       summary_fpath: "/data/batch_summary.yaml"
+ *       max_threads: 8         # Optional
+ *       max_memory: 8.0        # Optional [GB]
+ *       corner_memory: 2048    # Optional [bytes]
+ *
+ * @returns 0 if all calibrations succeeded, else -1
+ */
+int calib_batch_solve(const std::string &config_file);
+
+} //  namespace yac
+#endif // YAC_CALIB_BATCH_HPP
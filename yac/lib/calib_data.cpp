@@ -20,6 +20,476 @@ int calib_target_load(calib_target_t &ct,
   return 0;
 }
 
+int calib_camera_model(const calib_params_t &params, camera_model_t &model) {
+  if (params.proj_model == "pinhole" && params.dist_model == "radtan4") {
+    model = PINHOLE_RADTAN4;
+  } else if (params.proj_model == "pinhole" && params.dist_model == "equi4") {
+    model = PINHOLE_EQUI4;
+  } else if (params.proj_model == "double_sphere" &&
+             params.dist_model == "none") {
+    model = DOUBLE_SPHERE;
+  } else {
+    LOG_ERROR("Unsupported [%s-%s] projection distortion combination!",
+              params.proj_model.c_str(),
+              params.dist_model.c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+int camera_dist_params_size(const camera_model_t model) {
+  return (model == DOUBLE_SPHERE) ? 2 : 4;
+}
+
+static int double_sphere_project(const double *proj_params,
+                                 const double *dist_params,
+                                 const vec3_t &p_C,
+                                 vec2_t &z_hat,
+                                 mat_t<2, 3> &J_point,
+                                 mat_t<2, 4> &J_proj,
+                                 mat_t<2, 4> &J_dist) {
+  const real_t fx = proj_params[0];
+  const real_t fy = proj_params[1];
+  const real_t cx = proj_params[2];
+  const real_t cy = proj_params[3];
+  const real_t xi = dist_params[0];
+  const real_t alpha = dist_params[1];
+
+  // Project, see double_sphere_project()
+  const Eigen::Matrix<real_t, 8, 1> params =
+      (Eigen::Matrix<real_t, 8, 1>() << fx, fy, cx, cy, xi, alpha, 0.0, 0.0)
+          .finished();
+  if (double_sphere_project(params, p_C, z_hat) != 0) {
+    return -1;
+  }
+  const real_t x = p_C(0);
+  const real_t y = p_C(1);
+  const real_t z = p_C(2);
+  const real_t d1 = p_C.norm();
+  const real_t zz = xi * d1 + z;
+  const real_t d2 = sqrt(x * x + y * y + zz * zz);
+  const real_t denom = alpha * d2 + (1.0 - alpha) * zz;
+  const real_t mx = x / denom;
+  const real_t my = y / denom;
+
+  // Jacobian of denominator w.r.t. point
+  const vec3_t d1_p = p_C / d1;
+  const vec3_t zz_p = xi * d1_p + vec3_t{0.0, 0.0, 1.0};
+  const vec3_t d2_p = (vec3_t{x, y, 0.0} + zz * zz_p) / d2;
+  const vec3_t denom_p = alpha * d2_p + (1.0 - alpha) * zz_p;
+  J_point.row(0) = fx * (vec3_t{1.0, 0.0, 0.0} - mx * denom_p).transpose();
+  J_point.row(1) = fy * (vec3_t{0.0, 1.0, 0.0} - my * denom_p).transpose();
+  J_point /= denom;
+
+  // Jacobian w.r.t. projection and distortion (xi, alpha) parameters
+  const real_t denom_xi = (alpha * zz / d2 + (1.0 - alpha)) * d1;
+  const real_t denom_alpha = d2 - zz;
+  J_proj << mx, 0.0, 1.0, 0.0,
+            0.0, my, 0.0, 1.0;
+  J_dist << -fx * mx * denom_xi, -fx * mx * denom_alpha, 0.0, 0.0,
+            -fy * my * denom_xi, -fy * my * denom_alpha, 0.0, 0.0;
+  J_dist /= denom;
+
+  return 0;
+}
+
+int camera_project(const camera_model_t model,
+                   const double *proj_params,
+                   const double *dist_params,
+                   const vec3_t &p_C,
+                   vec2_t &z_hat,
+                   mat_t<2, 3> &J_point,
+                   mat_t<2, 4> &J_proj,
+                   mat_t<2, 4> &J_dist) {
+  // Dispatch once to the statically typed camera model, its per point math is
+  // inlined
+  switch (model) {
+  case PINHOLE_RADTAN4: {
+    const pinhole_radtan4_t cam{0, 0, proj_params, dist_params};
+    return cam.project_jacobians(p_C, z_hat, J_point, J_proj, J_dist);
+  }
+  case PINHOLE_EQUI4: {
+    // Equi-distant distortion is undefined on the optical axis
+    if (p_C.head<2>().norm() < 1e-8 * fabs(p_C(2))) {
+      return -1;
+    }
+    const pinhole_equi4_t cam{0, 0, proj_params, dist_params};
+    return cam.project_jacobians(p_C, z_hat, J_point, J_proj, J_dist);
+  }
+  case DOUBLE_SPHERE:
+    return double_sphere_project(proj_params, dist_params, p_C, z_hat,
+                                 J_point, J_proj, J_dist);
+  default: return -1;
+  }
+}
+
+int camera_project_batch(const camera_model_t model,
+                         const double *proj_params,
+                         const double *dist_params,
+                         const size_t n,
+                         const real_t *x,
+                         const real_t *y,
+                         const real_t *z,
+                         real_t *u,
+                         real_t *v,
+                         uint8_t *valid) {
+  const real_t params[8] = {proj_params[0], proj_params[1],
+                            proj_params[2], proj_params[3],
+                            dist_params[0], dist_params[1],
+                            dist_params[2], dist_params[3]};
+
+  switch (model) {
+  case PINHOLE_RADTAN4:
+    pinhole_radtan4_project_batch(params, n, x, y, z, u, v, valid);
+    return 0;
+  case PINHOLE_EQUI4:
+    pinhole_equi4_project_batch(params, n, x, y, z, u, v, valid);
+    return 0;
+  case DOUBLE_SPHERE:
+    double_sphere_project_batch(params, n, x, y, z, u, v, valid);
+    return 0;
+  default: return -1;
+  }
+}
+
+size_t camera_undistort_batch(const camera_model_t model,
+                              const double *proj_params,
+                              const double *dist_params,
+                              const size_t n,
+                              const real_t *u,
+                              const real_t *v,
+                              real_t *x,
+                              real_t *y,
+                              uint8_t *converged) {
+  const real_t params[8] = {proj_params[0], proj_params[1],
+                            proj_params[2], proj_params[3],
+                            dist_params[0], dist_params[1],
+                            dist_params[2], dist_params[3]};
+
+  switch (model) {
+  case PINHOLE_RADTAN4:
+    return pinhole_radtan4_undistort_batch(params, n, u, v, x, y, converged);
+  case PINHOLE_EQUI4:
+    return pinhole_equi4_undistort_batch(params, n, u, v, x, y, converged);
+  case DOUBLE_SPHERE:
+    return double_sphere_undistort_batch(params, n, u, v, x, y, converged);
+  default:
+    LOG_ERROR("Unsupported camera model [%d]!", model);
+    std::fill(converged, converged + n, 0);
+    return 0;
+  }
+}
+
+int calib_params_load(calib_params_t &params,
+                      const std::string &config_file,
+                      const std::string &prefix) {
+  config_t config{config_file};
+  if (config.ok == false) {
+    LOG_ERROR("Failed to load calib file [%s]!", config_file.c_str());
+    return -1;
+  }
+
+  vec2_t resolution;
+  int retval = 0;
+  retval += parse(config, prefix + ".resolution", resolution);
+  retval += parse(config, prefix + ".proj_model", params.proj_model);
+  retval += parse(config, prefix + ".dist_model", params.dist_model);
+  retval += parse(config, prefix + ".proj_params", params.proj_params);
+  retval += parse(config, prefix + ".dist_params", params.dist_params);
+  if (retval != 0) {
+    LOG_ERROR("Failed to parse [%s] in [%s]!",
+              prefix.c_str(),
+              config_file.c_str());
+    return -1;
+  }
+  params.img_w = resolution(0);
+  params.img_h = resolution(1);
+
+  // Double sphere results only list xi and alpha, pad the unused parameters
+  camera_model_t model;
+  if (calib_camera_model(params, model) == 0 && model == DOUBLE_SPHERE &&
+      params.dist_params.size() == 2) {
+    params.dist_params.conservativeResize(4);
+    params.dist_params.tail(2).setZero();
+  }
+
+  return 0;
+}
+
+int calib_obs_init(calib_obs_t &obs, const aprilgrids_t &aprilgrids) {
+  obs = calib_obs_t{};
+
+  for (const auto &grid : aprilgrids) {
+    obs.timestamps.push_back(grid.timestamp);
+    obs.frame_offsets.push_back(obs.keypoints.size());
+
+    for (size_t i = 0; i < grid.ids.size(); i++) {
+      const int tag_id = grid.ids[i];
+      vec3s_t object_points;
+      if (aprilgrid_object_points(grid, tag_id, object_points) != 0) {
+        LOG_ERROR("Failed to calculate AprilGrid object points!");
+        return -1;
+      }
+
+      for (int j = 0; j < 4; j++) {
+        obs.tag_ids.push_back(tag_id);
+        obs.corner_ids.push_back(j);
+        obs.keypoints.push_back(grid.keypoints[(i * 4) + j]);
+        obs.object_points.push_back(object_points[j]);
+      }
+    }
+  }
+  obs.frame_offsets.push_back(obs.keypoints.size());
+
+  return 0;
+}
+
+int calib_reproj_errors(const calib_obs_t &obs,
+                        const size_t frame_idx,
+                        const camera_model_t model,
+                        const double *proj_params,
+                        const double *dist_params,
+                        const mat4_t &T_CF,
+                        vec2s_t &errors,
+                        calib_reproj_buffers_t *buf) {
+  calib_reproj_buffers_t buf_local;
+  calib_reproj_buffers_t &b = (buf) ? *buf : buf_local;
+  errors.clear();
+  if (calib_reproj_errors(obs,
+                          frame_idx,
+                          model,
+                          proj_params,
+                          dist_params,
+                          T_CF,
+                          b.errors,
+                          b.valid,
+                          &b) != 0) {
+    return -1;
+  }
+
+  errors.reserve(b.errors.size());
+  for (size_t i = 0; i < b.errors.size(); i++) {
+    if (b.valid[i]) {
+      errors.push_back(b.errors[i]);
+    }
+  }
+
+  return 0;
+}
+
+int calib_reproj_errors(const calib_obs_t &obs,
+                        const size_t frame_idx,
+                        const camera_model_t model,
+                        const double *proj_params,
+                        const double *dist_params,
+                        const mat4_t &T_CF,
+                        vec2s_t &errors,
+                        std::vector<uint8_t> &valid,
+                        calib_reproj_buffers_t *buf) {
+  calib_reproj_buffers_t buf_local;
+  calib_reproj_buffers_t &b = (buf) ? *buf : buf_local;
+  const size_t start = obs.frame_offsets[frame_idx];
+  const size_t n = obs.frame_offsets[frame_idx + 1] - start;
+  errors.resize(n);
+  valid.resize(n);
+  b.x.resize(n);
+  b.y.resize(n);
+  b.z.resize(n);
+  b.u.resize(n);
+  b.v.resize(n);
+
+  // Transform object points to camera frame, structure-of-arrays layout
+  const mat3_t C_CF = tf_rot(T_CF);
+  const vec3_t r_CF = tf_trans(T_CF);
+  for (size_t i = 0; i < n; i++) {
+    const vec3_t p_C = C_CF * obs.object_points[start + i] + r_CF;
+    b.x[i] = p_C(0);
+    b.y[i] = p_C(1);
+    b.z[i] = p_C(2);
+  }
+
+  // Project
+  if (camera_project_batch(model, proj_params, dist_params, n,
+                           b.x.data(), b.y.data(), b.z.data(),
+                           b.u.data(), b.v.data(), valid.data()) != 0) {
+    LOG_ERROR("Unsupported camera model!");
+    return -1;
+  }
+
+  // Reprojection errors
+  for (size_t i = 0; i < n; i++) {
+    const vec2_t &z_meas = obs.keypoints[start + i];
+    errors[i] = vec2_t{z_meas(0) - b.u[i], z_meas(1) - b.v[i]};
+  }
+
+  return 0;
+}
+
+int calib_stats_init(calib_stats_t &stats,
+                     const calib_obs_t &obs,
+                     const calib_params_t &cam,
+                     const mat4s_t &poses,
+                     const int grid_rows,
+                     const int grid_cols) {
+  camera_model_t model;
+  if (calib_camera_model(cam, model) != 0) {
+    return -1;
+  }
+  if (poses.size() != obs.nb_frames() || grid_rows < 1 || grid_cols < 1) {
+    LOG_ERROR("Invalid poses or image region grid size!");
+    return -1;
+  }
+
+  const size_t nb_frames = obs.nb_frames();
+  stats = calib_stats_t{};
+  stats.corner_errors.resize(obs.nb_corners());
+  stats.frame_nb_residuals.resize(nb_frames, 0);
+  stats.frame_rmse.resize(nb_frames, 0.0);
+  stats.grid_rows = grid_rows;
+  stats.grid_cols = grid_cols;
+
+  // Reprojection errors of all corners, frame by frame in parallel. Frames
+  // write to disjoint ranges of the corner errors.
+  const real_t nan = std::numeric_limits<real_t>::quiet_NaN();
+  int retval = 0;
+#pragma omp parallel
+  {
+    calib_reproj_buffers_t buf;
+    vec2s_t errors;
+    std::vector<uint8_t> valid;
+#pragma omp for schedule(dynamic)
+    for (size_t k = 0; k < nb_frames; k++) {
+      if (calib_reproj_errors(obs,
+                              k,
+                              model,
+                              cam.proj_params.data(),
+                              cam.dist_params.data(),
+                              poses[k],
+                              errors,
+                              valid,
+                              &buf) != 0) {
+#pragma omp atomic write
+        retval = -1;
+        continue;
+      }
+
+      const size_t start = obs.frame_offsets[k];
+      real_t err_sq_sum = 0.0;
+      size_t nb_residuals = 0;
+      for (size_t i = 0; i < errors.size(); i++) {
+        const real_t err = (valid[i]) ? errors[i].norm() : nan;
+        stats.corner_errors[start + i] = err;
+        if (valid[i]) {
+          err_sq_sum += err * err;
+          nb_residuals++;
+        }
+      }
+      stats.frame_nb_residuals[k] = nb_residuals;
+      stats.frame_rmse[k] =
+          (nb_residuals) ? sqrt(err_sq_sum / nb_residuals) : 0;
+    }
+  }
+  if (retval != 0) {
+    return -1;
+  }
+
+  // Global, per tag and per image region breakdowns
+  const real_t cell_w = (real_t) cam.img_w / grid_cols;
+  const real_t cell_h = (real_t) cam.img_h / grid_rows;
+  std::map<int, real_t> tag_err_sq;
+  matx_t grid_err_sq = zeros(grid_rows, grid_cols);
+  stats.grid_nb_residuals = zeros(grid_rows, grid_cols);
+  real_t err_sum = 0.0;
+  real_t err_sq_sum = 0.0;
+  for (size_t i = 0; i < obs.nb_corners(); i++) {
+    const real_t err = stats.corner_errors[i];
+    if (std::isnan(err)) {
+      continue;
+    }
+    stats.nb_residuals++;
+    stats.max = std::max(stats.max, err);
+    err_sum += err;
+    err_sq_sum += err * err;
+
+    const int tag_id = obs.tag_ids[i];
+    stats.tag_nb_residuals[tag_id]++;
+    tag_err_sq[tag_id] += err * err;
+
+    const vec2_t &z = obs.keypoints[i];
+    const int col = std::min(std::max((int) (z(0) / cell_w), 0), grid_cols - 1);
+    const int row = std::min(std::max((int) (z(1) / cell_h), 0), grid_rows - 1);
+    stats.grid_nb_residuals(row, col) += 1.0;
+    grid_err_sq(row, col) += err * err;
+  }
+
+  if (stats.nb_residuals) {
+    stats.mean = err_sum / stats.nb_residuals;
+    stats.rmse = sqrt(err_sq_sum / stats.nb_residuals);
+  }
+  for (const auto &kv : stats.tag_nb_residuals) {
+    stats.tag_rmse[kv.first] = sqrt(tag_err_sq[kv.first] / kv.second);
+  }
+  stats.grid_rmse = zeros(grid_rows, grid_cols);
+  for (int r = 0; r < grid_rows; r++) {
+    for (int c = 0; c < grid_cols; c++) {
+      const real_t nb = stats.grid_nb_residuals(r, c);
+      stats.grid_rmse(r, c) = (nb > 0) ? sqrt(grid_err_sq(r, c) / nb) : 0.0;
+    }
+  }
+
+  return 0;
+}
+
+void calib_stats_print(const calib_stats_t &stats, const size_t top_n) {
+  printf("nb_residuals: %zu\n", stats.nb_residuals);
+  printf("RMSE Reprojection Error [px]: %f\n", stats.rmse);
+  printf("Mean Reprojection Error [px]: %f\n", stats.mean);
+  printf("Max Reprojection Error [px]: %f\n", stats.max);
+
+  // Worst frames
+  std::vector<size_t> frames(stats.frame_rmse.size());
+  std::iota(frames.begin(), frames.end(), 0);
+  std::stable_sort(frames.begin(), frames.end(), [&](size_t a, size_t b) {
+    return stats.frame_rmse[a] > stats.frame_rmse[b];
+  });
+  printf("Worst frames [px]:\n");
+  for (size_t i = 0; i < std::min(top_n, frames.size()); i++) {
+    const size_t k = frames[i];
+    printf("  frame %zu: %f (%zu residuals)\n",
+           k,
+           stats.frame_rmse[k],
+           stats.frame_nb_residuals[k]);
+  }
+
+  // Worst tags
+  std::vector<std::pair<int, real_t>> tags(stats.tag_rmse.begin(),
+                                           stats.tag_rmse.end());
+  typedef std::pair<int, real_t> tag_rmse_t;
+  std::stable_sort(tags.begin(),
+                   tags.end(),
+                   [](const tag_rmse_t &a, const tag_rmse_t &b) {
+                     return a.second > b.second;
+                   });
+  printf("Worst tags [px]:\n");
+  for (size_t i = 0; i < std::min(top_n, tags.size()); i++) {
+    printf("  tag %d: %f (%zu residuals)\n",
+           tags[i].first,
+           tags[i].second,
+           stats.tag_nb_residuals.at(tags[i].first));
+  }
+
+  // Image region heatmap
+  printf("Image region RMSE [px]:\n");
+  for (int r = 0; r < stats.grid_rows; r++) {
+    printf(" ");
+    for (int c = 0; c < stats.grid_cols; c++) {
+      printf(" %6.3f", stats.grid_rmse(r, c));
+    }
+    printf("\n");
+  }
+}
+
 static int get_camera_image_paths(const std::string &image_dir,
                                   std::vector<std::string> &image_paths) {
   // Check image dir
@@ -267,10 +737,19 @@ void extract_common_calib_data(aprilgrids_t &grids0, aprilgrids_t &grids1) {
   grids1 = final_grids1;
 }
 
+static aprilgrid_t empty_aprilgrid(const aprilgrid_t &grid) {
+  return aprilgrid_t{grid.timestamp,
+                     grid.tag_rows,
+                     grid.tag_cols,
+                     grid.tag_size,
+                     grid.tag_spacing};
+}
+
 int load_stereo_calib_data(const std::string &cam0_data_dir,
                            const std::string &cam1_data_dir,
                            aprilgrids_t &cam0_aprilgrids,
-                           aprilgrids_t &cam1_aprilgrids) {
+                           aprilgrids_t &cam1_aprilgrids,
+                           const bool common_only) {
   int retval = 0;
 
   // Load cam0 calibration data
@@ -289,6 +768,34 @@ int load_stereo_calib_data(const std::string &cam0_data_dir,
     return -1;
   }
 
+  // Pair all calibration data by timestamp, frames observed by only one
+  // camera are paired with an empty aprilgrid
+  if (common_only == false) {
+    size_t cam0_idx = 0;
+    size_t cam1_idx = 0;
+    while (cam0_idx < grids0.size() || cam1_idx < grids1.size()) {
+      const bool cam0_ok = (cam0_idx < grids0.size());
+      const bool cam1_ok = (cam1_idx < grids1.size());
+      if (cam0_ok && cam1_ok &&
+          grids0[cam0_idx].timestamp == grids1[cam1_idx].timestamp) {
+        cam0_aprilgrids.emplace_back(grids0[cam0_idx++]);
+        cam1_aprilgrids.emplace_back(grids1[cam1_idx++]);
+      } else if (cam0_ok && (cam1_ok == false ||
+                             grids0[cam0_idx].timestamp <
+                                 grids1[cam1_idx].timestamp)) {
+        cam0_aprilgrids.emplace_back(grids0[cam0_idx]);
+        cam1_aprilgrids.emplace_back(empty_aprilgrid(grids0[cam0_idx]));
+        cam0_idx++;
+      } else {
+        cam0_aprilgrids.emplace_back(empty_aprilgrid(grids1[cam1_idx]));
+        cam1_aprilgrids.emplace_back(grids1[cam1_idx]);
+        cam1_idx++;
+      }
+    }
+
+    return 0;
+  }
+
   // Loop through both sets of calibration data and only keep apriltags that
   // are seen by both cameras
   size_t nb_detections = std::max(grids0.size(), grids1.size());
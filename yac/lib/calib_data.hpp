@@ -2,6 +2,10 @@
 #define YAC_CALIB_DATA_HPP
 
 #include <string>
+#include <map>
+#include <limits>
+#include <numeric>
+#include <algorithm>
 
 #include <opencv2/calib3d/calib3d.hpp>
 
@@ -62,7 +66,9 @@ struct calib_pose_t {
 };
 
 /**
- * Calibration parameters
+ * Calibration parameters. The double sphere model ("double_sphere" - "none")
+ * keeps its `xi` and `alpha` as the first two of four `dist_params`, the
+ * remaining two are unused and stay zero.
  */
 struct calib_params_t {
   int img_w;
@@ -100,7 +106,11 @@ struct calib_params_t {
     proj_params.resize(4);
     dist_params.resize(4);
     proj_params << fx, fy, cx, cy;
-    dist_params << 0.01, 0.0001, 0.0001, 0.0001;
+    if (proj_model == "double_sphere") {
+      dist_params << 0.0, 0.5, 0.0, 0.0;
+    } else {
+      dist_params << 0.01, 0.0001, 0.0001, 0.0001;
+    }
   }
 
   std::string toString(const int cam_index=-1) const {
@@ -123,6 +133,112 @@ struct calib_params_t {
   }
 };
 
+/**
+ * Load calibration parameters of camera `prefix` (e.g. "cam0") from a
+ * calibration results file.
+ * @returns 0 or -1 for success or failure
+ */
+int calib_params_load(calib_params_t &params,
+                      const std::string &config_file,
+                      const std::string &prefix = "cam0");
+
+/**
+ * Camera model, i.e. a supported projection and distortion model combination.
+ */
+enum camera_model_t {
+  PINHOLE_RADTAN4 = 0,
+  PINHOLE_EQUI4 = 1,
+  DOUBLE_SPHERE = 2,
+};
+
+/**
+ * Get camera model of calibration parameters `params`.
+ * @returns 0 or -1 for success or failure (unsupported combination)
+ */
+int calib_camera_model(const calib_params_t &params, camera_model_t &model);
+
+/**
+ * Number of distortion parameters used by camera `model`, the double sphere
+ * model only uses the first two of its four `dist_params`.
+ */
+int camera_dist_params_size(const camera_model_t model);
+
+/**
+ * Project point `p_C` with camera `model` and parameters `proj_params`,
+ * `dist_params` to image point `z_hat`.
+ *
+ * @returns 0 for success, -1 for failure and 1 if point is behind camera
+ */
+template <typename T>
+int camera_project(const camera_model_t model,
+                   const T *proj_params,
+                   const T *dist_params,
+                   const Eigen::Matrix<T, 3, 1> &p_C,
+                   Eigen::Matrix<T, 2, 1> &z_hat) {
+  Eigen::Matrix<T, 8, 1> params;
+  params << proj_params[0], proj_params[1], proj_params[2], proj_params[3],
+            dist_params[0], dist_params[1], dist_params[2], dist_params[3];
+
+  switch (model) {
+  case PINHOLE_RADTAN4: return pinhole_radtan4_project(params, p_C, z_hat);
+  case PINHOLE_EQUI4: return pinhole_equi4_project(params, p_C, z_hat);
+  case DOUBLE_SPHERE: return double_sphere_project(params, p_C, z_hat);
+  default: return -1;
+  }
+}
+
+/**
+ * Project point `p_C` with camera `model` like `camera_project()`, and
+ * evaluate the Jacobians of `z_hat` w.r.t. the point `J_point`, projection
+ * `J_proj` and distortion `J_dist` parameters.
+ *
+ * @returns 0 for success, -1 for failure and 1 if point is behind camera
+ */
+int camera_project(const camera_model_t model,
+                   const double *proj_params,
+                   const double *dist_params,
+                   const vec3_t &p_C,
+                   vec2_t &z_hat,
+                   mat_t<2, 3> &J_point,
+                   mat_t<2, 4> &J_proj,
+                   mat_t<2, 4> &J_dist);
+
+/**
+ * Project `n` points in structure-of-arrays layout (`x`, `y`, `z`) with camera
+ * `model` to image points (`u`, `v`) and validity mask `valid`, see
+ * `pinhole_radtan4_project_batch()`.
+ *
+ * @returns 0 or -1 for success or failure (unsupported model)
+ */
+int camera_project_batch(const camera_model_t model,
+                         const double *proj_params,
+                         const double *dist_params,
+                         const size_t n,
+                         const real_t *x,
+                         const real_t *y,
+                         const real_t *z,
+                         real_t *u,
+                         real_t *v,
+                         uint8_t *valid);
+
+/**
+ * Undistort `n` image points (`u`, `v`) with camera `model` to normalized
+ * image points (`x`, `y`) on the z = 1 plane, with per point convergence
+ * status `converged`, see `pinhole_radtan4_undistort_batch()`. An
+ * unsupported `model` is logged as an error and no point is converged.
+ *
+ * @returns Number of converged points
+ */
+size_t camera_undistort_batch(const camera_model_t model,
+                              const double *proj_params,
+                              const double *dist_params,
+                              const size_t n,
+                              const real_t *u,
+                              const real_t *v,
+                              real_t *x,
+                              real_t *y,
+                              uint8_t *converged);
+
 /**
  * Calibration target.
  */
@@ -137,6 +253,131 @@ struct calib_target_t {
   ~calib_target_t() {}
 };
 
+/**
+ * Flat calibration observations. Every corner observed in `aprilgrids` is
+ * stored once, frame after frame, where the corners of frame `i` are in the
+ * index range `[frame_offsets[i], frame_offsets[i + 1])`.
+ */
+struct calib_obs_t {
+  std::vector<timestamp_t> timestamps; ///< Frame timestamps
+  std::vector<size_t> frame_offsets;   ///< Frame start index, nb_frames + 1
+  std::vector<int> tag_ids;            ///< Tag id of each corner
+  std::vector<int> corner_ids;         ///< Corner id of each corner
+  vec2s_t keypoints;                   ///< Measured keypoint of each corner
+  vec3s_t object_points;               ///< Object point of each corner
+
+  calib_obs_t() {}
+  ~calib_obs_t() {}
+
+  size_t nb_frames() const { return timestamps.size(); }
+  size_t nb_corners() const { return keypoints.size(); }
+};
+
+/**
+ * Form flat calibration observations `obs` from `aprilgrids`.
+ * @returns 0 or -1 for success or failure
+ */
+int calib_obs_init(calib_obs_t &obs, const aprilgrids_t &aprilgrids);
+
+/**
+ * Scratch buffers of `calib_reproj_errors()`. Reuse one per thread across
+ * frames so that evaluating the reprojection errors does not allocate.
+ */
+struct calib_reproj_buffers_t {
+  std::vector<real_t> x;
+  std::vector<real_t> y;
+  std::vector<real_t> z;
+  std::vector<real_t> u;
+  std::vector<real_t> v;
+  vec2s_t errors;
+  std::vector<uint8_t> valid;
+
+  calib_reproj_buffers_t() {}
+  ~calib_reproj_buffers_t() {}
+};
+
+/**
+ * Reprojection errors `errors` (keypoint minus projection) of the corners of
+ * frame `frame_idx` in `obs` seen from pose `T_CF`, with camera `model`. The
+ * corners are projected in one batch with `camera_project_batch()`, corners
+ * that fail to project are skipped. Scratch space is taken from `buf` if
+ * given, else allocated for this call.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_reproj_errors(const calib_obs_t &obs,
+                        const size_t frame_idx,
+                        const camera_model_t model,
+                        const double *proj_params,
+                        const double *dist_params,
+                        const mat4_t &T_CF,
+                        vec2s_t &errors,
+                        calib_reproj_buffers_t *buf = nullptr);
+
+/**
+ * Same as above, but `errors` has one entry per corner of frame `frame_idx`
+ * and `valid` flags the corners that projected successfully.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_reproj_errors(const calib_obs_t &obs,
+                        const size_t frame_idx,
+                        const camera_model_t model,
+                        const double *proj_params,
+                        const double *dist_params,
+                        const mat4_t &T_CF,
+                        vec2s_t &errors,
+                        std::vector<uint8_t> &valid,
+                        calib_reproj_buffers_t *buf = nullptr);
+
+/**
+ * Calibration reprojection error statistics, globally and broken down per
+ * frame, per tag and per image region. Image regions are the cells of a
+ * `grid_rows` x `grid_cols` grid over the image, indexed by where the corner
+ * was measured, so `grid_rmse` is a heatmap of where the camera model fits
+ * worst. Empty frames, tags and cells have zero residuals and RMSE.
+ */
+struct calib_stats_t {
+  size_t nb_residuals = 0;
+  real_t rmse = 0.0;
+  real_t mean = 0.0;
+  real_t max = 0.0;
+
+  std::vector<real_t> corner_errors;      ///< Per corner of obs, NaN if invalid
+  std::vector<size_t> frame_nb_residuals; ///< Per frame
+  std::vector<real_t> frame_rmse;         ///< Per frame
+  std::map<int, size_t> tag_nb_residuals; ///< Per tag id
+  std::map<int, real_t> tag_rmse;         ///< Per tag id
+
+  int grid_rows = 0;
+  int grid_cols = 0;
+  matx_t grid_nb_residuals; ///< Per image region
+  matx_t grid_rmse;         ///< Per image region
+
+  calib_stats_t() {}
+  ~calib_stats_t() {}
+};
+
+/**
+ * Evaluate reprojection error statistics `stats` of observations `obs` with
+ * camera `cam` and frame poses `poses`. Frames are projected in parallel
+ * with `calib_reproj_errors()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_stats_init(calib_stats_t &stats,
+                     const calib_obs_t &obs,
+                     const calib_params_t &cam,
+                     const mat4s_t &poses,
+                     const int grid_rows = 6,
+                     const int grid_cols = 8);
+
+/**
+ * Print reprojection error statistics `stats`, listing the `top_n` worst
+ * frames and tags and the image region heatmap.
+ */
+void calib_stats_print(const calib_stats_t &stats, const size_t top_n = 5);
+
 /**
  * Load calibration target.
  * @returns 0 or -1 for success or failure
@@ -237,12 +478,18 @@ void extract_common_calib_data(aprilgrids_t &grids0, aprilgrids_t &grids1);
  * - Images that are synchronized are expected to have the **same exact
  *   timestamp**
  *
+ * If `common_only` is false all observations are kept instead, the
+ * AprilGrids are still paired by timestamp but frames (or tags) observed by
+ * only one camera are not discarded, a frame missing in one camera is paired
+ * with an empty AprilGrid.
+ *
  * @returns 0 or -1 for success or failure
  */
 int load_stereo_calib_data(const std::string &cam0_data_dir,
                            const std::string &cam1_data_dir,
                            aprilgrids_t &cam0_aprilgrids,
-                           aprilgrids_t &cam1_aprilgrids);
+                           aprilgrids_t &cam1_aprilgrids,
+                           const bool common_only = true);
 
 /**
  * Load preprocessed multi-camera calibration data, where each data path in
@@ -2,6 +2,101 @@
 
 namespace yac {
 
+int calib_mocap_marker_init(const mat4s_t &T_WM,
+                            const mat4s_t &T_CF,
+                            mat4_t &T_MC,
+                            mat4_t &T_WF,
+                            const real_t min_angle) {
+  assert(T_WM.size() == T_CF.size());
+  const size_t nb_frames = T_WM.size();
+
+  // Accumulate the normal equations of every frame pair with sufficient
+  // rotation on the fly, so memory stays constant in the number of frames.
+  //
+  // Rotation: C_A * C_X = C_X * C_B, so alpha = C_X * beta where alpha and
+  // beta are the rotation vectors of C_A and C_B, and C_X = (M^T M)^-1/2 M^T
+  // with M = sum(beta * alpha^T).
+  //
+  // Translation: (C_A - I) * r_X = C_X * r_B - r_A, with J = C_A - I the
+  // normal equations are H * r_X = b where H = sum(J^T * J) and b =
+  // sum(J^T * C_X * r_B) - sum(J^T * r_A). C_X is not known until all pairs
+  // are seen, so the first term of b is kept as K * vec(C_X) with K =
+  // sum(kron(r_B^T, J^T)).
+  size_t nb_pairs = 0;
+  mat3_t M = zeros(3, 3);
+  mat3_t H = zeros(3, 3);
+  Eigen::Matrix<real_t, 3, 9> K = Eigen::Matrix<real_t, 3, 9>::Zero();
+  vec3_t b_A = zeros(3, 1);
+  for (size_t i = 0; i < nb_frames; i++) {
+    const mat4_t T_MW_i = T_WM[i].inverse();
+    for (size_t j = i + 1; j < nb_frames; j++) {
+      const mat4_t A_ij = T_MW_i * T_WM[j];
+      const Eigen::AngleAxisd aa_A{tf_rot(A_ij)};
+      if (aa_A.angle() <= min_angle) {
+        continue;
+      }
+      const mat4_t B_ij = T_CF[i] * T_CF[j].inverse();
+      const Eigen::AngleAxisd aa_B{tf_rot(B_ij)};
+      const vec3_t alpha = aa_A.angle() * aa_A.axis();
+      const vec3_t beta = aa_B.angle() * aa_B.axis();
+      M += beta * alpha.transpose();
+
+      const mat3_t J = tf_rot(A_ij) - I(3);
+      const vec3_t r_B = tf_trans(B_ij);
+      H += J.transpose() * J;
+      for (int n = 0; n < 3; n++) {
+        K.block<3, 3>(0, 3 * n) += r_B(n) * J.transpose();
+      }
+      b_A += J.transpose() * tf_trans(A_ij);
+      nb_pairs++;
+    }
+  }
+  if (nb_pairs < 2) {
+    LOG_ERROR("Not enough rotation between frames for hand-eye init!");
+    return -1;
+  }
+
+  // Solve rotation
+  const Eigen::SelfAdjointEigenSolver<mat3_t> eig(M.transpose() * M);
+  const vec3_t lambda = eig.eigenvalues();
+  if (lambda(0) <= 1e-6 * lambda(2)) {
+    LOG_ERROR("Hand-eye init needs rotations about more than one axis!");
+    return -1;
+  }
+  const vec3_t lambda_inv_sqrt = lambda.cwiseSqrt().cwiseInverse();
+  const mat3_t V = eig.eigenvectors();
+  const mat3_t MtM_inv_sqrt = V * lambda_inv_sqrt.asDiagonal() * V.transpose();
+  const mat3_t C_X = MtM_inv_sqrt * M.transpose();
+  if (C_X.determinant() < 0.0) {
+    LOG_ERROR("Hand-eye rotation is not a proper rotation!");
+    return -1;
+  }
+
+  // Solve translation
+  const Eigen::Map<const Eigen::Matrix<real_t, 9, 1>> C_X_vec{C_X.data()};
+  const vec3_t b = K * C_X_vec - b_A;
+  const vec3_t r_X = H.ldlt().solve(b);
+  T_MC = tf(C_X, r_X);
+
+  // Fiducial pose: average of T_WM[i] * T_MC * T_CF[i] over all frames, the
+  // rotation is the chordal mean projected back onto SO(3)
+  mat3_t C_sum = zeros(3, 3);
+  vec3_t r_sum = zeros(3, 1);
+  for (size_t i = 0; i < nb_frames; i++) {
+    const mat4_t T_WF_i = T_WM[i] * T_MC * T_CF[i];
+    C_sum += tf_rot(T_WF_i);
+    r_sum += tf_trans(T_WF_i);
+  }
+  const auto svd_opts = Eigen::ComputeFullU | Eigen::ComputeFullV;
+  Eigen::JacobiSVD<mat3_t> svd(C_sum, svd_opts);
+  mat3_t S = I(3);
+  S(2, 2) = (svd.matrixU() * svd.matrixV().transpose()).determinant();
+  const mat3_t C_WF = svd.matrixU() * S * svd.matrixV().transpose();
+  T_WF = tf(C_WF, vec3_t{r_sum / nb_frames});
+
+  return 0;
+}
+
 static int process_aprilgrid(const aprilgrid_t &aprilgrid,
                              calib_params_t &cam,
                              calib_pose_t *T_MC,
@@ -68,7 +163,9 @@ int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
                              calib_params_t &cam,
                              mat4s_t &T_WM,
                              mat4_t &T_MC,
-                             mat4_t &T_WF) {
+                             mat4_t &T_WF,
+                             const calib_solver_options_t &opts) {
+  struct timespec t_start = tic();
   assert(aprilgrids.size() > 0);
   assert(T_WM.size() > 0);
   assert(T_WM.size() == aprilgrids.size());
@@ -123,41 +220,52 @@ int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
   problem->SetParameterization(T_WF_param.q,
                                &quaternion_parameterization);
 
+  // Hold distortion parameters unused by the camera model constant
+  camera_model_t cam_model;
+  if (calib_camera_model(cam, cam_model) == 0) {
+    calib_dist_params_setup(problem.get(),
+                            cam_model,
+                            cam.dist_params.data());
+  }
+
   // Set solver options
+  const size_t nb_corners = problem->NumResiduals() / 2;
   ceres::Solver::Options options;
-  options.minimizer_progress_to_stdout = true;
-  options.max_num_iterations = 100;
-  options.num_threads = 4;
+  calib_solver_callbacks_t callbacks;
+  calib_solver_setup(opts,
+                     nb_corners,
+                     t_start,
+                     options,
+                     callbacks,
+                     problem.get(),
+                     "mocap_marker");
 
   // Solve
   ceres::Solver::Summary summary;
   ceres::Solve(options, problem.get(), &summary);
-  std::cout << summary.FullReport() << std::endl;
-
-  // Estimate covariance matrix
-  std::vector<std::pair<const double*, const double*>> covar_blocks;
-  covar_blocks.push_back({T_MC_param.q, T_MC_param.q});
-  covar_blocks.push_back({T_MC_param.q, T_MC_param.r});
-  covar_blocks.push_back({T_MC_param.r, T_WF_param.r});
-
-  ceres::Covariance::Options covar_options;
-  covar_options.algorithm_type = ceres::SPARSE_QR;
-  covar_options.sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
-  ceres::Covariance covar(covar_options);
-  const auto retval = covar.Compute(covar_blocks, problem.get());
-  if (retval == false) {
+  if (opts.verbose) {
+    std::cout << summary.FullReport() << std::endl;
+  }
+  calib_solver_report(opts, "mocap_marker", nb_corners, summary);
+
+  // Estimate covariance matrix of the camera parameters, T_MC and T_WF, the
+  // marker poses are constant so the information matrix is small and dense
+  std::vector<double *> covar_blocks = {cam.proj_params.data(),
+                                        cam.dist_params.data(),
+                                        T_MC_param.q,
+                                        T_MC_param.r,
+                                        T_WF_param.q,
+                                        T_WF_param.r};
+  matx_t covar;
+  const int dist_size =
+      problem->ParameterBlockLocalSize(cam.dist_params.data());
+  if (calib_covar_dense(problem.get(), covar_blocks, covar) != 0) {
     printf("Estimate covariance failed!\n");
+    covar = zeros(16 + dist_size, 16 + dist_size);
   }
+  const mat3_t covar_rot = covar.block(4 + dist_size, 4 + dist_size, 3, 3);
+  const mat3_t covar_trans = covar.block(7 + dist_size, 7 + dist_size, 3, 3);
 
-  double q_MC_q_MC_covar[3 * 3] = {0};
-  double q_MC_r_MC_covar[3 * 3] = {0};
-  double r_MC_r_MC_covar[3 * 3] = {0};
-
-  covar.GetCovarianceBlockInTangentSpace(T_MC_param.q, T_MC_param.q, q_MC_q_MC_covar);
-  covar.GetCovarianceBlockInTangentSpace(T_MC_param.q, T_MC_param.r, q_MC_r_MC_covar);
-  covar.GetCovarianceBlockInTangentSpace(T_MC_param.r, T_MC_param.r, r_MC_r_MC_covar);
-
-  Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> covar_rot(q_MC_q_MC_covar);
   auto rotx_std = (covar_rot(0, 0) < 1e-8) ? 0 : std::sqrt(covar_rot(0, 0));
   auto roty_std = (covar_rot(1, 1) < 1e-8) ? 0 : std::sqrt(covar_rot(1, 1));
   auto rotz_std = (covar_rot(2, 2) < 1e-8) ? 0 : std::sqrt(covar_rot(2, 2));
@@ -166,7 +274,6 @@ int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
   printf("roty_std: %f [deg]\n", rad2deg(roty_std));
   printf("rotz_std: %f [deg]\n", rad2deg(rotz_std));
 
-  Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> covar_trans(r_MC_r_MC_covar);
   auto rx_std = std::sqrt(covar_trans(0, 0));
   auto ry_std = std::sqrt(covar_trans(1, 1));
   auto rz_std = std::sqrt(covar_trans(2, 2));
@@ -188,6 +295,162 @@ int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
   return 0;
 }
 
+int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
+                             const timestamps_t &body_timestamps,
+                             const mat4s_t &body_poses,
+                             calib_params_t &cam,
+                             mat4_t &T_MC,
+                             mat4_t &T_WF,
+                             real_t &td,
+                             const real_t td_max,
+                             const calib_solver_options_t &opts) {
+  struct timespec t_start = tic();
+  assert(body_timestamps.size() == body_poses.size());
+  assert(td_max >= 0.0);
+
+  camera_model_t cam_model;
+  if (calib_camera_model(cam, cam_model) != 0) {
+    LOG_ERROR("Unsupported [%s-%s] projection distortion combination!",
+              cam.proj_model.c_str(), cam.dist_model.c_str());
+    return -1;
+  }
+  if (body_timestamps.size() < 2) {
+    LOG_ERROR("Not enough body poses!");
+    return -1;
+  }
+
+  // Only keep AprilGrids that can be interpolated over the time offset bounds
+  const real_t td_lower = td - td_max;
+  const real_t td_upper = td + td_max;
+  const int64_t dt_lower = td_lower * 1e9;
+  const int64_t dt_upper = td_upper * 1e9;
+  const int64_t t_first = body_timestamps.front() + dt_upper;
+  const int64_t t_last = body_timestamps.back() + dt_lower;
+  aprilgrids_t grids;
+  for (const auto &grid : aprilgrids) {
+    const int64_t ts = grid.timestamp;
+    if (ts > t_first && ts < t_last) {
+      grids.push_back(grid);
+    }
+  }
+  if (grids.size() == 0) {
+    LOG_ERROR("No AprilGrids within the body poses for the time offset bounds!");
+    return -1;
+  }
+
+  calib_obs_t obs;
+  if (calib_obs_init(obs, grids) != 0) {
+    LOG_ERROR("Failed to form calibration observations!");
+    return -1;
+  }
+
+  // Window of marker poses around each AprilGrid, wide enough to interpolate
+  // the marker pose for any time offset within the bounds
+  std::vector<mocap_pose_window_t> windows(grids.size());
+  for (size_t k = 0; k < grids.size(); k++) {
+    const int64_t ts = grids[k].timestamp;
+    const timestamp_t t_start = ts - dt_upper;
+    const timestamp_t t_end = ts - dt_lower;
+    auto it_start = std::upper_bound(body_timestamps.begin(),
+                                     body_timestamps.end(),
+                                     t_start);
+    auto it_end = std::lower_bound(body_timestamps.begin(),
+                                   body_timestamps.end(),
+                                   t_end);
+    const size_t idx_start = (it_start - body_timestamps.begin()) - 1;
+    const size_t idx_end = (it_end - body_timestamps.begin());
+
+    for (size_t i = idx_start; i <= idx_end; i++) {
+      const int64_t dt = (int64_t) body_timestamps[i] - ts;
+      windows[k].dts.push_back(dt * 1e-9);
+      windows[k].poses.push_back(body_poses[i]);
+    }
+  }
+
+  // Optimization variables
+  calib_pose_t T_MC_param{T_MC};
+  calib_pose_t T_WF_param{T_WF};
+  double td_param = td;
+
+  // Setup optimization problem
+  ceres::Problem::Options problem_opts;
+  problem_opts.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  std::unique_ptr<ceres::Problem> problem(new ceres::Problem(problem_opts));
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+
+  for (size_t k = 0; k < obs.nb_frames(); k++) {
+    for (size_t i = obs.frame_offsets[k]; i < obs.frame_offsets[k + 1]; i++) {
+      const auto residual = new mocap_marker_td_residual_t{cam_model,
+                                                           obs.keypoints[i],
+                                                           obs.object_points[i],
+                                                           &windows[k]};
+
+      const auto cost_func =
+          new ceres::AutoDiffCostFunction<mocap_marker_td_residual_t,
+                                          2, // Size of: residual
+                                          4, // Size of: intrinsics
+                                          4, // Size of: distortion
+                                          4, // Size of: q_MC
+                                          3, // Size of: t_MC
+                                          4, // Size of: q_WF
+                                          3, // Size of: t_WF
+                                          1  // Size of: td
+                                          >(residual);
+
+      problem->AddResidualBlock(cost_func, // Cost function
+                                NULL,      // Loss function
+                                cam.proj_params.data(),
+                                cam.dist_params.data(),
+                                T_MC_param.q,
+                                T_MC_param.r,
+                                T_WF_param.q,
+                                T_WF_param.r,
+                                &td_param);
+    }
+  }
+
+  // Set quaternion parameterization for T_MC and T_WF
+  problem->SetParameterization(T_MC_param.q,
+                               &quaternion_parameterization);
+  problem->SetParameterization(T_WF_param.q,
+                               &quaternion_parameterization);
+  calib_dist_params_setup(problem.get(), cam_model, cam.dist_params.data());
+
+  // Bound time offset
+  problem->SetParameterLowerBound(&td_param, 0, td_lower);
+  problem->SetParameterUpperBound(&td_param, 0, td_upper);
+
+  // Set solver options
+  const size_t nb_corners = problem->NumResiduals() / 2;
+  ceres::Solver::Options options;
+  calib_solver_callbacks_t callbacks;
+  calib_solver_setup(opts,
+                     nb_corners,
+                     t_start,
+                     options,
+                     callbacks,
+                     problem.get(),
+                     "mocap_marker_td");
+
+  // Solve
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, problem.get(), &summary);
+  if (opts.verbose) {
+    std::cout << summary.FullReport() << std::endl;
+  }
+  calib_solver_report(opts, "mocap_marker_td", nb_corners, summary);
+
+  // Finish up
+  T_MC = T_MC_param.T();
+  T_WF = T_WF_param.T();
+  td = td_param;
+  if (opts.verbose) {
+    LOG_INFO("Camera to mocap time offset td: %f [s]", td);
+  }
+
+  return 0;
+}
+
 double evaluate_mocap_marker_cost(const aprilgrids_t &aprilgrids,
                                   calib_params_t &cam,
                                   mat4s_t &T_WM,
@@ -196,35 +459,212 @@ double evaluate_mocap_marker_cost(const aprilgrids_t &aprilgrids,
   assert(T_WM.size() > 0);
   assert(T_WM.size() == aprilgrids.size());
 
-  // Optimization variables
-  calib_pose_t T_MC_param{T_MC};
-  calib_pose_t T_WF_param{T_WM[0] * T_MC * aprilgrids[0].T_CF};
-  std::vector<calib_pose_t> T_WM_params;
-  for (size_t i = 0; i < T_WM.size(); i++) {
-    T_WM_params.push_back(T_WM[i]);
+  calib_obs_t obs;
+  if (calib_obs_init(obs, aprilgrids) != 0) {
+    LOG_ERROR("Failed to form calibration observations!");
+    return -1;
   }
+  const mat4_t T_WF = T_WM[0] * T_MC * aprilgrids[0].T_CF;
 
-  // Setup optimization problem
-  ceres::Problem::Options problem_options;
-  std::unique_ptr<ceres::Problem> problem(new ceres::Problem(problem_options));
+  return evaluate_mocap_marker_cost(obs, cam, T_WM, T_MC, T_WF);
+}
 
-  // Process all aprilgrid data
-  for (size_t i = 0; i < aprilgrids.size(); i++) {
-    int retval = process_aprilgrid(aprilgrids[i],
-                                   cam,
-                                   &T_MC_param,
-                                   &T_WM_params[i],
-                                   &T_WF_param,
-                                   problem.get());
-    if (retval != 0) {
-      LOG_ERROR("Failed to add AprilGrid measurements to problem!");
-      return -1;
+double evaluate_mocap_marker_cost(const calib_obs_t &obs,
+                                  const calib_params_t &cam,
+                                  const mat4s_t &T_WM,
+                                  const mat4_t &T_MC,
+                                  const mat4_t &T_WF) {
+  assert(T_WM.size() == obs.nb_frames());
+
+  camera_model_t model;
+  if (calib_camera_model(cam, model) != 0) {
+    return -1;
+  }
+  const double *proj_params = cam.proj_params.data();
+  const double *dist_params = cam.dist_params.data();
+  const mat4_t T_CM = T_MC.inverse();
+
+  // Accumulate cost over frames in parallel, each thread reuses its buffers
+  double cost = 0.0;
+  const size_t nb_frames = obs.nb_frames();
+#pragma omp parallel reduction(+ : cost)
+  {
+    calib_reproj_buffers_t buf;
+    vec2s_t errors;
+    std::vector<uint8_t> valid;
+#pragma omp for
+    for (size_t k = 0; k < nb_frames; k++) {
+      const mat4_t T_CF = T_CM * T_WM[k].inverse() * T_WF;
+      if (calib_reproj_errors(obs,
+                              k,
+                              model,
+                              proj_params,
+                              dist_params,
+                              T_CF,
+                              errors,
+                              valid,
+                              &buf) != 0) {
+        continue;
+      }
+      for (size_t i = 0; i < errors.size(); i++) {
+        cost += (valid[i]) ? 0.5 * errors[i].squaredNorm() : 0.0;
+      }
     }
   }
 
-  double cost;
-  problem->Evaluate(ceres::Problem::EvaluateOptions(), &cost, NULL, NULL, NULL);
   return cost;
 }
 
+mat4_t lerp_pose(const timestamp_t &t0,
+                 const mat4_t &pose0,
+                 const timestamp_t &t1,
+                 const mat4_t &pose1,
+                 const timestamp_t &t_lerp) {
+  // Calculate alpha
+  const double numerator = ((double) t_lerp - (double) t0) * 1e-9;
+  const double denominator = ((double) t1 - (double) t0) * 1e-9;
+  const double alpha = numerator / denominator;
+
+  // Decompose start pose
+  const vec3_t trans0 = tf_trans(pose0);
+  const quat_t quat0{tf_rot(pose0)};
+
+  // Decompose end pose
+  const vec3_t trans1 = tf_trans(pose1);
+  const quat_t quat1{tf_rot(pose1)};
+
+  // Interpolate translation and rotation
+  const auto trans_interp = lerp(trans0, trans1, alpha);
+  const auto quat_interp = quat0.slerp(alpha, quat1);
+
+  return tf(quat_interp, trans_interp);
+}
+
+static int lerp_body_pose(const timestamps_t &body_timestamps,
+                          const mat4s_t &body_poses,
+                          const int64_t t,
+                          mat4_t &pose) {
+  // Find the first body pose after time t
+  const auto it = std::upper_bound(body_timestamps.begin(),
+                                   body_timestamps.end(),
+                                   t,
+                                   [](const int64_t a, const timestamp_t b) {
+                                     return a < (int64_t) b;
+                                   });
+  if (it == body_timestamps.begin() || it == body_timestamps.end()) {
+    return -1;
+  }
+
+  const size_t idx = it - body_timestamps.begin();
+  pose = lerp_pose(body_timestamps[idx - 1],
+                   body_poses[idx - 1],
+                   body_timestamps[idx],
+                   body_poses[idx],
+                   t);
+
+  return 0;
+}
+
+void lerp_body_poses(const aprilgrids_t &grids,
+                     const timestamps_t &body_timestamps,
+                     const mat4s_t &body_poses,
+                     aprilgrids_t &lerped_grids,
+                     mat4s_t &lerped_poses,
+                     const int64_t ts_offset) {
+  assert(body_poses.size() == body_timestamps.size());
+
+  // Lerp body poses at the AprilGrid timestamps in the body clock, AprilGrids
+  // outside the body poses can't be lerped and are skipped
+  for (const auto &grid : grids) {
+    const int64_t t = (int64_t) grid.timestamp - ts_offset;
+    mat4_t pose;
+    if (lerp_body_pose(body_timestamps, body_poses, t, pose) == 0) {
+      lerped_grids.push_back(grid);
+      lerped_poses.push_back(pose);
+    }
+  }
+}
+
+int calib_mocap_marker_sweep(const aprilgrids_t &aprilgrids,
+                             const timestamps_t &body_timestamps,
+                             const mat4s_t &body_poses,
+                             const calib_params_t &cam,
+                             const mat4_t &T_MC,
+                             const mat4_t &T_WF,
+                             const std::vector<int64_t> &ts_offsets,
+                             mocap_marker_sweep_t &results) {
+  assert(body_timestamps.size() == body_poses.size());
+  if (ts_offsets.size() == 0 || body_timestamps.size() < 2) {
+    LOG_ERROR("Not enough time offsets or body poses to sweep!");
+    return -1;
+  }
+
+  // Only keep AprilGrids that can be interpolated for every time offset
+  const auto minmax = std::minmax_element(ts_offsets.begin(), ts_offsets.end());
+  const int64_t t_first = body_timestamps.front() + *minmax.second;
+  const int64_t t_last = body_timestamps.back() + *minmax.first;
+  aprilgrids_t grids;
+  for (const auto &grid : aprilgrids) {
+    const int64_t ts = grid.timestamp;
+    if (ts > t_first && ts < t_last) {
+      grids.push_back(grid);
+    }
+  }
+  if (grids.size() == 0) {
+    LOG_ERROR("No AprilGrids within the body poses for every time offset!");
+    return -1;
+  }
+
+  // Form observations once
+  calib_obs_t obs;
+  if (calib_obs_init(obs, grids) != 0) {
+    LOG_ERROR("Failed to form calibration observations!");
+    return -1;
+  }
+
+  // Evaluate time offsets in parallel, only T_WM changes between offsets
+  const size_t nb_offsets = ts_offsets.size();
+  const size_t nb_corners = obs.nb_corners();
+  results = mocap_marker_sweep_t{};
+  results.ts_offsets = ts_offsets;
+  results.costs.resize(nb_offsets, -1.0);
+  results.rmses.resize(nb_offsets, -1.0);
+  results.nb_frames = grids.size();
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t k = 0; k < nb_offsets; k++) {
+    mat4s_t T_WM(grids.size());
+    bool ok = true;
+    for (size_t i = 0; i < grids.size() && ok; i++) {
+      const int64_t t = (int64_t) grids[i].timestamp - ts_offsets[k];
+      ok = (lerp_body_pose(body_timestamps, body_poses, t, T_WM[i]) == 0);
+    }
+    if (ok == false) {
+      continue;
+    }
+
+    const real_t cost = evaluate_mocap_marker_cost(obs, cam, T_WM, T_MC, T_WF);
+    results.costs[k] = cost;
+    results.rmses[k] = sqrt(2.0 * cost / nb_corners);
+  }
+
+  // Find best time offset
+  bool found = false;
+  for (size_t k = 0; k < nb_offsets; k++) {
+    if (results.costs[k] < 0.0) {
+      continue;
+    }
+    if (found == false || results.costs[k] < results.costs[results.best_idx]) {
+      results.best_idx = k;
+      found = true;
+    }
+  }
+  if (found == false) {
+    LOG_ERROR("Failed to evaluate any time offset!");
+    return -1;
+  }
+
+  return 0;
+}
+
 } //  namespace yac
@@ -2,10 +2,12 @@
 #define YAC_CALIB_MOCAP_MARKER_HPP
 
 #include <ceres/ceres.h>
+#include <ceres/rotation.h>
 
 #include "core.hpp"
 #include "calib_data.hpp"
 #include "calib_mono.hpp"
+#include "calib_solver.hpp"
 
 namespace yac {
 
@@ -75,6 +77,10 @@ struct mocap_marker_residual_t {
       if (pinhole_equi4_project(cam_params, p_C, z_hat) != 0) {
         return false;
       }
+    } else if (proj_model_ == "double_sphere" && dist_model_ == "none") {
+      if (double_sphere_project(cam_params, p_C, z_hat) != 0) {
+        return false;
+      }
     } else {
       FATAL("Unsupported [%s-%s] projection distortion combination!",
             proj_model_.c_str(), dist_model_.c_str());
@@ -161,21 +167,260 @@ struct mocap_marker_residual_t {
 // };
 
 /**
- * Calibrate mocap marker
+ * Scalar part of a ceres autodiff variable.
+ */
+inline double jet_scalar(const double x) { return x; }
+template <typename T, int N>
+inline double jet_scalar(const ceres::Jet<T, N> &x) { return x.a; }
+
+/**
+ * Window of mocap marker poses around a camera frame, where `dts` are the
+ * times of the marker poses relative to the camera frame timestamp [s].
+ */
+struct mocap_pose_window_t {
+  std::vector<real_t> dts;
+  mat4s_t poses;
+
+  mocap_pose_window_t() {}
+  ~mocap_pose_window_t() {}
+
+  /**
+   * Interpolate marker pose at time `t` relative to the camera frame [s].
+   * Outside the window the pose is extrapolated from the first or last pair
+   * of poses.
+   */
+  template <typename T>
+  Eigen::Matrix<T, 4, 4> interpolate(const T &t) const {
+    assert(dts.size() >= 2);
+    assert(dts.size() == poses.size());
+
+    // Find the pair of poses around time t
+    const double t_val = jet_scalar(t);
+    size_t k = 0;
+    while ((k + 2) < dts.size() && dts[k + 1] <= t_val) {
+      k++;
+    }
+    const T alpha = (t - T(dts[k])) / T(dts[k + 1] - dts[k]);
+
+    // Interpolate translation
+    const vec3_t r0 = tf_trans(poses[k]);
+    const vec3_t r1 = tf_trans(poses[k + 1]);
+    const Eigen::Matrix<T, 3, 1> r = r0.cast<T>() + alpha * (r1 - r0).cast<T>();
+
+    // Interpolate rotation, C = C0 * Exp(alpha * Log(C0^T * C1))
+    const mat3_t C0 = tf_rot(poses[k]);
+    const mat3_t C1 = tf_rot(poses[k + 1]);
+    const Eigen::AngleAxisd dC{C0.transpose() * C1};
+    const vec3_t phi = dC.angle() * dC.axis();
+    const Eigen::Matrix<T, 3, 1> aa = alpha * phi.cast<T>();
+    Eigen::Matrix<T, 3, 3> dC_alpha;
+    ceres::AngleAxisToRotationMatrix(aa.data(), dC_alpha.data());
+    const Eigen::Matrix<T, 3, 3> C = C0.cast<T>() * dC_alpha;
+
+    return tf(C, r);
+  }
+};
+
+/**
+ * MOCAP marker residual with camera to mocap time offset. Instead of a fixed
+ * marker pose the residual interpolates the marker pose from `window` at the
+ * camera frame time in the mocap clock, so the time offset `td` [s] can be
+ * estimated with the other calibration parameters. The time offset follows
+ * `lerp_body_poses()`, i.e. it is added to the mocap timestamps.
+ */
+struct mocap_marker_td_residual_t {
+  camera_model_t cam_model_ = PINHOLE_RADTAN4;
+  double z_[2] = {0.0, 0.0};        ///< Measurement from cam0
+  double p_F_[3] = {0.0, 0.0, 0.0}; ///< Object point
+  const mocap_pose_window_t *window_ = nullptr;
+
+  mocap_marker_td_residual_t(const camera_model_t cam_model,
+                             const vec2_t &z,
+                             const vec3_t &p_F,
+                             const mocap_pose_window_t *window)
+    : cam_model_{cam_model},
+      z_{z(0), z(1)},
+      p_F_{p_F(0), p_F(1), p_F(2)},
+      window_{window} {}
+
+  ~mocap_marker_td_residual_t() {}
+
+  template <typename T>
+  bool operator()(const T *const intrinsics_,
+                  const T *const distortion_,
+                  const T *const q_MC_,
+                  const T *const r_MC_,
+                  const T *const q_WF_,
+                  const T *const r_WF_,
+                  const T *const td_,
+                  T *residual) const {
+    // Map optimization variables to Eigen
+    // -- Marker to camera extrinsics pose
+    const Eigen::Quaternion<T> q_MC(q_MC_[3], q_MC_[0], q_MC_[1], q_MC_[2]);
+    const Eigen::Matrix<T, 3, 3> C_MC = q_MC.toRotationMatrix();
+    const Eigen::Matrix<T, 3, 1> r_MC{r_MC_[0], r_MC_[1], r_MC_[2]};
+    const Eigen::Matrix<T, 4, 4> T_MC = tf(C_MC, r_MC);
+    // -- Fiducial pose
+    const Eigen::Quaternion<T> q_WF(q_WF_[3], q_WF_[0], q_WF_[1], q_WF_[2]);
+    const Eigen::Matrix<T, 3, 3> C_WF = q_WF.toRotationMatrix();
+    const Eigen::Matrix<T, 3, 1> r_WF{r_WF_[0], r_WF_[1], r_WF_[2]};
+    const Eigen::Matrix<T, 4, 4> T_WF = tf(C_WF, r_WF);
+    // -- Marker pose at camera frame time in the mocap clock
+    const Eigen::Matrix<T, 4, 4> T_WM = window_->interpolate(T(-td_[0]));
+
+    // Project fiducial object point to camera image plane
+    const Eigen::Matrix<T, 3, 1> p_F{T(p_F_[0]), T(p_F_[1]), T(p_F_[2])};
+    const Eigen::Matrix<T, 4, 4> T_CM = T_MC.inverse();
+    const Eigen::Matrix<T, 4, 4> T_MW = T_WM.inverse();
+    const Eigen::Matrix<T, 4, 1> hp_C = T_CM * T_MW * T_WF * p_F.homogeneous();
+    const Eigen::Matrix<T, 3, 1> p_C = hp_C.head(3);
+    Eigen::Matrix<T, 2, 1> z_hat;
+    if (camera_project(cam_model_, intrinsics_, distortion_, p_C, z_hat) != 0) {
+      return false;
+    }
+
+    // Residual
+    residual[0] = T(z_[0]) - z_hat(0);
+    residual[1] = T(z_[1]) - z_hat(1);
+
+    return true;
+  }
+};
+
+/**
+ * Closed-form hand-eye initialization of the marker to camera extrinsics
+ * `T_MC` and fiducial pose `T_WF` from the marker poses `T_WM` and the
+ * relative poses between camera and fiducial `T_CF` (e.g. from PnP) of each
+ * frame. Since `T_WF = T_WM[i] * T_MC * T_CF[i]` for every frame, every pair
+ * of frames (i, j) gives `A * X = X * B` where `X = T_MC`, `A = T_WM[i]^-1 *
+ * T_WM[j]` and `B = T_CF[i] * T_CF[j]^-1`. The rotation is solved with the
+ * method of Park and Martin and the translation with linear least squares,
+ * using only frame pairs whose relative rotation exceeds `min_angle` [rad].
+ * Both are accumulated pair by pair, so memory is constant in the number of
+ * frames.
+ *
+ * @returns 0 or -1 for success or failure (e.g. insufficient rotation)
+ */
+int calib_mocap_marker_init(const mat4s_t &T_WM,
+                            const mat4s_t &T_CF,
+                            mat4_t &T_MC,
+                            mat4_t &T_WF,
+                            const real_t min_angle = 0.1);
+
+/**
+ * Calibrate mocap marker. The solver may stop early according to `opts`.
  */
 int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
                              calib_params_t &cam,
                              mat4s_t &T_WM,
                              mat4_t &T_MC,
-                             mat4_t &T_WF);
+                             mat4_t &T_WF,
+                             const calib_solver_options_t &opts =
+                                 calib_solver_options_t());
+
+/**
+ * Calibrate mocap marker and estimate the camera to mocap time offset `td` [s]
+ * jointly. Rather than synchronizing AprilGrids and marker poses beforehand,
+ * the marker poses `body_poses` are interpolated inside the residual at the
+ * AprilGrid timestamps shifted by `td`, where `td` is added to the mocap
+ * timestamps as in `lerp_body_poses()`. The time offset is initialized with
+ * the value of `td` and bounded to within `td_max` [s] of it. Only AprilGrids
+ * that can be interpolated over the whole bound are used.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_mocap_marker_solve(const aprilgrids_t &aprilgrids,
+                             const timestamps_t &body_timestamps,
+                             const mat4s_t &body_poses,
+                             calib_params_t &cam,
+                             mat4_t &T_MC,
+                             mat4_t &T_WF,
+                             real_t &td,
+                             const real_t td_max = 0.1,
+                             const calib_solver_options_t &opts =
+                                 calib_solver_options_t());
 
 /**
- * Evaluate mocap marker cost
+ * Evaluate mocap marker cost, where the fiducial pose T_WF is initialized from
+ * the first AprilGrid. This forms the calibration observations on every call,
+ * when evaluating repeatedly form them once with `calib_obs_init()` and use
+ * the overload below instead.
  */
 double evaluate_mocap_marker_cost(const aprilgrids_t &aprilgrids,
                                   calib_params_t &cam,
                                   mat4s_t &T_WM,
                                   mat4_t &T_MC);
 
+/**
+ * Evaluate mocap marker cost directly over the calibration observations
+ * `obs`, where `T_WM` are the marker poses of each frame. This computes the
+ * same cost as a ceres problem of `mocap_marker_residual_t`, i.e. half the
+ * sum of squared reprojection errors, but without forming the problem or
+ * allocating memory. Form `obs` once with `calib_obs_init()` and reuse it
+ * across evaluations. Corners that fail to project are skipped.
+ *
+ * @returns Cost or -1 for failure
+ */
+double evaluate_mocap_marker_cost(const calib_obs_t &obs,
+                                  const calib_params_t &cam,
+                                  const mat4s_t &T_WM,
+                                  const mat4_t &T_MC,
+                                  const mat4_t &T_WF);
+
+/**
+ * Interpolate between `pose0` at time `t0` and `pose1` at time `t1` to obtain
+ * the pose at time `t_lerp`.
+ */
+mat4_t lerp_pose(const timestamp_t &t0,
+                 const mat4_t &pose0,
+                 const timestamp_t &t1,
+                 const mat4_t &pose1,
+                 const timestamp_t &t_lerp);
+
+/**
+ * Interpolate body poses `body_poses` at the AprilGrid timestamps, where
+ * `ts_offset` [ns] is added to the body timestamps and may be negative. Only
+ * AprilGrids within the shifted body pose time range are returned in
+ * `lerped_grids`, with the corresponding interpolated poses in `lerped_poses`.
+ */
+void lerp_body_poses(const aprilgrids_t &grids,
+                     const timestamps_t &body_timestamps,
+                     const mat4s_t &body_poses,
+                     aprilgrids_t &lerped_grids,
+                     mat4s_t &lerped_poses,
+                     const int64_t ts_offset = 0);
+
+/**
+ * Mocap marker time offset sweep results
+ */
+struct mocap_marker_sweep_t {
+  std::vector<int64_t> ts_offsets; ///< Candidate time offsets [ns]
+  std::vector<real_t> costs;       ///< Cost of each time offset
+  std::vector<real_t> rmses;       ///< RMSE reprojection error [px]
+  size_t nb_frames = 0;            ///< Frames evaluated for every offset
+  size_t best_idx = 0;             ///< Index of the lowest cost offset
+
+  mocap_marker_sweep_t() {}
+  ~mocap_marker_sweep_t() {}
+};
+
+/**
+ * Sweep candidate time offsets `ts_offsets` [ns] between the mocap body poses
+ * and the camera. The observations are formed once from the AprilGrids that
+ * can be interpolated for every candidate, then for each offset only the
+ * interpolated marker poses T_WM are updated and the cost is evaluated. The
+ * offsets are evaluated in parallel.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_mocap_marker_sweep(const aprilgrids_t &aprilgrids,
+                             const timestamps_t &body_timestamps,
+                             const mat4s_t &body_poses,
+                             const calib_params_t &cam,
+                             const mat4_t &T_MC,
+                             const mat4_t &T_WF,
+                             const std::vector<int64_t> &ts_offsets,
+                             mocap_marker_sweep_t &results);
+
 } //  namespace yac
 #endif // YAC_CALIB_MOCAP_MARKER_HPP
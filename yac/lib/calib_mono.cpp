@@ -6,13 +6,84 @@ namespace yac {
  *                             MONCULAR CAMERA
  ****************************************************************************/
 
+bool calib_mono_analytic_residual_t::Evaluate(double const *const *params,
+                                              double *residuals,
+                                              double **jacobians) const {
+  // Map variables
+  const double *intrinsics = params[0];
+  const double *distortion = params[1];
+  const quat_t q_CF{params[2][3], params[2][0], params[2][1], params[2][2]};
+  const vec3_t r_CF{params[3][0], params[3][1], params[3][2]};
+  const vec3_t p_F{p_F_[0], p_F_[1], p_F_[2]};
+
+  // Transform and project point to image plane
+  const mat3_t C_CF = q_CF.toRotationMatrix();
+  const vec3_t p_C = C_CF * p_F + r_CF;
+  vec2_t z_hat;
+  mat_t<2, 3> J_point;
+  mat_t<2, 4> J_proj;
+  mat_t<2, 4> J_dist;
+  if (camera_project(cam_model_, intrinsics, distortion, p_C,
+                     z_hat, J_point, J_proj, J_dist) != 0) {
+    return false;
+  }
+
+  // Residual
+  residuals[0] = z_[0] - z_hat(0);
+  residuals[1] = z_[1] - z_hat(1);
+
+  // Jacobians
+  if (jacobians == NULL) {
+    return true;
+  }
+  if (jacobians[0]) {
+    Eigen::Map<mat_t<2, 4, Eigen::RowMajor>> J(jacobians[0]);
+    J = -1.0 * J_proj;
+  }
+  if (jacobians[1]) {
+    Eigen::Map<mat_t<2, 4, Eigen::RowMajor>> J(jacobians[1]);
+    J = -1.0 * J_dist;
+  }
+  if (jacobians[2]) {
+    // Jacobian w.r.t. the quaternion coefficients (x, y, z, w), where
+    // C_CF * p_F = p_F + 2w (v x p_F) + 2 (v (v^T p_F) - |v|^2 p_F)
+    Eigen::Map<mat_t<2, 4, Eigen::RowMajor>> J(jacobians[2]);
+    const vec3_t v = q_CF.vec();
+    const real_t w = q_CF.w();
+    mat_t<3, 4> dp_dq;
+    dp_dq.leftCols<3>() = -2.0 * w * skew(p_F);
+    dp_dq.leftCols<3>() += 2.0 * v * p_F.transpose();
+    dp_dq.leftCols<3>() += 2.0 * v.dot(p_F) * I(3);
+    dp_dq.leftCols<3>() -= 4.0 * p_F * v.transpose();
+    dp_dq.col(3) = 2.0 * v.cross(p_F);
+    J = -1.0 * J_point * dp_dq;
+  }
+  if (jacobians[3]) {
+    Eigen::Map<mat_t<2, 3, Eigen::RowMajor>> J(jacobians[3]);
+    J = -1.0 * J_point;
+  }
+
+  return true;
+}
+
 static int process_aprilgrid(const aprilgrid_t &aprilgrid,
                              const std::string &proj_model,
                              const std::string &dist_model,
                              double *intrinsics,
                              double *distortion,
                              calib_pose_t *pose,
-                             ceres::Problem &problem) {
+                             ceres::Problem &problem,
+                             const bool analytic = false) {
+  camera_model_t cam_model;
+  if (analytic) {
+    calib_params_t params;
+    params.proj_model = proj_model;
+    params.dist_model = dist_model;
+    if (calib_camera_model(params, cam_model) != 0) {
+      return -1;
+    }
+  }
+
   for (const auto &tag_id : aprilgrid.ids) {
     // Get keypoints
     vec2s_t keypoints;
@@ -33,6 +104,18 @@ static int process_aprilgrid(const aprilgrid_t &aprilgrid,
       const auto kp = keypoints[i];
       const auto obj_pt = object_points[i];
 
+      if (analytic) {
+        const auto cost_func =
+            new calib_mono_analytic_residual_t{cam_model, kp, obj_pt};
+        problem.AddResidualBlock(cost_func, // Cost function
+                                 NULL,      // Loss function
+                                 intrinsics,
+                                 distortion,
+                                 pose->q,
+                                 pose->r);
+        continue;
+      }
+
       const auto residual = new calib_mono_residual_t{proj_model, dist_model,
                                                       kp, obj_pt};
       const auto cost_func =
@@ -58,7 +141,11 @@ static int process_aprilgrid(const aprilgrid_t &aprilgrid,
 
 int calib_mono_solve(const aprilgrids_t &aprilgrids,
                      calib_params_t &calib_params,
-                     mat4s_t &T_CF) {
+                     mat4s_t &T_CF,
+                     const calib_solver_options_t &opts,
+                     ceres::Solver::Summary *summary) {
+  struct timespec t_start = tic();
+
   // Optimization variables
   std::vector<calib_pose_t> T_CF_params;
   for (size_t i = 0; i < aprilgrids.size(); i++) {
@@ -80,7 +167,8 @@ int calib_mono_solve(const aprilgrids_t &aprilgrids,
                                    calib_params.proj_params.data(),
                                    calib_params.dist_params.data(),
                                    &T_CF_params[i],
-                                   problem);
+                                   problem,
+                                   opts.analytic_jacobians);
     if (retval != 0) {
       LOG_ERROR("Failed to add AprilGrid measurements to problem!");
       return -1;
@@ -88,17 +176,36 @@ int calib_mono_solve(const aprilgrids_t &aprilgrids,
     problem.SetParameterization(T_CF_params[i].q,
                                 &quaternion_parameterization);
   }
+  camera_model_t cam_model;
+  if (calib_camera_model(calib_params, cam_model) == 0) {
+    calib_dist_params_setup(&problem,
+                            cam_model,
+                            calib_params.dist_params.data());
+  }
 
   // Set solver options
+  const size_t nb_corners = problem.NumResidualBlocks();
   ceres::Solver::Options options;
-  options.minimizer_progress_to_stdout = true;
-  options.max_num_iterations = 100;
+  calib_solver_callbacks_t callbacks;
+  calib_solver_setup(opts,
+                     nb_corners,
+                     t_start,
+                     options,
+                     callbacks,
+                     &problem,
+                     "mono");
   // options.check_gradients = true;
 
   // Solve
-  ceres::Solver::Summary summary;
-  ceres::Solve(options, &problem, &summary);
-  std::cout << summary.FullReport() << std::endl;
+  ceres::Solver::Summary solver_summary;
+  ceres::Solve(options, &problem, &solver_summary);
+  if (opts.verbose) {
+    std::cout << solver_summary.FullReport() << std::endl;
+  }
+  calib_solver_report(opts, "mono", nb_corners, solver_summary);
+  if (summary) {
+    *summary = solver_summary;
+  }
 
   // // Estimate covariance matrix
   // std::vector<std::pair<const double*, const double*>> covar_blocks;
@@ -129,6 +236,11 @@ int calib_mono_solve(const aprilgrids_t &aprilgrids,
 
 static int save_results(const std::string &save_path,
                         const calib_params_t &cam) {
+  camera_model_t model;
+  if (calib_camera_model(cam, model) != 0) {
+    return -1;
+  }
+
   // Open results file
   FILE *outfile = fopen(save_path.c_str(), "w");
   if (outfile == NULL) {
@@ -136,10 +248,11 @@ static int save_results(const std::string &save_path,
   }
 
   // Save results
+  const int dist_size = camera_dist_params_size(model);
   const char *proj_model = cam.proj_model.c_str();
   const char *dist_model = cam.dist_model.c_str();
   const std::string intrinsics = arr2str(cam.proj_params.data(), 4);
-  const std::string distortion = arr2str(cam.dist_params.data(), 4);
+  const std::string distortion = arr2str(cam.dist_params.data(), dist_size);
 
   fprintf(outfile, "cam0:\n");
   fprintf(outfile, "  resolution: [%d, %d]\n", cam.img_w, cam.img_h);
@@ -170,12 +283,29 @@ int calib_mono_solve(const std::string &config_file) {
   parse(config, "settings.data_path", data_path);
   parse(config, "settings.results_fpath", results_fpath);
   parse(config, "settings.imshow", imshow, true);
+  bool frame_influence = false;
+  bool undistort_map = false;
+  bool undistort_poly = false;
+  bool bearing_lut = false;
+  int bearing_lut_step = 1;
+  parse(config, "settings.frame_influence", frame_influence, true);
+  parse(config, "settings.undistort_map", undistort_map, true);
+  parse(config, "settings.undistort_poly", undistort_poly, true);
+  parse(config, "settings.bearing_lut", bearing_lut, true);
+  parse(config, "settings.bearing_lut_step", bearing_lut_step, true);
   parse(config, "cam0.resolution", resolution);
   parse(config, "cam0.lens_hfov", lens_hfov);
   parse(config, "cam0.lens_vfov", lens_vfov);
   parse(config, "cam0.proj_model", proj_model);
   parse(config, "cam0.dist_model", dist_model);
 
+  // Load solver options
+  calib_solver_options_t solver_opts;
+  if (calib_solver_options_load(solver_opts, config_file) != 0) {
+    LOG_ERROR("Failed to load solver options in [%s]!", config_file.c_str());
+    return -1;
+  }
+
   // Load calibration target
   calib_target_t calib_target;
   if (calib_target_load(calib_target, config_file, "calib_target") != 0) {
@@ -220,7 +350,7 @@ int calib_mono_solve(const std::string &config_file) {
   // Calibrate camera
   LOG_INFO("Calibrating camera!");
   mat4s_t T_CF;
-  if (calib_mono_solve(grids, calib_params, T_CF) != 0) {
+  if (calib_mono_solve(grids, calib_params, T_CF, solver_opts) != 0) {
     LOG_ERROR("Failed to calibrate camera data!");
     return -1;
   }
@@ -230,6 +360,22 @@ int calib_mono_solve(const std::string &config_file) {
   std::cout << calib_params.toString(0) << std::endl;
   calib_mono_stats(grids, calib_params, T_CF);
 
+  // Flag frames with an outsized influence on the calibration
+  if (frame_influence) {
+    std::vector<calib_frame_influence_t> infl;
+    if (calib_mono_frame_influence(grids, calib_params, T_CF, infl) != 0) {
+      LOG_ERROR("Failed to perform frame influence analysis!");
+      return -1;
+    }
+    for (const auto &influence : infl) {
+      if (influence.outlier) {
+        LOG_WARN("Frame [%s] has outsized influence, score: %f",
+                 std::to_string(influence.timestamp).c_str(),
+                 influence.score);
+      }
+    }
+  }
+
   // Save results
   printf("\x1B[92mSaving optimization results to [%s]\033[0m\n",
          results_fpath.c_str());
@@ -238,69 +384,236 @@ int calib_mono_solve(const std::string &config_file) {
     return -1;
   }
 
+  // Save undistortion map next to results
+  if (undistort_map) {
+    const std::string map_fpath = undistort_map_fpath(results_fpath, 0);
+    undistort_map_t map;
+    if (undistort_map_init(map, calib_params) != 0 ||
+        undistort_map_save(map, map_fpath) != 0) {
+      LOG_ERROR("Failed to save undistortion map to [%s]!", map_fpath.c_str());
+      return -1;
+    }
+  }
+
+  // Save inverse distortion polynomial next to results
+  if (undistort_poly) {
+    const std::string poly_fpath = undistort_poly_fpath(results_fpath, 0);
+    undistort_poly_t poly;
+    if (undistort_poly_fit(poly, calib_params) != 0 ||
+        undistort_poly_save(poly, poly_fpath) != 0) {
+      LOG_ERROR("Failed to save inverse distortion polynomial to [%s]!",
+                poly_fpath.c_str());
+      return -1;
+    }
+  }
+
+  // Save bearing lookup table next to results
+  if (bearing_lut) {
+    const std::string lut_fpath = bearing_lut_fpath(results_fpath, 0);
+    bearing_lut_t lut;
+    if (bearing_lut_init(lut, calib_params, bearing_lut_step) != 0 ||
+        bearing_lut_save(lut, lut_fpath) != 0) {
+      LOG_ERROR("Failed to save bearing lookup table to [%s]!",
+                lut_fpath.c_str());
+      return -1;
+    }
+  }
+
   return 0;
 }
 
 int calib_mono_stats(const aprilgrids_t &aprilgrids,
                      const calib_params_t &calib_params,
                      const mat4s_t &poses) {
-  const std::string proj_model = calib_params.proj_model;
-  const std::string dist_model = calib_params.dist_model;
-  const double *intrinsics = calib_params.proj_params.data();
-  const double *distortion = calib_params.dist_params.data();
+  calib_obs_t obs;
+  if (calib_obs_init(obs, aprilgrids) != 0) {
+    LOG_ERROR("Failed to form calibration observations!");
+    return -1;
+  }
 
-  // Obtain residuals using optimized params
-  vec2s_t residuals;
-  for (size_t i = 0; i < aprilgrids.size(); i++) {
-    const auto aprilgrid = aprilgrids[i];
-
-    // Form relative pose
-    const mat4_t T_CF = poses[i];
-    const quat_t q_CF = tf_quat(T_CF);
-    const vec3_t r_CF = tf_trans(T_CF);
-
-    // Iterate over all tags in AprilGrid
-    for (const auto &tag_id : aprilgrid.ids) {
-      // Get keypoints
-      vec2s_t keypoints;
-      if (aprilgrid_get(aprilgrid, tag_id, keypoints) != 0) {
-        LOG_ERROR("Failed to get AprilGrid keypoints!");
-        return -1;
-      }
+  // Evaluate residuals using optimized params with per frame, per tag and
+  // per image region breakdowns
+  calib_stats_t stats;
+  if (calib_stats_init(stats, obs, calib_params, poses) != 0) {
+    LOG_ERROR("Failed to evaluate calibration statistics!");
+    return -1;
+  }
+  calib_stats_print(stats);
 
-      // Get object points
-      vec3s_t object_points;
-      if (aprilgrid_object_points(aprilgrid, tag_id, object_points) != 0) {
-        LOG_ERROR("Failed to calculate AprilGrid object points!");
-        return -1;
-      }
+  return 0;
+}
+
+int calib_mono_frame_info(const aprilgrid_t &grid,
+                          const calib_params_t &calib_params,
+                          const mat4_t &T_CF,
+                          matx_t &H,
+                          vecx_t &b) {
+  // Only the distortion parameters the camera model uses are estimated
+  camera_model_t cam_model;
+  if (calib_camera_model(calib_params, cam_model) != 0) {
+    return -1;
+  }
+  const int nb_dist = camera_dist_params_size(cam_model);
+  const int nb_x = 4 + nb_dist;
+
+  const quat_t q_CF = tf_quat(T_CF);
+  const vec3_t r_CF = tf_trans(T_CF);
+  const double *params[4] = {calib_params.proj_params.data(),
+                             calib_params.dist_params.data(),
+                             q_CF.coeffs().data(),
+                             r_CF.data()};
+
+  // Quaternion jacobian w.r.t. its tangent space
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+  mat_t<4, 3, Eigen::RowMajor> J_q_local;
+  quaternion_parameterization.ComputeJacobian(q_CF.coeffs().data(),
+                                              J_q_local.data());
+
+  // Accumulate information of camera parameters x and frame pose p
+  matx_t H_xx = zeros(nb_x, nb_x);
+  matx_t H_xp = zeros(nb_x, 6);
+  mat_t<6, 6> H_pp = zeros(6, 6);
+  vecx_t b_x = zeros(nb_x, 1);
+  vec_t<6> b_p = zeros(6, 1);
+
+  for (const auto &tag_id : grid.ids) {
+    vec2s_t keypoints;
+    if (aprilgrid_get(grid, tag_id, keypoints) != 0) {
+      LOG_ERROR("Failed to get AprilGrid keypoints!");
+      return -1;
+    }
+
+    vec3s_t object_points;
+    if (aprilgrid_object_points(grid, tag_id, object_points) != 0) {
+      LOG_ERROR("Failed to calculate AprilGrid object points!");
+      return -1;
+    }
 
-      // Form residual and call the functor for four corners of the tag
-      for (size_t j = 0; j < 4; j++) {
-        const calib_mono_residual_t residual{proj_model, dist_model,
-                                             keypoints[j], object_points[j]};
-        real_t res[2] = {0.0, 0.0};
-        residual(intrinsics,
-                 distortion,
-                 q_CF.coeffs().data(),
-                 r_CF.data(),
-                 res);
-        residuals.emplace_back(res[0], res[1]);
+    for (size_t i = 0; i < 4; i++) {
+      const auto residual = new calib_mono_residual_t{calib_params.proj_model,
+                                                      calib_params.dist_model,
+                                                      keypoints[i],
+                                                      object_points[i]};
+      const ceres::AutoDiffCostFunction<calib_mono_residual_t,
+                                        2, 4, 4, 4, 3> cost_func{residual};
+
+      vec2_t e;
+      mat_t<2, 4, Eigen::RowMajor> J_proj;
+      mat_t<2, 4, Eigen::RowMajor> J_dist;
+      mat_t<2, 4, Eigen::RowMajor> J_q;
+      mat_t<2, 3, Eigen::RowMajor> J_r;
+      double *jacobians[4] = {J_proj.data(),
+                              J_dist.data(),
+                              J_q.data(),
+                              J_r.data()};
+      if (cost_func.Evaluate(params, e.data(), jacobians) == false) {
+        continue;
       }
+
+      matx_t J_x{2, nb_x};
+      J_x << J_proj, J_dist.leftCols(nb_dist);
+      mat_t<2, 6> J_p;
+      J_p << J_q * J_q_local, J_r;
+
+      H_xx += J_x.transpose() * J_x;
+      H_xp += J_x.transpose() * J_p;
+      H_pp += J_p.transpose() * J_p;
+      b_x -= J_x.transpose() * e;
+      b_p -= J_p.transpose() * e;
     }
   }
 
-  // Calculate RMSE reprojection error
-  real_t err_sum = 0.0;
-  for (auto &residual : residuals) {
-    const real_t err = residual.norm();
-    const real_t err_sq = err * err;
-    err_sum += err_sq;
+  // Marginalize frame pose
+  const Eigen::LDLT<mat_t<6, 6>> H_pp_ldlt(H_pp);
+  if (H_pp_ldlt.info() != Eigen::Success || H_pp_ldlt.isPositive() == false) {
+    LOG_ERROR("Frame pose is not observable!");
+    return -1;
+  }
+  H = H_xx - H_xp * H_pp_ldlt.solve(H_xp.transpose());
+  b = b_x - H_xp * H_pp_ldlt.solve(b_p);
+
+  return 0;
+}
+
+int calib_mono_frame_influence(const aprilgrids_t &aprilgrids,
+                               const calib_params_t &calib_params,
+                               const mat4s_t &T_CF,
+                               std::vector<calib_frame_influence_t> &influences,
+                               const real_t outlier_threshold) {
+  assert(aprilgrids.size() == T_CF.size());
+  const size_t nb_frames = aprilgrids.size();
+
+  camera_model_t cam_model;
+  if (calib_camera_model(calib_params, cam_model) != 0) {
+    return -1;
+  }
+  const int nb_x = 4 + camera_dist_params_size(cam_model);
+
+  // Information of each frame
+  matxs_t H_frames(nb_frames);
+  vecxs_t b_frames(nb_frames);
+  std::vector<int> status(nb_frames, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < nb_frames; i++) {
+    status[i] = calib_mono_frame_info(aprilgrids[i],
+                                      calib_params,
+                                      T_CF[i],
+                                      H_frames[i],
+                                      b_frames[i]);
+  }
+
+  matx_t H = zeros(nb_x, nb_x);
+  for (size_t i = 0; i < nb_frames; i++) {
+    if (status[i] != 0) {
+      LOG_ERROR("Failed to compute information of frame [%zu]!", i);
+      return -1;
+    }
+    H += H_frames[i];
+  }
+
+  // Change in camera parameters and covariance if each frame were dropped
+  influences.clear();
+  influences.resize(nb_frames);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < nb_frames; i++) {
+    auto &influence = influences[i];
+    influence.timestamp = aprilgrids[i].timestamp;
+    influence.nb_corners = aprilgrids[i].ids.size() * 4;
+
+    const matx_t H_drop = H - H_frames[i];
+    const Eigen::SelfAdjointEigenSolver<matx_t> eig(H_drop);
+    const vecx_t lambda = eig.eigenvalues();
+    if (lambda(0) <= 1e-12 * lambda(lambda.size() - 1)) {
+      influence.score = -1.0;
+      continue;
+    }
+    const matx_t V = eig.eigenvectors();
+    influence.covar = V * lambda.cwiseInverse().asDiagonal() * V.transpose();
+    influence.dparams = -influence.covar * b_frames[i];
+    influence.score = influence.dparams.transpose() * H * influence.dparams;
+  }
+
+  // Flag outliers with a robust z-score on the frame scores
+  std::vector<real_t> scores;
+  for (const auto &influence : influences) {
+    if (influence.score >= 0.0) {
+      scores.push_back(influence.score);
+    }
+  }
+  if (scores.size() == 0) {
+    return 0;
+  }
+  const real_t score_median = median(scores);
+  std::vector<real_t> deviations;
+  for (const auto score : scores) {
+    deviations.push_back(fabs(score - score_median));
+  }
+  const real_t score_std = 1.4826 * median(deviations);
+  for (auto &influence : influences) {
+    const real_t dev = influence.score - score_median;
+    influence.outlier = (influence.score >= 0.0) &&
+                        (dev > outlier_threshold * score_std);
   }
-  const real_t err_mean = err_sum / (real_t) residuals.size();
-  const real_t rmse = sqrt(err_mean);
-  std::cout << "nb_residuals: " << residuals.size() << std::endl;
-  std::cout << "RMSE Reprojection Error [px]: " << rmse << std::endl;
 
   return 0;
 }
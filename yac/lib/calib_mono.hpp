@@ -9,6 +9,8 @@
 
 #include "core.hpp"
 #include "calib_data.hpp"
+#include "calib_solver.hpp"
+#include "calib_undistort.hpp"
 
 namespace yac {
 
@@ -64,6 +66,10 @@ struct calib_mono_residual_t {
       if (pinhole_equi4_project(cam_params, p_C, z_hat) != 0) {
         return false;
       }
+    } else if (proj_model_ == "double_sphere" && dist_model_ == "none") {
+      if (double_sphere_project(cam_params, p_C, z_hat) != 0) {
+        return false;
+      }
     } else {
       FATAL("Unsupported [%s-%s] projection distortion combination!",
             proj_model_.c_str(), dist_model_.c_str());
@@ -77,15 +83,48 @@ struct calib_mono_residual_t {
   }
 };
 
+/**
+ * Calibration mono residual with analytic Jacobians. Same residual and
+ * Jacobians as the auto-diff `calib_mono_residual_t`, including the Jacobian
+ * w.r.t. the quaternion coefficients of `q_CF`, so it can be used with
+ * `ceres::EigenQuaternionParameterization` in place of the auto-diff
+ * residual.
+ */
+struct calib_mono_analytic_residual_t
+    : ceres::SizedCostFunction<2, 4, 4, 4, 3> {
+  camera_model_t cam_model_ = PINHOLE_RADTAN4;
+  double z_[2] = {0.0, 0.0};        ///< Measurement
+  double p_F_[3] = {0.0, 0.0, 0.0}; ///< Object point
+
+  calib_mono_analytic_residual_t(const camera_model_t cam_model,
+                                 const vec2_t &z,
+                                 const vec3_t &p_F)
+      : cam_model_{cam_model},
+        z_{z(0), z(1)},
+        p_F_{p_F(0), p_F(1), p_F(2)} {}
+
+  ~calib_mono_analytic_residual_t() {}
+
+  bool Evaluate(double const *const *params,
+                double *residuals,
+                double **jacobians) const;
+};
+
 /**
  * Calibrate camera intrinsics and relative pose between camera and fiducial
- * calibration target.
+ * calibration target. The solver may stop early according to `opts`, and
+ * uses `calib_mono_analytic_residual_t` if `opts.analytic_jacobians` is set.
+ * The solver `summary` is returned if given, e.g. to find out why the solver
+ * terminated.
  *
  * @returns 0 or -1 for success or failure
  */
 int calib_mono_solve(const aprilgrids_t &aprilgrids,
                      calib_params_t &calib_params,
-                     mat4s_t &T_CF);
+                     mat4s_t &T_CF,
+                     const calib_solver_options_t &opts =
+                         calib_solver_options_t(),
+                     ceres::Solver::Summary *summary = nullptr);
 
 /**
  * Calibrate camera intrinsics and relative pose between camera and fiducial
@@ -96,6 +135,11 @@ int calib_mono_solve(const aprilgrids_t &aprilgrids,
  *       data_path: "/data"
  *       results_fpath: "/data/calib_results.yaml"
  *       imshow: true
+ *       frame_influence: false    # Optional, flag outlier frames
+ *       undistort_map: false      # Optional, save undistortion map
+ *       undistort_poly: false     # Optional, save inverse distortion poly
+ *       bearing_lut: false        # Optional, save bearing lookup table
+ *       bearing_lut_step: 1       # Optional, bearing lookup table pixel step
  *
  *     calib_target:
  *       target_type: 'aprilgrid'  # Target type
@@ -110,8 +154,12 @@ int calib_mono_solve(const aprilgrids_t &aprilgrids,
  *       resolution: [752, 480]
  *       lens_hfov: 98.0
  *       lens_vfov: 73.0
- *       proj_model: "pinhole"
- *       dist_model: "radtan4"
+ *       proj_model: "pinhole"     # "pinhole" or "double_sphere"
+ *       dist_model: "radtan4"     # "radtan4", "equi4" or "none"
+ *
+ *     solver:                    # Optional, see calib_solver_options_load()
+ *       rmse_plateau_tol: 0.001  # [px]
+ *       deadline: 30.0           # [s]
  *
  * @returns 0 or -1 for success or failure
  */
@@ -127,6 +175,65 @@ int calib_mono_stats(const aprilgrids_t &aprilgrids,
                      const calib_params_t &calib_params,
                      const mat4s_t &poses);
 
+/**
+ * Information a single frame contributes to the camera parameters, with the
+ * frame pose `T_CF` marginalized out (Schur complement). For the Jacobians
+ * J_x = de/dx of the frame residuals e w.r.t. the camera parameters x =
+ * [proj_params, dist_params] and J_p w.r.t. the frame pose p (tangent space)
+ *
+ *     H = J_x^T J_x - J_x^T J_p (J_p^T J_p)^-1 J_p^T J_x
+ *     b = -J_x^T e + J_x^T J_p (J_p^T J_p)^-1 J_p^T e
+ *
+ * such that summed over all frames the Gauss-Newton step of the camera
+ * parameters is H^-1 b. Only the distortion parameters the camera model uses
+ * are part of x, e.g. the first two of the double sphere model, so H is
+ * `4 + camera_dist_params_size()` square. Corners that fail to project are
+ * skipped.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_mono_frame_info(const aprilgrid_t &grid,
+                          const calib_params_t &calib_params,
+                          const mat4_t &T_CF,
+                          matx_t &H,
+                          vecx_t &b);
+
+/**
+ * Influence of a single frame on the camera calibration.
+ */
+struct calib_frame_influence_t {
+  timestamp_t timestamp = 0;
+  size_t nb_corners = 0;
+  vecx_t dparams;     ///< Change in used camera parameters if dropped
+  matx_t covar;       ///< Covariance of camera parameters if dropped
+  real_t score = 0.0; ///< Mahalanobis norm of dparams, -1 if not observable
+  bool outlier = false;
+
+  calib_frame_influence_t() {}
+  ~calib_frame_influence_t() {}
+};
+
+/**
+ * Leave-one-out frame influence analysis of a mono camera calibration at its
+ * solution (`calib_params`, `T_CF`). The information of each frame is
+ * computed once with `calib_mono_frame_info()`, then the change of the camera
+ * parameters and their covariance if a frame were dropped is obtained from a
+ * single Gauss-Newton step on the remaining information, without re-solving.
+ * Frames are processed in parallel. The covariance assumes unit pixel noise.
+ *
+ * A frame's `score` is `dparams^T H dparams`, where H is the information of
+ * all frames, and frames whose score exceeds the median by more than
+ * `outlier_threshold` robust standard deviations (1.4826 MAD) are flagged as
+ * outliers.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_mono_frame_influence(const aprilgrids_t &aprilgrids,
+                               const calib_params_t &calib_params,
+                               const mat4s_t &T_CF,
+                               std::vector<calib_frame_influence_t> &influences,
+                               const real_t outlier_threshold = 3.0);
+
 /**
  * Generate poses
  */
@@ -0,0 +1,312 @@
+#include <omp.h>
+
+#include "calib_solver.hpp"
+
+namespace yac {
+
+void calib_dist_params_setup(ceres::Problem *problem,
+                             const camera_model_t model,
+                             double *dist_params) {
+  if (camera_dist_params_size(model) == 4 ||
+      problem->HasParameterBlock(dist_params) == false) {
+    return;
+  }
+
+  // Stateless, so one instance serves every problem
+  static ceres::SubsetParameterization unused_params(4, {2, 3});
+  problem->SetParameterization(dist_params, &unused_params);
+}
+
+int calib_solver_options_load(calib_solver_options_t &opts,
+                              const std::string &config_file,
+                              const std::string &prefix) {
+  config_t config{config_file};
+  if (config.ok == false) {
+    LOG_ERROR("Failed to load config file [%s]!", config_file.c_str());
+    return -1;
+  }
+
+  const auto key = [prefix](const std::string &k) {
+    return (prefix == "") ? k : prefix + "." + k;
+  };
+  parse(config, key("max_iter"), opts.max_iter, true);
+  parse(config, key("num_threads"), opts.num_threads, true);
+  parse(config, key("rmse_plateau_tol"), opts.rmse_plateau_tol, true);
+  parse(config, key("rmse_plateau_iters"), opts.rmse_plateau_iters, true);
+  parse(config, key("deadline"), opts.deadline, true);
+  parse(config, key("verbose"), opts.verbose, true);
+  parse(config, key("analytic_jacobians"), opts.analytic_jacobians, true);
+  parse(config, key("telemetry"), opts.telemetry, true);
+
+  return 0;
+}
+
+rmse_plateau_callback_t::rmse_plateau_callback_t(const size_t nb_corners_,
+                                                 const real_t tol_,
+                                                 const int max_iters_,
+                                                 const bool verbose_)
+    : nb_corners{nb_corners_}, tol{tol_}, max_iters{max_iters_},
+      verbose{verbose_} {}
+
+ceres::CallbackReturnType rmse_plateau_callback_t::
+operator()(const ceres::IterationSummary &summary) {
+  if (nb_corners == 0) {
+    return ceres::SOLVER_CONTINUE;
+  }
+
+  // Only consider accepted steps, rejected steps do not change the estimate
+  const real_t rmse = sqrt(2.0 * summary.cost / nb_corners);
+  if (summary.iteration == 0) {
+    best_rmse = rmse;
+    return ceres::SOLVER_CONTINUE;
+  } else if (summary.step_is_successful == false) {
+    return ceres::SOLVER_CONTINUE;
+  }
+
+  // Check RMSE improvement
+  nb_plateau_iters = ((best_rmse - rmse) < tol) ? nb_plateau_iters + 1 : 0;
+  best_rmse = std::min(best_rmse, rmse);
+  if (nb_plateau_iters >= max_iters) {
+    if (verbose) {
+      LOG_INFO("RMSE plateaued at %f [px], stopping early!", best_rmse);
+    }
+    return ceres::SOLVER_TERMINATE_SUCCESSFULLY;
+  }
+
+  return ceres::SOLVER_CONTINUE;
+}
+
+deadline_callback_t::deadline_callback_t(const struct timespec &t_start_,
+                                         const real_t deadline_,
+                                         const bool verbose_)
+    : t_start{t_start_}, deadline{deadline_}, verbose{verbose_} {}
+
+ceres::CallbackReturnType deadline_callback_t::
+operator()(const ceres::IterationSummary &summary) {
+  UNUSED(summary);
+  struct timespec t = t_start;
+  if (toc(&t) > deadline) {
+    if (verbose) {
+      LOG_INFO("Deadline of %f [s] reached, stopping early!", deadline);
+    }
+    return ceres::SOLVER_TERMINATE_SUCCESSFULLY;
+  }
+
+  return ceres::SOLVER_CONTINUE;
+}
+
+calib_telemetry_t::calib_telemetry_t(const std::string &path_,
+                                     const std::string &solve_,
+                                     const size_t nb_corners_,
+                                     const int nb_residual_blocks_,
+                                     const int nb_parameter_blocks_)
+    : path{path_}, solve{solve_}, nb_corners{nb_corners_},
+      nb_residual_blocks{nb_residual_blocks_},
+      nb_parameter_blocks{nb_parameter_blocks_} {
+  if (path != "stdout" && path != "stderr") {
+    sink.open(path, std::ios::app);
+    if (sink.good() == false) {
+      LOG_ERROR("Failed to open telemetry sink [%s]!", path.c_str());
+    }
+  }
+}
+
+static real_t telemetry_rmse(const real_t cost, const size_t nb_corners) {
+  return (nb_corners) ? sqrt(2.0 * cost / nb_corners) : 0.0;
+}
+
+static std::string telemetry_number(const real_t x) {
+  // JSON has no NaN or infinity
+  if (std::isfinite(x) == false) {
+    return "null";
+  }
+
+  std::ostringstream ss;
+  ss.precision(10);
+  ss << x;
+  return ss.str();
+}
+
+static int telemetry_write(std::ostream &sink, const std::string &line) {
+  // Write line in one go so lines of concurrent solves do not interleave
+  const std::string buf = line + "\n";
+  sink.write(buf.data(), buf.size());
+  sink.flush();
+  return (sink.good()) ? 0 : -1;
+}
+
+ceres::CallbackReturnType calib_telemetry_t::
+operator()(const ceres::IterationSummary &summary) {
+  const real_t linear_time = summary.step_solver_time_in_seconds;
+  const real_t eval_time = summary.iteration_time_in_seconds - linear_time;
+
+  const real_t rmse = telemetry_rmse(summary.cost, nb_corners);
+  const real_t cumulative_time = summary.cumulative_time_in_seconds;
+
+  std::ostringstream line;
+  line.precision(10);
+  line << "{\"solve\": \"" << solve << "\"";
+  line << ", \"type\": \"iteration\"";
+  line << ", \"time\": " << std::fixed << time_now() << std::defaultfloat;
+  line << ", \"iter\": " << summary.iteration;
+  line << ", \"cost\": " << telemetry_number(summary.cost);
+  line << ", \"cost_change\": " << telemetry_number(summary.cost_change);
+  line << ", \"rmse\": " << telemetry_number(rmse);
+  line << ", \"gradient_max_norm\": "
+       << telemetry_number(summary.gradient_max_norm);
+  line << ", \"step_norm\": " << telemetry_number(summary.step_norm);
+  line << ", \"step_ok\": " << (summary.step_is_successful ? "true" : "false");
+  line << ", \"trust_region_radius\": "
+       << telemetry_number(summary.trust_region_radius);
+  line << ", \"linear_solver_iters\": " << summary.linear_solver_iterations;
+  line << ", \"eval_time\": " << telemetry_number(eval_time);
+  line << ", \"linear_time\": " << telemetry_number(linear_time);
+  line << ", \"cumulative_time\": " << telemetry_number(cumulative_time);
+  line << ", \"nb_residual_blocks\": " << nb_residual_blocks;
+  line << ", \"nb_parameter_blocks\": " << nb_parameter_blocks;
+  line << "}";
+
+  if (path == "stdout") {
+    telemetry_write(std::cout, line.str());
+  } else if (path == "stderr") {
+    telemetry_write(std::cerr, line.str());
+  } else if (sink.is_open()) {
+    telemetry_write(sink, line.str());
+  }
+
+  return ceres::SOLVER_CONTINUE;
+}
+
+int calib_telemetry_write(const std::string &path, const std::string &line) {
+  if (path == "stdout") {
+    return telemetry_write(std::cout, line);
+  } else if (path == "stderr") {
+    return telemetry_write(std::cerr, line);
+  }
+
+  std::ofstream sink(path, std::ios::app);
+  if (sink.good() == false) {
+    LOG_ERROR("Failed to open telemetry sink [%s]!", path.c_str());
+    return -1;
+  }
+
+  return telemetry_write(sink, line);
+}
+
+void calib_solver_setup(const calib_solver_options_t &opts,
+                        const size_t nb_corners,
+                        const struct timespec &t_start,
+                        ceres::Solver::Options &options,
+                        calib_solver_callbacks_t &callbacks,
+                        const ceres::Problem *problem,
+                        const std::string &solve) {
+  options.minimizer_progress_to_stdout = opts.verbose;
+  options.max_num_iterations = opts.max_iter;
+  options.num_threads = std::min(opts.num_threads, omp_get_max_threads());
+
+  if (opts.rmse_plateau_tol > 0.0) {
+    callbacks.emplace_back(new rmse_plateau_callback_t{nb_corners,
+                                                       opts.rmse_plateau_tol,
+                                                       opts.rmse_plateau_iters,
+                                                       opts.verbose});
+  }
+  if (opts.deadline > 0.0) {
+    callbacks.emplace_back(
+        new deadline_callback_t{t_start, opts.deadline, opts.verbose});
+  }
+
+  if (opts.telemetry != "") {
+    const int nb_residual_blocks = (problem) ? problem->NumResidualBlocks() : 0;
+    const int nb_param_blocks = (problem) ? problem->NumParameterBlocks() : 0;
+    callbacks.emplace_back(new calib_telemetry_t{opts.telemetry,
+                                                 solve,
+                                                 nb_corners,
+                                                 nb_residual_blocks,
+                                                 nb_param_blocks});
+  }
+
+  for (auto &callback : callbacks) {
+    options.callbacks.push_back(callback.get());
+  }
+}
+
+void calib_solver_report(const calib_solver_options_t &opts,
+                         const std::string &solve,
+                         const size_t nb_corners,
+                         const ceres::Solver::Summary &summary) {
+  if (opts.telemetry == "") {
+    return;
+  }
+
+  const std::string termination =
+      ceres::TerminationTypeToString(summary.termination_type);
+  const size_t nb_iters = summary.iterations.size();
+  const real_t jacobian_time = summary.jacobian_evaluation_time_in_seconds;
+
+  std::ostringstream line;
+  line.precision(10);
+  line << "{\"solve\": \"" << solve << "\"";
+  line << ", \"type\": \"summary\"";
+  line << ", \"time\": " << std::fixed << time_now() << std::defaultfloat;
+  line << ", \"termination\": \"" << termination << "\"";
+  line << ", \"iters\": " << ((nb_iters) ? nb_iters - 1 : 0);
+  line << ", \"initial_cost\": " << telemetry_number(summary.initial_cost);
+  line << ", \"final_cost\": " << telemetry_number(summary.final_cost);
+  line << ", \"initial_rmse\": "
+       << telemetry_number(telemetry_rmse(summary.initial_cost, nb_corners));
+  line << ", \"final_rmse\": "
+       << telemetry_number(telemetry_rmse(summary.final_cost, nb_corners));
+  line << ", \"total_time\": "
+       << telemetry_number(summary.total_time_in_seconds);
+  line << ", \"residual_time\": "
+       << telemetry_number(summary.residual_evaluation_time_in_seconds);
+  line << ", \"jacobian_time\": " << telemetry_number(jacobian_time);
+  line << ", \"linear_time\": "
+       << telemetry_number(summary.linear_solver_time_in_seconds);
+  line << ", \"nb_corners\": " << nb_corners;
+  line << ", \"nb_residual_blocks\": " << summary.num_residual_blocks;
+  line << ", \"nb_residuals\": " << summary.num_residuals;
+  line << ", \"nb_parameter_blocks\": " << summary.num_parameter_blocks;
+  line << ", \"nb_parameters\": " << summary.num_parameters;
+  line << ", \"nb_effective_parameters\": "
+       << summary.num_effective_parameters;
+  line << "}";
+  calib_telemetry_write(opts.telemetry, line.str());
+}
+
+int calib_covar_dense(ceres::Problem *problem,
+                      const std::vector<double *> &param_blocks,
+                      matx_t &covar) {
+  // Evaluate jacobian w.r.t. the given parameter blocks only
+  ceres::Problem::EvaluateOptions eval_opts;
+  eval_opts.parameter_blocks = param_blocks;
+  ceres::CRSMatrix J;
+  if (problem->Evaluate(eval_opts, NULL, NULL, NULL, &J) == false) {
+    LOG_ERROR("Failed to evaluate problem jacobian!");
+    return -1;
+  }
+
+  // Form information matrix H = J^T J row by row
+  matx_t H = zeros(J.num_cols, J.num_cols);
+  for (int r = 0; r < J.num_rows; r++) {
+    for (int i = J.rows[r]; i < J.rows[r + 1]; i++) {
+      for (int j = J.rows[r]; j < J.rows[r + 1]; j++) {
+        H(J.cols[i], J.cols[j]) += J.values[i] * J.values[j];
+      }
+    }
+  }
+
+  // Invert information matrix
+  const Eigen::SelfAdjointEigenSolver<matx_t> eig(H);
+  const vecx_t lambda = eig.eigenvalues();
+  if (lambda.size() == 0 || lambda(0) <= 1e-12 * lambda(lambda.size() - 1)) {
+    LOG_ERROR("Information matrix is rank deficient!");
+    return -1;
+  }
+  const matx_t V = eig.eigenvectors();
+  covar = V * lambda.cwiseInverse().asDiagonal() * V.transpose();
+
+  return 0;
+}
+
+} //  namespace yac
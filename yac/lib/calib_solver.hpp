@@ -0,0 +1,194 @@
+#ifndef YAC_CALIB_SOLVER_HPP
+#define YAC_CALIB_SOLVER_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+
+#include <ceres/ceres.h>
+
+#include "core.hpp"
+#include "calib_data.hpp"
+
+namespace yac {
+
+/**
+ * Hold the distortion parameters `dist_params` that camera `model` does not
+ * use constant in `problem`, i.e. the last two of the double sphere model.
+ * Left free they have no effect on the residuals and make the problem rank
+ * deficient. Does nothing if the `dist_params` block is not in `problem`
+ * yet. The `problem` must not take ownership of local parameterizations.
+ */
+void calib_dist_params_setup(ceres::Problem *problem,
+                             const camera_model_t model,
+                             double *dist_params);
+
+/**
+ * Calibration solver options. The early termination rules are disabled when
+ * their thresholds are set to zero.
+ */
+struct calib_solver_options_t {
+  int max_iter = 100;              ///< Max number of solver iterations
+  int num_threads = 1;             ///< Threads used by the solver
+  real_t rmse_plateau_tol = 0.0;   ///< Min RMSE improvement per iteration [px]
+  int rmse_plateau_iters = 3;      ///< Iterations below tolerance before stop
+  real_t deadline = 0.0;           ///< Wall-clock budget [s]
+  bool verbose = true;             ///< Print solver progress and report
+  bool analytic_jacobians = false; ///< Use analytic residual Jacobians
+  std::string telemetry = "";      ///< JSON lines sink, file or "stdout"
+
+  calib_solver_options_t() {}
+  ~calib_solver_options_t() {}
+};
+
+/**
+ * Load calibration solver options. This function assumes that the path to
+ * `config_file` is a yaml file where all keys are optional:
+ *
+ *     solver:
+ *       max_iter: 100
+ *       num_threads: 1
+ *       rmse_plateau_tol: 0.001  # [px]
+ *       rmse_plateau_iters: 3
+ *       deadline: 30.0           # [s]
+ *       verbose: true
+ *       analytic_jacobians: false
+ *       telemetry: "/data/solver.jsonl"  # Or "stdout", see calib_telemetry_t
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_solver_options_load(calib_solver_options_t &opts,
+                              const std::string &config_file,
+                              const std::string &prefix = "solver");
+
+/**
+ * Terminate solver once the reprojection RMSE stops improving by more than
+ * `tol` [px] for `max_iters` consecutive iterations. The RMSE is derived from
+ * the cost, assuming all residuals are 2D reprojection errors.
+ */
+struct rmse_plateau_callback_t : ceres::IterationCallback {
+  const size_t nb_corners = 0;
+  const real_t tol = 0.0;
+  const int max_iters = 0;
+  const bool verbose = true;
+
+  real_t best_rmse = 0.0;
+  int nb_plateau_iters = 0;
+
+  rmse_plateau_callback_t(const size_t nb_corners_,
+                          const real_t tol_,
+                          const int max_iters_,
+                          const bool verbose_ = true);
+  ~rmse_plateau_callback_t() {}
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary &summary);
+};
+
+/**
+ * Terminate solver once the wall-clock time since `t_start` exceeds
+ * `deadline` [s]. The solver returns the best estimate so far.
+ */
+struct deadline_callback_t : ceres::IterationCallback {
+  const struct timespec t_start;
+  const real_t deadline = 0.0;
+  const bool verbose = true;
+
+  deadline_callback_t(const struct timespec &t_start_,
+                      const real_t deadline_,
+                      const bool verbose_ = true);
+  ~deadline_callback_t() {}
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary &summary);
+};
+
+/**
+ * Per-iteration solver telemetry. Every iteration is appended to the sink
+ * `path` (a file, or "stdout" / "stderr") as one JSON object per line:
+ *
+ *     {"solve": "mono", "type": "iteration", "iter": 1, "cost": ...,
+ *      "rmse": ..., "step_norm": ..., "eval_time": ..., "linear_time": ...,
+ *      "nb_residual_blocks": ..., "nb_parameter_blocks": ..., ...}
+ *
+ * where `eval_time` is the time spent outside the linear solver, i.e. mostly
+ * residual and Jacobian evaluation. Times are in seconds, RMSE in pixels, and
+ * non-finite values are written as `null`. A file sink is opened once in
+ * append mode and kept open for the lifetime of the callback.
+ */
+struct calib_telemetry_t : ceres::IterationCallback {
+  const std::string path;
+  const std::string solve;
+  const size_t nb_corners = 0;
+  const int nb_residual_blocks = 0;
+  const int nb_parameter_blocks = 0;
+  std::ofstream sink;
+
+  calib_telemetry_t(const std::string &path_,
+                    const std::string &solve_,
+                    const size_t nb_corners_,
+                    const int nb_residual_blocks_,
+                    const int nb_parameter_blocks_);
+  ~calib_telemetry_t() {}
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary &summary);
+};
+
+/**
+ * Append one JSON line `line` (without newline) to the telemetry sink `path`.
+ * The sink is opened for this line only, meant for one-off lines such as the
+ * solve summary. Each line is written whole, so concurrent solves may share a
+ * sink.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_telemetry_write(const std::string &path, const std::string &line);
+
+/**
+ * Calibration solver callbacks
+ */
+typedef std::vector<std::unique_ptr<ceres::IterationCallback>>
+    calib_solver_callbacks_t;
+
+/**
+ * Setup ceres solver `options` and early termination `callbacks` from
+ * calibration solver options `opts`. Where `nb_corners` is the number of
+ * reprojected corners in the problem and `t_start` is the time the
+ * calibration started. The `callbacks` must outlive the solve. If telemetry
+ * is enabled the iterations are tagged with `solve`, and the block counts are
+ * taken from `problem` if given. The solver threads are limited to the
+ * OpenMP threads of the calling thread, see `omp_set_num_threads()`.
+ */
+void calib_solver_setup(const calib_solver_options_t &opts,
+                        const size_t nb_corners,
+                        const struct timespec &t_start,
+                        ceres::Solver::Options &options,
+                        calib_solver_callbacks_t &callbacks,
+                        const ceres::Problem *problem = nullptr,
+                        const std::string &solve = "");
+
+/**
+ * Report solver `summary` of calibration `solve` to the telemetry sink, if
+ * enabled, as a "summary" JSON line with the termination type, costs, RMSE,
+ * timings and problem size.
+ */
+void calib_solver_report(const calib_solver_options_t &opts,
+                         const std::string &solve,
+                         const size_t nb_corners,
+                         const ceres::Solver::Summary &summary);
+
+/**
+ * Dense covariance of the parameter blocks `param_blocks` in `problem`. The
+ * information matrix H = J^T J is assembled over `param_blocks` only, with all
+ * other parameter blocks held at their current values, and inverted densely.
+ * The covariance is in the tangent space of each block and ordered as
+ * `param_blocks`. Meant for problems with few free parameters, in place of
+ * `ceres::Covariance` with a sparse factorization.
+ *
+ * @returns 0 or -1 for success or failure (rank deficient)
+ */
+int calib_covar_dense(ceres::Problem *problem,
+                      const std::vector<double *> &param_blocks,
+                      matx_t &covar);
+
+} //  namespace yac
+#endif // YAC_CALIB_SOLVER_HPP
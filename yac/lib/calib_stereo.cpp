@@ -2,41 +2,92 @@
 
 namespace yac {
 
+static int setup_calib_data(const aprilgrids_t &cam0_aprilgrids,
+                            const calib_params_t &cam0_params,
+                            const calib_params_t &cam1_params,
+                            camera_model_t &cam0_model,
+                            camera_model_t &cam1_model,
+                            vec3s_t &object_points) {
+  if (calib_camera_model(cam0_params, cam0_model) != 0 ||
+      calib_camera_model(cam1_params, cam1_model) != 0) {
+    return -1;
+  }
+
+  // Object point table shared by all residuals, where the object point of
+  // corner `j` of tag `i` is at index `i * 4 + j`
+  object_points.clear();
+  if (cam0_aprilgrids.size() > 0) {
+    if (aprilgrid_object_points(cam0_aprilgrids[0], object_points) != 0) {
+      LOG_ERROR("Failed to calculate AprilGrid object points!");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int tag_index(const aprilgrid_t &grid, const int tag_id) {
+  for (size_t i = 0; i < grid.ids.size(); i++) {
+    if (grid.ids[i] == tag_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 static int process_aprilgrid(const aprilgrid_t &cam0_aprilgrid,
                              const aprilgrid_t &cam1_aprilgrid,
+                             const camera_model_t cam0_model,
+                             const camera_model_t cam1_model,
+                             const vec3s_t *object_points,
                              calib_params_t &cam0_params,
                              calib_params_t &cam1_params,
-                             calib_pose_t *T_C0C1,
+                             calib_pose_t *T_C1C0,
                              calib_pose_t *T_C0F,
                              ceres::Problem *problem) {
-  for (const auto &tag_id : cam0_aprilgrid.ids) {
-    // Get keypoints
-    vec2s_t cam0_keypoints;
-    if (aprilgrid_get(cam0_aprilgrid, tag_id, cam0_keypoints) != 0) {
-      LOG_ERROR("Failed to get AprilGrid keypoints!");
-      return -1;
-    }
-    vec2s_t cam1_keypoints;
-    if (aprilgrid_get(cam1_aprilgrid, tag_id, cam1_keypoints) != 0) {
-      LOG_ERROR("Failed to get AprilGrid keypoints!");
-      return -1;
-    }
-
-    // Get object points
-    vec3s_t object_points;
-    if (aprilgrid_object_points(cam0_aprilgrid, tag_id, object_points) != 0) {
-      LOG_ERROR("Failed to calculate AprilGrid object points!");
+  // Corners observed by cam0, and by cam1 if the tag is common
+  for (size_t i = 0; i < cam0_aprilgrid.ids.size(); i++) {
+    const int tag_id = cam0_aprilgrid.ids[i];
+    const int j = tag_index(cam1_aprilgrid, tag_id);
+    if ((size_t) (tag_id * 4 + 3) >= object_points->size()) {
+      LOG_ERROR("Incorrect tag id [%d]!", tag_id);
       return -1;
     }
 
     // Form residual block
-    for (size_t i = 0; i < 4; i++) {
-      const auto kp0 = cam0_keypoints[i];
-      const auto kp1 = cam1_keypoints[i];
-      const auto obj_pt = object_points[i];
-      const auto residual = new calib_stereo_residual_t{cam0_params, cam1_params,
-                                                        kp0, kp1, obj_pt};
-
+    for (size_t k = 0; k < 4; k++) {
+      const auto kp0 = cam0_aprilgrid.keypoints[i * 4 + k];
+      const size_t point_idx = tag_id * 4 + k;
+
+      // Corner observed by cam0 only
+      if (j == -1) {
+        const auto residual = new calib_stereo_cam0_residual_t{cam0_model,
+                                                               kp0,
+                                                               object_points,
+                                                               point_idx};
+        const auto cost_func =
+            new ceres::AutoDiffCostFunction<calib_stereo_cam0_residual_t,
+                                            2, // Size of: residual
+                                            4, // Size of: cam0_intrinsics
+                                            4, // Size of: cam0_distortion
+                                            4, // Size of: q_C0F
+                                            3  // Size of: r_C0F
+                                            >(residual);
+        problem->AddResidualBlock(cost_func, // Cost function
+                                  NULL,      // Loss function
+                                  cam0_params.proj_params.data(),
+                                  cam0_params.dist_params.data(),
+                                  T_C0F->q,
+                                  T_C0F->r);
+        continue;
+      }
+
+      // Corner observed by both cameras
+      const auto kp1 = cam1_aprilgrid.keypoints[j * 4 + k];
+      const auto residual = new calib_stereo_residual_t{cam0_model, cam1_model,
+                                                        kp0, kp1,
+                                                        object_points,
+                                                        point_idx};
       const auto cost_func =
           new ceres::AutoDiffCostFunction<calib_stereo_residual_t,
                                           4, // Size of: residual
@@ -44,20 +95,59 @@ static int process_aprilgrid(const aprilgrid_t &cam0_aprilgrid,
                                           4, // Size of: cam0_distortion
                                           4, // Size of: cam1_intrinsics
                                           4, // Size of: cam1_distortion
-                                          4, // Size of: q_C0C1
-                                          3, // Size of: t_C0C1
+                                          4, // Size of: q_C1C0
+                                          3, // Size of: t_C1C0
                                           4, // Size of: q_C0F
                                           3  // Size of: t_C0F
                                           >(residual);
-
       problem->AddResidualBlock(cost_func, // Cost function
                                 NULL,      // Loss function
                                 cam0_params.proj_params.data(),
                                 cam0_params.dist_params.data(),
                                 cam1_params.proj_params.data(),
                                 cam1_params.dist_params.data(),
-                                T_C0C1->q,
-                                T_C0C1->r,
+                                T_C1C0->q,
+                                T_C1C0->r,
+                                T_C0F->q,
+                                T_C0F->r);
+    }
+  }
+
+  // Corners observed by cam1 only
+  for (size_t j = 0; j < cam1_aprilgrid.ids.size(); j++) {
+    const int tag_id = cam1_aprilgrid.ids[j];
+    if (tag_index(cam0_aprilgrid, tag_id) != -1) {
+      continue;
+    }
+    if ((size_t) (tag_id * 4 + 3) >= object_points->size()) {
+      LOG_ERROR("Incorrect tag id [%d]!", tag_id);
+      return -1;
+    }
+
+    // Form residual block
+    for (size_t k = 0; k < 4; k++) {
+      const auto kp1 = cam1_aprilgrid.keypoints[j * 4 + k];
+      const size_t point_idx = tag_id * 4 + k;
+      const auto residual = new calib_stereo_cam1_residual_t{cam1_model,
+                                                             kp1,
+                                                             object_points,
+                                                             point_idx};
+      const auto cost_func =
+          new ceres::AutoDiffCostFunction<calib_stereo_cam1_residual_t,
+                                          2, // Size of: residual
+                                          4, // Size of: cam1_intrinsics
+                                          4, // Size of: cam1_distortion
+                                          4, // Size of: q_C1C0
+                                          3, // Size of: t_C1C0
+                                          4, // Size of: q_C0F
+                                          3  // Size of: t_C0F
+                                          >(residual);
+      problem->AddResidualBlock(cost_func, // Cost function
+                                NULL,      // Loss function
+                                cam1_params.proj_params.data(),
+                                cam1_params.dist_params.data(),
+                                T_C1C0->q,
+                                T_C1C0->r,
                                 T_C0F->q,
                                 T_C0F->r);
     }
@@ -66,10 +156,45 @@ static int process_aprilgrid(const aprilgrid_t &cam0_aprilgrid,
   return 0;
 }
 
+int calib_stereo_add_frame(const aprilgrid_t &cam0_aprilgrid,
+                           const aprilgrid_t &cam1_aprilgrid,
+                           const vec3s_t *object_points,
+                           calib_params_t &cam0_params,
+                           calib_params_t &cam1_params,
+                           calib_pose_t *T_C1C0,
+                           calib_pose_t *T_C0F,
+                           ceres::Problem *problem) {
+  camera_model_t cam0_model;
+  camera_model_t cam1_model;
+  if (calib_camera_model(cam0_params, cam0_model) != 0 ||
+      calib_camera_model(cam1_params, cam1_model) != 0) {
+    LOG_ERROR("Unsupported camera model!");
+    return -1;
+  }
+
+  return process_aprilgrid(cam0_aprilgrid,
+                           cam1_aprilgrid,
+                           cam0_model,
+                           cam1_model,
+                           object_points,
+                           cam0_params,
+                           cam1_params,
+                           T_C1C0,
+                           T_C0F,
+                           problem);
+}
+
 static int save_results(const std::string &save_path,
                         const calib_params_t &cam0,
                         const calib_params_t &cam1,
                         const mat4_t &T_C0C1) {
+  camera_model_t cam0_model;
+  camera_model_t cam1_model;
+  if (calib_camera_model(cam0, cam0_model) != 0 ||
+      calib_camera_model(cam1, cam1_model) != 0) {
+    return -1;
+  }
+
   // Open results file
   FILE *outfile = fopen(save_path.c_str(), "w");
   if (outfile == NULL) {
@@ -81,7 +206,9 @@ static int save_results(const std::string &save_path,
     const char *proj_model = cam0.proj_model.c_str();
     const char *dist_model = cam0.dist_model.c_str();
     const std::string proj_params = arr2str(cam0.proj_params.data(), 4);
-    const std::string dist_params = arr2str(cam0.dist_params.data(), 4);
+    const int dist_size = camera_dist_params_size(cam0_model);
+    const std::string dist_params =
+        arr2str(cam0.dist_params.data(), dist_size);
     fprintf(outfile, "cam0:\n");
     fprintf(outfile, "  resolution: [%d, %d]\n", cam0.img_w, cam0.img_h);
     fprintf(outfile, "  proj_model: \"%s\"\n", proj_model);
@@ -94,7 +221,9 @@ static int save_results(const std::string &save_path,
     const char *proj_model = cam1.proj_model.c_str();
     const char *dist_model = cam1.dist_model.c_str();
     const std::string proj_params = arr2str(cam1.proj_params.data(), 4);
-    const std::string dist_params = arr2str(cam1.dist_params.data(), 4);
+    const int dist_size = camera_dist_params_size(cam1_model);
+    const std::string dist_params =
+        arr2str(cam1.dist_params.data(), dist_size);
     fprintf(outfile, "cam1:\n");
     fprintf(outfile, "  resolution: [%d, %d]\n", cam1.img_w, cam1.img_h);
     fprintf(outfile, "  proj_model: \"%s\"\n", proj_model);
@@ -123,14 +252,34 @@ int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
                        calib_params_t &cam0_params,
                        calib_params_t &cam1_params,
                        mat4_t &T_C0C1,
-                       mat4s_t &T_C0F) {
+                       mat4s_t &T_C0F,
+                       const calib_solver_options_t &opts) {
   assert(cam0_aprilgrids.size() == cam1_aprilgrids.size());
+  struct timespec t_start = tic();
+
+  // Calibration data
+  camera_model_t cam0_model;
+  camera_model_t cam1_model;
+  vec3s_t object_points;
+  if (setup_calib_data(cam0_aprilgrids,
+                       cam0_params,
+                       cam1_params,
+                       cam0_model,
+                       cam1_model,
+                       object_points) != 0) {
+    LOG_ERROR("Failed to setup calibration data!");
+    return -1;
+  }
 
   // Optimization variables
-  calib_pose_t extrinsic_param{T_C0C1};
+  calib_pose_t extrinsic_param{T_C0C1.inverse()};
   std::vector<calib_pose_t> pose_params;
   for (size_t i = 0; i < cam0_aprilgrids.size(); i++) {
-    pose_params.emplace_back(cam0_aprilgrids[i].T_CF);
+    if (cam0_aprilgrids[i].ids.size() > 0) {
+      pose_params.emplace_back(cam0_aprilgrids[i].T_CF);
+    } else {
+      pose_params.emplace_back(T_C0C1 * cam1_aprilgrids[i].T_CF);
+    }
   }
 
   // Setup optimization problem
@@ -145,6 +294,9 @@ int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
   for (size_t i = 0; i < cam0_aprilgrids.size(); i++) {
     int retval = process_aprilgrid(cam0_aprilgrids[i],
                                    cam1_aprilgrids[i],
+                                   cam0_model,
+                                   cam1_model,
+                                   &object_points,
                                    cam0_params,
                                    cam1_params,
                                    &extrinsic_param,
@@ -160,19 +312,36 @@ int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
   }
   problem->SetParameterization(extrinsic_param.q,
                                &quaternion_parameterization);
-
-  // Set solver options
+  calib_dist_params_setup(problem.get(),
+                          cam0_model,
+                          cam0_params.dist_params.data());
+  calib_dist_params_setup(problem.get(),
+                          cam1_model,
+                          cam1_params.dist_params.data());
+
+  // Set solver options, every reprojected corner has a 2D residual
+  const size_t nb_corners = problem->NumResiduals() / 2;
   ceres::Solver::Options options;
-  options.minimizer_progress_to_stdout = true;
-  options.max_num_iterations = 100;
+  calib_solver_callbacks_t callbacks;
+  calib_solver_setup(opts,
+                     nb_corners,
+                     t_start,
+                     options,
+                     callbacks,
+                     problem.get(),
+                     "stereo");
 
   // Solve
   ceres::Solver::Summary summary;
   ceres::Solve(options, problem.get(), &summary);
-  std::cout << summary.FullReport() << std::endl;
+  if (opts.verbose) {
+    std::cout << summary.FullReport() << std::endl;
+  }
+  calib_solver_report(opts, "stereo", nb_corners, summary);
 
   // Finish up
-  T_C0C1 = extrinsic_param.T();
+  T_C0C1 = extrinsic_param.T().inverse();
+  T_C0F.clear();
   for (auto pose_param : pose_params) {
     T_C0F.emplace_back(pose_param.T());
   }
@@ -181,10 +350,260 @@ int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
 }
 
 
+static std::map<timestamp_t, mat4_t> index_poses(const aprilgrids_t &grids,
+                                                 const mat4s_t &T_CF) {
+  std::map<timestamp_t, mat4_t> poses;
+  for (size_t i = 0; i < grids.size(); i++) {
+    poses[grids[i].timestamp] = T_CF[i];
+  }
+  return poses;
+}
+
+static int init_extrinsics(const std::map<timestamp_t, mat4_t> &cam0_poses,
+                           const std::map<timestamp_t, mat4_t> &cam1_poses,
+                           mat4_t &T_C0C1) {
+  // Average T_C0C1 = T_C0F * inv(T_C1F) over frames observed by both cameras
+  vec4_t q_sum = zeros(4, 1);
+  vec3_t r_sum = zeros(3, 1);
+  quat_t q_ref;
+  size_t nb_poses = 0;
+  for (const auto &kv : cam0_poses) {
+    const auto it = cam1_poses.find(kv.first);
+    if (it == cam1_poses.end()) {
+      continue;
+    }
+
+    const mat4_t T_C0C1_k = kv.second * it->second.inverse();
+    quat_t q = tf_quat(T_C0C1_k);
+    if (nb_poses == 0) {
+      q_ref = q;
+    } else if (q_ref.dot(q) < 0.0) {
+      q.coeffs() *= -1.0;
+    }
+    q_sum += q.coeffs();
+    r_sum += tf_trans(T_C0C1_k);
+    nb_poses++;
+  }
+
+  if (nb_poses == 0) {
+    LOG_ERROR("No frames observed by both cameras!");
+    return -1;
+  }
+
+  const quat_t q_C0C1{q_sum.normalized()};
+  const vec3_t r_C0C1 = r_sum / (real_t) nb_poses;
+  T_C0C1 = tf(q_C0C1, r_C0C1);
+
+  return 0;
+}
+
+int calib_stereo_solve(const aprilgrids_t &cam0_mono_aprilgrids,
+                       const aprilgrids_t &cam1_mono_aprilgrids,
+                       const aprilgrids_t &cam0_aprilgrids,
+                       const aprilgrids_t &cam1_aprilgrids,
+                       calib_params_t &cam0_params,
+                       calib_params_t &cam1_params,
+                       mat4_t &T_C0C1,
+                       mat4s_t &T_C0F,
+                       const int polish_max_iter,
+                       const calib_solver_options_t &opts) {
+  assert(cam0_aprilgrids.size() == cam1_aprilgrids.size());
+
+  // The deadline is the budget of all stages together, every stage gets the
+  // time that remains
+  struct timespec t_start = tic();
+  const auto budget_left = [&]() {
+    return opts.deadline <= 0.0 || toc(&t_start) < opts.deadline;
+  };
+
+  // Stage 1: Calibrate each camera on all of its own observations, the mono
+  // calibrations start now so they share the full deadline
+  struct timespec t_stage = tic();
+  calib_solver_options_t mono_opts = opts;
+  mono_opts.verbose = false;
+  mat4s_t cam0_T_CF;
+  mat4s_t cam1_T_CF;
+  int retvals[2] = {0, 0};
+#pragma omp parallel sections
+  {
+#pragma omp section
+    retvals[0] = calib_mono_solve(cam0_mono_aprilgrids,
+                                  cam0_params,
+                                  cam0_T_CF,
+                                  mono_opts);
+#pragma omp section
+    retvals[1] = calib_mono_solve(cam1_mono_aprilgrids,
+                                  cam1_params,
+                                  cam1_T_CF,
+                                  mono_opts);
+  }
+  if (retvals[0] != 0 || retvals[1] != 0) {
+    LOG_ERROR("Failed to calibrate cameras individually!");
+    return -1;
+  }
+  if (opts.verbose) {
+    LOG_INFO("Stage 1: mono calibrations took %f [s]", toc(&t_stage));
+  }
+
+  // Initialize extrinsics and cam0 poses from the mono calibrations
+  const auto cam0_poses = index_poses(cam0_mono_aprilgrids, cam0_T_CF);
+  const auto cam1_poses = index_poses(cam1_mono_aprilgrids, cam1_T_CF);
+  if (init_extrinsics(cam0_poses, cam1_poses, T_C0C1) != 0) {
+    LOG_ERROR("Failed to initialize stereo extrinsics!");
+    return -1;
+  }
+
+  // Calibration data
+  camera_model_t cam0_model;
+  camera_model_t cam1_model;
+  vec3s_t object_points;
+  if (setup_calib_data(cam0_aprilgrids,
+                       cam0_params,
+                       cam1_params,
+                       cam0_model,
+                       cam1_model,
+                       object_points) != 0) {
+    LOG_ERROR("Failed to setup calibration data!");
+    return -1;
+  }
+
+  // Optimization variables
+  calib_pose_t extrinsic_param{T_C0C1.inverse()};
+  std::vector<calib_pose_t> pose_params;
+  for (size_t i = 0; i < cam0_aprilgrids.size(); i++) {
+    const auto ts = cam0_aprilgrids[i].timestamp;
+    if (cam0_poses.count(ts)) {
+      pose_params.emplace_back(cam0_poses.at(ts));
+    } else if (cam1_poses.count(ts)) {
+      pose_params.emplace_back(T_C0C1 * cam1_poses.at(ts));
+    } else {
+      pose_params.emplace_back(cam0_aprilgrids[i].T_CF);
+    }
+  }
+
+  // Setup optimization problem
+  // clang-format off
+  ceres::Problem::Options problem_options;
+  problem_options.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  std::unique_ptr<ceres::Problem> problem(new ceres::Problem(problem_options));
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+  // clang-format on
+
+  // Process all aprilgrid data
+  for (size_t i = 0; i < cam0_aprilgrids.size(); i++) {
+    int retval = process_aprilgrid(cam0_aprilgrids[i],
+                                   cam1_aprilgrids[i],
+                                   cam0_model,
+                                   cam1_model,
+                                   &object_points,
+                                   cam0_params,
+                                   cam1_params,
+                                   &extrinsic_param,
+                                   &pose_params[i],
+                                   problem.get());
+    if (retval != 0) {
+      LOG_ERROR("Failed to add AprilGrid measurements to problem!");
+      return -1;
+    }
+
+    problem->SetParameterization(pose_params[i].q,
+                                 &quaternion_parameterization);
+  }
+  problem->SetParameterization(extrinsic_param.q,
+                               &quaternion_parameterization);
+  calib_dist_params_setup(problem.get(),
+                          cam0_model,
+                          cam0_params.dist_params.data());
+  calib_dist_params_setup(problem.get(),
+                          cam1_model,
+                          cam1_params.dist_params.data());
+
+  // Stage 2: Refine extrinsics and poses with the intrinsics fixed
+  double *intrinsics[4] = {cam0_params.proj_params.data(),
+                           cam0_params.dist_params.data(),
+                           cam1_params.proj_params.data(),
+                           cam1_params.dist_params.data()};
+  for (auto param : intrinsics) {
+    problem->SetParameterBlockConstant(param);
+  }
+  const size_t nb_corners = problem->NumResiduals() / 2;
+  if (budget_left()) {
+    t_stage = tic();
+    ceres::Solver::Options options;
+    calib_solver_callbacks_t callbacks;
+    calib_solver_setup(opts,
+                       nb_corners,
+                       t_start,
+                       options,
+                       callbacks,
+                       problem.get(),
+                       "stereo_extrinsics");
+
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, problem.get(), &summary);
+    if (opts.verbose) {
+      std::cout << summary.BriefReport() << std::endl;
+      LOG_INFO("Stage 2: extrinsics refinement took %f [s]", toc(&t_stage));
+    }
+    calib_solver_report(opts, "stereo_extrinsics", nb_corners, summary);
+  } else if (opts.verbose) {
+    LOG_WARN("Deadline reached, skipping extrinsics refinement!");
+  }
+
+  // Stage 3: Short joint polish of all parameters
+  const bool polish = (polish_max_iter > 0 && budget_left());
+  if (polish_max_iter > 0 && polish == false && opts.verbose) {
+    LOG_WARN("Deadline reached, skipping joint polish!");
+  }
+  if (polish) {
+    for (auto param : intrinsics) {
+      problem->SetParameterBlockVariable(param);
+    }
+
+    t_stage = tic();
+    calib_solver_options_t polish_opts = opts;
+    polish_opts.max_iter = polish_max_iter;
+    ceres::Solver::Options options;
+    calib_solver_callbacks_t callbacks;
+    calib_solver_setup(polish_opts,
+                       nb_corners,
+                       t_start,
+                       options,
+                       callbacks,
+                       problem.get(),
+                       "stereo_polish");
+
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, problem.get(), &summary);
+    if (opts.verbose) {
+      std::cout << summary.FullReport() << std::endl;
+      LOG_INFO("Stage 3: joint polish took %f [s]", toc(&t_stage));
+    }
+    calib_solver_report(opts, "stereo_polish", nb_corners, summary);
+  }
+
+  // Finish up
+  T_C0C1 = extrinsic_param.T().inverse();
+  T_C0F.clear();
+  for (auto pose_param : pose_params) {
+    T_C0F.emplace_back(pose_param.T());
+  }
+
+  return 0;
+}
+
 int calib_stereo_solve(const std::string &config_file) {
   // Calibration settings
   std::string data_path;
   std::string results_fpath;
+  std::string stereo_mode = "joint";
+  int polish_max_iter = 10;
+  bool common_tags_only = true;
+  bool undistort_map = false;
+  bool rectify_map = false;
+  bool undistort_poly = false;
+  bool bearing_lut = false;
+  int bearing_lut_step = 1;
 
   vec2_t cam0_resolution{0.0, 0.0};
   real_t cam0_lens_hfov = 0.0;
@@ -202,6 +621,14 @@ int calib_stereo_solve(const std::string &config_file) {
   config_t config{config_file};
   parse(config, "settings.data_path", data_path);
   parse(config, "settings.results_fpath", results_fpath);
+  parse(config, "settings.stereo_mode", stereo_mode, true);
+  parse(config, "settings.polish_max_iter", polish_max_iter, true);
+  parse(config, "settings.common_tags_only", common_tags_only, true);
+  parse(config, "settings.undistort_map", undistort_map, true);
+  parse(config, "settings.rectify_map", rectify_map, true);
+  parse(config, "settings.undistort_poly", undistort_poly, true);
+  parse(config, "settings.bearing_lut", bearing_lut, true);
+  parse(config, "settings.bearing_lut_step", bearing_lut_step, true);
   parse(config, "cam0.resolution", cam0_resolution);
   parse(config, "cam0.lens_hfov", cam0_lens_hfov);
   parse(config, "cam0.lens_vfov", cam0_lens_vfov);
@@ -213,6 +640,13 @@ int calib_stereo_solve(const std::string &config_file) {
   parse(config, "cam1.proj_model", cam1_proj_model);
   parse(config, "cam1.dist_model", cam1_dist_model);
 
+  // Load solver options
+  calib_solver_options_t solver_opts;
+  if (calib_solver_options_load(solver_opts, config_file) != 0) {
+    LOG_ERROR("Failed to load solver options [%s]!", config_file.c_str());
+    return -1;
+  }
+
   // Load calibration target
   calib_target_t calib_target;
   if (calib_target_load(calib_target, config_file, "calib_target") != 0) {
@@ -253,7 +687,8 @@ int calib_stereo_solve(const std::string &config_file) {
   retval = load_stereo_calib_data(cam0_grid_path,
                                   cam1_grid_path,
                                   cam0_aprilgrids,
-                                  cam1_aprilgrids);
+                                  cam1_aprilgrids,
+                                  common_tags_only);
   if (retval != 0) {
     LOG_ERROR("Failed to load calibration data!");
     return -1;
@@ -271,12 +706,46 @@ int calib_stereo_solve(const std::string &config_file) {
   LOG_INFO("Calibrating stereo camera!");
   mat4_t T_C0C1 = I(4);
   mat4s_t T_C0F;
-  retval = calib_stereo_solve(cam0_aprilgrids,
-                              cam1_aprilgrids,
-                              cam0_params,
-                              cam1_params,
-                              T_C0C1,
-                              T_C0F);
+  if (stereo_mode == "joint") {
+    retval = calib_stereo_solve(cam0_aprilgrids,
+                                cam1_aprilgrids,
+                                cam0_params,
+                                cam1_params,
+                                T_C0C1,
+                                T_C0F,
+                                solver_opts);
+
+  } else if (stereo_mode == "two_stage") {
+    // Load all observations of each camera for the mono calibrations
+    aprilgrids_t cam0_mono_aprilgrids;
+    aprilgrids_t cam1_mono_aprilgrids;
+    timestamps_t cam0_timestamps;
+    timestamps_t cam1_timestamps;
+    if (load_camera_calib_data(cam0_grid_path,
+                               cam0_mono_aprilgrids,
+                               cam0_timestamps) != 0 ||
+        load_camera_calib_data(cam1_grid_path,
+                               cam1_mono_aprilgrids,
+                               cam1_timestamps) != 0) {
+      LOG_ERROR("Failed to load calibration data!");
+      return -1;
+    }
+
+    retval = calib_stereo_solve(cam0_mono_aprilgrids,
+                                cam1_mono_aprilgrids,
+                                cam0_aprilgrids,
+                                cam1_aprilgrids,
+                                cam0_params,
+                                cam1_params,
+                                T_C0C1,
+                                T_C0F,
+                                polish_max_iter,
+                                solver_opts);
+
+  } else {
+    LOG_ERROR("Invalid stereo_mode [%s]!", stereo_mode.c_str());
+    return -1;
+  }
   if (retval != 0) {
     LOG_ERROR("Failed to calibrate stereo cameras!");
     return -1;
@@ -299,6 +768,63 @@ int calib_stereo_solve(const std::string &config_file) {
     return -1;
   }
 
+  // Save undistortion maps next to results
+  if (undistort_map) {
+    const calib_params_t *cams[2] = {&cam0_params, &cam1_params};
+    for (int i = 0; i < 2; i++) {
+      const std::string map_fpath = undistort_map_fpath(results_fpath, i);
+      undistort_map_t map;
+      if (undistort_map_init(map, *cams[i]) != 0 ||
+          undistort_map_save(map, map_fpath) != 0) {
+        LOG_ERROR("Failed to save undistortion map to [%s]!",
+                  map_fpath.c_str());
+        return -1;
+      }
+    }
+  }
+
+  // Save stereo rectification map next to results
+  if (rectify_map) {
+    const std::string map_fpath = rectify_map_fpath(results_fpath);
+    rectify_map_t map;
+    if (rectify_map_init(map, cam0_params, cam1_params, T_C0C1) != 0 ||
+        rectify_map_save(map, map_fpath) != 0) {
+      LOG_ERROR("Failed to save rectification map to [%s]!",
+                map_fpath.c_str());
+      return -1;
+    }
+  }
+
+  // Save inverse distortion polynomials next to results
+  if (undistort_poly) {
+    const calib_params_t *cams[2] = {&cam0_params, &cam1_params};
+    for (int i = 0; i < 2; i++) {
+      const std::string poly_fpath = undistort_poly_fpath(results_fpath, i);
+      undistort_poly_t poly;
+      if (undistort_poly_fit(poly, *cams[i]) != 0 ||
+          undistort_poly_save(poly, poly_fpath) != 0) {
+        LOG_ERROR("Failed to save inverse distortion polynomial to [%s]!",
+                  poly_fpath.c_str());
+        return -1;
+      }
+    }
+  }
+
+  // Save bearing lookup tables next to results
+  if (bearing_lut) {
+    const calib_params_t *cams[2] = {&cam0_params, &cam1_params};
+    for (int i = 0; i < 2; i++) {
+      const std::string lut_fpath = bearing_lut_fpath(results_fpath, i);
+      bearing_lut_t lut;
+      if (bearing_lut_init(lut, *cams[i], bearing_lut_step) != 0 ||
+          bearing_lut_save(lut, lut_fpath) != 0) {
+        LOG_ERROR("Failed to save bearing lookup table to [%s]!",
+                  lut_fpath.c_str());
+        return -1;
+      }
+    }
+  }
+
   return 0;
 }
 
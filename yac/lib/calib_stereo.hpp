@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <map>
 
 #include <ceres/ceres.h>
 
@@ -14,24 +15,28 @@
 namespace yac {
 
 /**
- * Stereo camera calibration residual
+ * Stereo camera calibration residual. The residual only holds the
+ * measurements, the camera model tags and an index into a shared object
+ * point table, which must outlive the residual. The extrinsics are
+ * parameterized as `T_C1C0` so that no inverse is needed per evaluation.
  */
 struct calib_stereo_residual_t {
-  calib_params_t cam0_params_;
-  calib_params_t cam1_params_;
+  camera_model_t cam0_model_ = PINHOLE_RADTAN4;
+  camera_model_t cam1_model_ = PINHOLE_RADTAN4;
+  real_t z_C0_[2] = {0.0, 0.0};             ///< Measurement from cam0
+  real_t z_C1_[2] = {0.0, 0.0};             ///< Measurement from cam1
+  const vec3s_t *object_points_ = nullptr;  ///< Object point table
+  size_t point_idx_ = 0;                    ///< Object point index
 
-  real_t z_C0_[2] = {0.0, 0.0};     ///< Measurement from cam0
-  real_t z_C1_[2] = {0.0, 0.0};     ///< Measurement from cam1
-  real_t p_F_[3] = {0.0, 0.0, 0.0}; ///< Object point
-
-  calib_stereo_residual_t(const calib_params_t &cam0_params,
-                          const calib_params_t &cam1_params,
+  calib_stereo_residual_t(const camera_model_t cam0_model,
+                          const camera_model_t cam1_model,
                           const vec2_t &z_C0,
                           const vec2_t &z_C1,
-                          const vec3_t &p_F)
-      : cam0_params_{cam0_params}, cam1_params_{cam1_params},
+                          const vec3s_t *object_points,
+                          const size_t point_idx)
+      : cam0_model_{cam0_model}, cam1_model_{cam1_model},
         z_C0_{z_C0(0), z_C0(1)}, z_C1_{z_C1(0), z_C1(1)},
-        p_F_{p_F(0), p_F(1), p_F(2)} {}
+        object_points_{object_points}, point_idx_{point_idx} {}
 
   ~calib_stereo_residual_t() {}
 
@@ -43,69 +48,42 @@ struct calib_stereo_residual_t {
                   const T *const cam0_distortion,
                   const T *const cam1_intrinsics,
                   const T *const cam1_distortion,
-                  const T *const q_C0C1_,
-                  const T *const r_C0C1_,
+                  const T *const q_C1C0_,
+                  const T *const r_C1C0_,
                   const T *const q_C0F_,
                   const T *const r_C0F_,
                   T *residual) const {
     // Map variables to Eigen
-    // -- Fiducial point
-    const Eigen::Matrix<T, 3, 1> p_F{T(p_F_[0]), T(p_F_[1]), T(p_F_[2])};
-    // -- cam0 intrinsics and distortion
-    Eigen::Matrix<T, 8, 1> cam0;
-    cam0 << cam0_intrinsics[0], cam0_intrinsics[1], cam0_intrinsics[2], cam0_intrinsics[3],
-            cam0_distortion[0], cam0_distortion[1], cam0_distortion[2], cam0_distortion[3];
-    // -- cam1 intrinsics and distortion
-    Eigen::Matrix<T, 8, 1> cam1;
-    cam1 << cam1_intrinsics[0], cam1_intrinsics[1], cam1_intrinsics[2], cam1_intrinsics[3],
-            cam1_distortion[0], cam1_distortion[1], cam1_distortion[2], cam1_distortion[3];
-
-    // Form transforms
     // clang-format off
-    // -- Create transform between fiducial and cam0
+    const vec3_t &obj_pt = (*object_points_)[point_idx_];
+    const Eigen::Matrix<T, 3, 1> p_F{T(obj_pt(0)), T(obj_pt(1)), T(obj_pt(2))};
     const Eigen::Quaternion<T> q_C0F(q_C0F_[3], q_C0F_[0], q_C0F_[1], q_C0F_[2]);
-    const Eigen::Matrix<T, 3, 3> C_C0F = q_C0F.toRotationMatrix();
     const Eigen::Matrix<T, 3, 1> r_C0F{r_C0F_[0], r_C0F_[1], r_C0F_[2]};
-    const Eigen::Matrix<T, 4, 4> T_C0F = tf(C_C0F, r_C0F);
-    // -- Create transform between cam0 and cam1
-    const Eigen::Quaternion<T> q_C0C1(q_C0C1_[3], q_C0C1_[0], q_C0C1_[1], q_C0C1_[2]);
-    const Eigen::Matrix<T, 3, 3> C_C0C1 = q_C0C1.toRotationMatrix();
-    const Eigen::Matrix<T, 3, 1> r_C0C1{r_C0C1_[0], r_C0C1_[1], r_C0C1_[2]};
-    const Eigen::Matrix<T, 4, 4> T_C0C1 = tf(C_C0C1, r_C0C1);
-    const Eigen::Matrix<T, 4, 4> T_C1C0 = T_C0C1.inverse();
+    const Eigen::Quaternion<T> q_C1C0(q_C1C0_[3], q_C1C0_[0], q_C1C0_[1], q_C1C0_[2]);
+    const Eigen::Matrix<T, 3, 1> r_C1C0{r_C1C0_[0], r_C1C0_[1], r_C1C0_[2]};
     // clang-format on
 
+    // Transform fiducial point to cam0 and cam1
+    const Eigen::Matrix<T, 3, 1> p_C0 = q_C0F * p_F + r_C0F;
+    const Eigen::Matrix<T, 3, 1> p_C1 = q_C1C0 * p_C0 + r_C1C0;
+
     // Project
-    // clang-format off
-    // -- Project point observed from cam0 to cam0 image plane
-    const Eigen::Matrix<T, 3, 1> p_C0 = (T_C0F * p_F.homogeneous()).head(3);
     Eigen::Matrix<T, 2, 1> z_C0_hat;
-    const auto cam0_proj = cam0_params_.proj_model;
-    const auto cam0_dist = cam0_params_.dist_model;
-    if (cam0_proj == "pinhole" && cam0_dist == "radtan4") {
-      if (pinhole_radtan4_project(cam0, p_C0, z_C0_hat) != 0) { return false; }
-    } else if (cam0_proj == "pinhole" && cam0_dist == "equi4") {
-      if (pinhole_equi4_project(cam0, p_C0, z_C0_hat) != 0) { return false; }
-    } else {
-      FATAL("Unsupported [%s-%s] projection distortion combination!",
-            cam0_proj.c_str(),
-            cam0_dist.c_str());
-    }
-    // -- Project point observed from cam0 to cam1 image plane
-    const Eigen::Matrix<T, 3, 1> p_C1 = (T_C1C0 * p_C0.homogeneous()).head(3);
     Eigen::Matrix<T, 2, 1> z_C1_hat;
-    const auto cam1_proj = cam1_params_.proj_model;
-    const auto cam1_dist = cam1_params_.dist_model;
-    if (cam1_proj == "pinhole" && cam1_dist == "radtan4") {
-      if (pinhole_radtan4_project(cam1, p_C1, z_C1_hat) != 0) { return false; }
-    } else if (cam1_proj == "pinhole" && cam1_dist == "equi4") {
-      if (pinhole_equi4_project(cam1, p_C1, z_C1_hat) != 0) { return false; }
-    } else {
-      FATAL("Unsupported [%s-%s] projection distortion combination!",
-            cam1_proj.c_str(),
-            cam1_dist.c_str());
+    if (camera_project(cam0_model_,
+                       cam0_intrinsics,
+                       cam0_distortion,
+                       p_C0,
+                       z_C0_hat) != 0) {
+      return false;
+    }
+    if (camera_project(cam1_model_,
+                       cam1_intrinsics,
+                       cam1_distortion,
+                       p_C1,
+                       z_C1_hat) != 0) {
+      return false;
     }
-    // clang-format on
 
     // Residual
     // -- cam0 residual
@@ -120,15 +98,184 @@ struct calib_stereo_residual_t {
 };
 
 /**
- * Calibrate stereo camera extrinsics and relative pose between cameras. This
- * function assumes that the path to `config_file` is a yaml file of the form:
+ * Stereo camera calibration residual of a corner observed by cam0 only. Same
+ * layout as `calib_stereo_residual_t`, the corner only depends on the cam0
+ * parameters and the target pose `T_C0F`.
+ */
+struct calib_stereo_cam0_residual_t {
+  camera_model_t cam0_model_ = PINHOLE_RADTAN4;
+  real_t z_C0_[2] = {0.0, 0.0};             ///< Measurement from cam0
+  const vec3s_t *object_points_ = nullptr;  ///< Object point table
+  size_t point_idx_ = 0;                    ///< Object point index
+
+  calib_stereo_cam0_residual_t(const camera_model_t cam0_model,
+                               const vec2_t &z_C0,
+                               const vec3s_t *object_points,
+                               const size_t point_idx)
+      : cam0_model_{cam0_model}, z_C0_{z_C0(0), z_C0(1)},
+        object_points_{object_points}, point_idx_{point_idx} {}
+
+  ~calib_stereo_cam0_residual_t() {}
+
+  /**
+   * Calculate residual
+   */
+  template <typename T>
+  bool operator()(const T *const cam0_intrinsics,
+                  const T *const cam0_distortion,
+                  const T *const q_C0F_,
+                  const T *const r_C0F_,
+                  T *residual) const {
+    // Map variables to Eigen
+    // clang-format off
+    const vec3_t &obj_pt = (*object_points_)[point_idx_];
+    const Eigen::Matrix<T, 3, 1> p_F{T(obj_pt(0)), T(obj_pt(1)), T(obj_pt(2))};
+    const Eigen::Quaternion<T> q_C0F(q_C0F_[3], q_C0F_[0], q_C0F_[1], q_C0F_[2]);
+    const Eigen::Matrix<T, 3, 1> r_C0F{r_C0F_[0], r_C0F_[1], r_C0F_[2]};
+    // clang-format on
+
+    // Transform fiducial point to cam0 and project
+    const Eigen::Matrix<T, 3, 1> p_C0 = q_C0F * p_F + r_C0F;
+    Eigen::Matrix<T, 2, 1> z_C0_hat;
+    if (camera_project(cam0_model_,
+                       cam0_intrinsics,
+                       cam0_distortion,
+                       p_C0,
+                       z_C0_hat) != 0) {
+      return false;
+    }
+
+    // Residual
+    residual[0] = T(z_C0_[0]) - z_C0_hat(0);
+    residual[1] = T(z_C0_[1]) - z_C0_hat(1);
+
+    return true;
+  }
+};
+
+/**
+ * Stereo camera calibration residual of a corner observed by cam1 only. The
+ * parameterization is the same as `calib_stereo_residual_t`, so that the
+ * corner is tied to the shared cam0 target pose `T_C0F` at that timestamp.
+ */
+struct calib_stereo_cam1_residual_t {
+  camera_model_t cam1_model_ = PINHOLE_RADTAN4;
+  real_t z_C1_[2] = {0.0, 0.0};             ///< Measurement from cam1
+  const vec3s_t *object_points_ = nullptr;  ///< Object point table
+  size_t point_idx_ = 0;                    ///< Object point index
+
+  calib_stereo_cam1_residual_t(const camera_model_t cam1_model,
+                               const vec2_t &z_C1,
+                               const vec3s_t *object_points,
+                               const size_t point_idx)
+      : cam1_model_{cam1_model}, z_C1_{z_C1(0), z_C1(1)},
+        object_points_{object_points}, point_idx_{point_idx} {}
+
+  ~calib_stereo_cam1_residual_t() {}
+
+  /**
+   * Calculate residual
+   */
+  template <typename T>
+  bool operator()(const T *const cam1_intrinsics,
+                  const T *const cam1_distortion,
+                  const T *const q_C1C0_,
+                  const T *const r_C1C0_,
+                  const T *const q_C0F_,
+                  const T *const r_C0F_,
+                  T *residual) const {
+    // Map variables to Eigen
+    // clang-format off
+    const vec3_t &obj_pt = (*object_points_)[point_idx_];
+    const Eigen::Matrix<T, 3, 1> p_F{T(obj_pt(0)), T(obj_pt(1)), T(obj_pt(2))};
+    const Eigen::Quaternion<T> q_C0F(q_C0F_[3], q_C0F_[0], q_C0F_[1], q_C0F_[2]);
+    const Eigen::Matrix<T, 3, 1> r_C0F{r_C0F_[0], r_C0F_[1], r_C0F_[2]};
+    const Eigen::Quaternion<T> q_C1C0(q_C1C0_[3], q_C1C0_[0], q_C1C0_[1], q_C1C0_[2]);
+    const Eigen::Matrix<T, 3, 1> r_C1C0{r_C1C0_[0], r_C1C0_[1], r_C1C0_[2]};
+    // clang-format on
+
+    // Transform fiducial point to cam1 and project
+    const Eigen::Matrix<T, 3, 1> p_C1 = q_C1C0 * (q_C0F * p_F + r_C0F) + r_C1C0;
+    Eigen::Matrix<T, 2, 1> z_C1_hat;
+    if (camera_project(cam1_model_,
+                       cam1_intrinsics,
+                       cam1_distortion,
+                       p_C1,
+                       z_C1_hat) != 0) {
+      return false;
+    }
+
+    // Residual
+    residual[0] = T(z_C1_[0]) - z_C1_hat(0);
+    residual[1] = T(z_C1_[1]) - z_C1_hat(1);
+
+    return true;
+  }
+};
+
+/**
+ * Add the residuals of a stereo frame observed by `cam0_aprilgrid` and
+ * `cam1_aprilgrid` to `problem`. Corners observed by both cameras form a
+ * `calib_stereo_residual_t`, corners observed by one camera only a
+ * `calib_stereo_cam0_residual_t` or `calib_stereo_cam1_residual_t`. The
+ * object point table `object_points`, see `aprilgrid_object_points()`, must
+ * outlive the problem.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_stereo_add_frame(const aprilgrid_t &cam0_aprilgrid,
+                           const aprilgrid_t &cam1_aprilgrid,
+                           const vec3s_t *object_points,
+                           calib_params_t &cam0_params,
+                           calib_params_t &cam1_params,
+                           calib_pose_t *T_C1C0,
+                           calib_pose_t *T_C0F,
+                           ceres::Problem *problem);
+
+/**
+ * Calibrate stereo camera intrinsics, extrinsics `T_C0C1` and relative pose
+ * `T_C0F` between cam0 and calibration target. The AprilGrids in
+ * `cam0_aprilgrids` and `cam1_aprilgrids` are paired by timestamp. Corners
+ * observed by both cameras form a stereo residual, while corners observed by
+ * only one camera form a single camera residual tied to the same target pose,
+ * see `load_stereo_calib_data()` to load all observations.
+ *
+ * @returns 0 or -1 for success or failure
  */
 int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
                        const std::vector<aprilgrid_t> &cam1_aprilgrids,
                        calib_params_t &cam0_params,
                        calib_params_t &cam1_params,
                        mat4_t &T_C0C1,
-                       mat4s_t &T_C0F);
+                       mat4s_t &T_C0F,
+                       const calib_solver_options_t &opts =
+                           calib_solver_options_t());
+
+/**
+ * Calibrate stereo camera in two stages. First both cameras are calibrated
+ * concurrently with `calib_mono_solve()`, each on all of its own
+ * observations (`cam0_mono_aprilgrids`, `cam1_mono_aprilgrids`). The
+ * extrinsics `T_C0C1` are then initialized from the mono poses and refined
+ * with the intrinsics fixed on the stereo observations paired by timestamp
+ * (`cam0_aprilgrids`, `cam1_aprilgrids`). Finally a joint polish of all
+ * parameters is performed for at most `polish_max_iter` iterations, set it to
+ * 0 to disable. The deadline in `opts` is the wall-clock budget of all
+ * stages together, each stage runs with the time that remains and the later
+ * stages are skipped once it is used up.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_stereo_solve(const aprilgrids_t &cam0_mono_aprilgrids,
+                       const aprilgrids_t &cam1_mono_aprilgrids,
+                       const aprilgrids_t &cam0_aprilgrids,
+                       const aprilgrids_t &cam1_aprilgrids,
+                       calib_params_t &cam0_params,
+                       calib_params_t &cam1_params,
+                       mat4_t &T_C0C1,
+                       mat4s_t &T_C0F,
+                       const int polish_max_iter = 10,
+                       const calib_solver_options_t &opts =
+                           calib_solver_options_t());
 
 /**
  * Calibrate stereo camera extrinsics and relative pose between cameras. This
@@ -137,6 +284,14 @@ int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
  *     settings:
  *       data_path: "/data"
  *       results_fpath: "/data/calib_results.yaml"
+ *       stereo_mode: "joint"    # Optional, "joint" or "two_stage"
+ *       polish_max_iter: 10     # Optional, two_stage joint polish iterations
+ *       common_tags_only: true  # Optional, false to use all observations
+ *       undistort_map: false    # Optional, save undistortion maps
+ *       rectify_map: false      # Optional, save stereo rectification map
+ *       undistort_poly: false   # Optional, save inverse distortion polys
+ *       bearing_lut: false      # Optional, save bearing lookup tables
+ *       bearing_lut_step: 1     # Optional, bearing lookup table pixel step
  *
  *     calib_target:
  *       target_type: 'aprilgrid'  # Target type
@@ -160,6 +315,10 @@ int calib_stereo_solve(const std::vector<aprilgrid_t> &cam0_aprilgrids,
  *       lens_vfov: 73.0
  *       proj_model: "pinhole"
  *       dist_model: "radtan4"
+ *
+ *     solver:                    # Optional, see calib_solver_options_load()
+ *       rmse_plateau_tol: 0.001  # [px]
+ *       deadline: 30.0           # [s]
  */
 int calib_stereo_solve(const std::string &config_file);
 
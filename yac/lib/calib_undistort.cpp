@@ -0,0 +1,864 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <iomanip>
+#include <limits>
+
+#include "calib_undistort.hpp"
+
+namespace yac {
+
+#define CVMATS_MAGIC "YACMATS"
+#define CVMATS_ALIGN 64
+
+struct cvmats_header_t {
+  char magic[8];
+  uint64_t nb_mats;
+};
+
+struct cvmats_entry_t {
+  int32_t rows;
+  int32_t cols;
+  int32_t type;
+  int32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+};
+
+static uint64_t cvmats_align(const uint64_t offset) {
+  return (offset + CVMATS_ALIGN - 1) / CVMATS_ALIGN * CVMATS_ALIGN;
+}
+
+int cvmats_save(const std::string &save_path,
+                const std::vector<cv::Mat> &mats) {
+  // Form header, matrix data starts after the header and entries
+  cvmats_header_t header;
+  memset(&header, 0, sizeof(cvmats_header_t));
+  strncpy(header.magic, CVMATS_MAGIC, sizeof(header.magic));
+  header.nb_mats = mats.size();
+
+  std::vector<cv::Mat> data;
+  std::vector<cvmats_entry_t> entries;
+  uint64_t offset = sizeof(cvmats_header_t);
+  offset += sizeof(cvmats_entry_t) * mats.size();
+  for (const auto &mat : mats) {
+    data.push_back((mat.isContinuous()) ? mat : mat.clone());
+
+    cvmats_entry_t entry;
+    memset(&entry, 0, sizeof(cvmats_entry_t));
+    entry.rows = mat.rows;
+    entry.cols = mat.cols;
+    entry.type = mat.type();
+    entry.offset = cvmats_align(offset);
+    entry.size = mat.total() * mat.elemSize();
+    entries.push_back(entry);
+    offset = entry.offset + entry.size;
+  }
+
+  // Open file
+  FILE *outfile = fopen(save_path.c_str(), "wb");
+  if (outfile == NULL) {
+    LOG_ERROR("Failed to open [%s] for writing!", save_path.c_str());
+    return -1;
+  }
+
+  // Write header, entries and zero padded matrix data
+  bool ok = true;
+  ok &= fwrite(&header, sizeof(cvmats_header_t), 1, outfile) == 1;
+  for (const auto &entry : entries) {
+    ok &= fwrite(&entry, sizeof(cvmats_entry_t), 1, outfile) == 1;
+  }
+  const char padding[CVMATS_ALIGN] = {0};
+  for (size_t i = 0; i < data.size() && ok; i++) {
+    const long pad = entries[i].offset - ftell(outfile);
+    ok &= fwrite(padding, 1, pad, outfile) == (size_t) pad;
+    ok &= fwrite(data[i].data, 1, entries[i].size, outfile) == entries[i].size;
+  }
+  fclose(outfile);
+
+  if (ok == false) {
+    LOG_ERROR("Failed to write [%s]!", save_path.c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+int cvmats_load(const std::string &data_path,
+                std::vector<cv::Mat> &mats,
+                std::shared_ptr<void> &mapping) {
+  mats.clear();
+  mapping.reset();
+
+  // Memory map file, copy-on-write so the matrices stay writable
+  const int fd = open(data_path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    LOG_ERROR("Failed to open [%s]!", data_path.c_str());
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cvmats_header_t)) {
+    LOG_ERROR("Invalid file [%s]!", data_path.c_str());
+    close(fd);
+    return -1;
+  }
+  const size_t file_size = st.st_size;
+  const int prot = PROT_READ | PROT_WRITE;
+  void *addr = mmap(NULL, file_size, prot, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG_ERROR("Failed to mmap [%s]!", data_path.c_str());
+    return -1;
+  }
+  mapping = std::shared_ptr<void>(addr, [file_size](void *p) {
+    munmap(p, file_size);
+  });
+
+  // Check header
+  uint8_t *bytes = (uint8_t *) addr;
+  const cvmats_header_t *header = (const cvmats_header_t *) bytes;
+  const size_t entries_end = sizeof(cvmats_header_t) +
+                             sizeof(cvmats_entry_t) * header->nb_mats;
+  if (strncmp(header->magic, CVMATS_MAGIC, sizeof(header->magic)) != 0 ||
+      header->nb_mats > file_size || entries_end > file_size) {
+    LOG_ERROR("Invalid file [%s]!", data_path.c_str());
+    mapping.reset();
+    return -1;
+  }
+
+  // Point matrices into mapped file
+  const cvmats_entry_t *entries =
+      (const cvmats_entry_t *) (bytes + sizeof(cvmats_header_t));
+  for (size_t i = 0; i < header->nb_mats; i++) {
+    const cvmats_entry_t &entry = entries[i];
+    if (entry.offset > file_size || entry.size > file_size - entry.offset) {
+      LOG_ERROR("Invalid matrix [%zu] in [%s]!", i, data_path.c_str());
+      mats.clear();
+      mapping.reset();
+      return -1;
+    }
+
+    cv::Mat mat(entry.rows, entry.cols, entry.type, bytes + entry.offset);
+    if (mat.total() * mat.elemSize() != entry.size) {
+      LOG_ERROR("Invalid matrix [%zu] in [%s]!", i, data_path.c_str());
+      mats.clear();
+      mapping.reset();
+      return -1;
+    }
+    mats.push_back(mat);
+  }
+
+  return 0;
+}
+
+int undistort_map_init(undistort_map_t &map,
+                       const calib_params_t &cam,
+                       const real_t balance) {
+  camera_model_t model;
+  if (calib_camera_model(cam, model) != 0) {
+    return -1;
+  }
+
+  map = undistort_map_t{};
+  map.img_w = cam.img_w;
+  map.img_h = cam.img_h;
+
+  const real_t fx = cam.proj_params(0);
+  const real_t fy = cam.proj_params(1);
+  const real_t cx = cam.proj_params(2);
+  const real_t cy = cam.proj_params(3);
+  const cv::Mat K = convert(pinhole_K(fx, fy, cx, cy));
+  const cv::Mat D = convert(cam.dist_params);
+  const cv::Mat R = cv::Mat::eye(3, 3, CV_64F);
+  const cv::Size size{cam.img_w, cam.img_h};
+
+  switch (model) {
+  case PINHOLE_RADTAN4: {
+    cv::initUndistortRectifyMap(K, D, R, K, size, CV_16SC2,
+                                map.map1, map.map2);
+    map.K_new = convert(K);
+    break;
+  }
+  case PINHOLE_EQUI4: {
+    cv::Mat K_new;
+    cv::fisheye::estimateNewCameraMatrixForUndistortRectify(K, D, size, R,
+                                                            K_new, balance);
+    cv::fisheye::initUndistortRectifyMap(K, D, R, K_new, size, CV_16SC2,
+                                         map.map1, map.map2);
+    map.K_new = convert(K_new);
+    break;
+  }
+  case DOUBLE_SPHERE: {
+    // No OpenCV equivalent, project the rays of every undistorted pixel and
+    // convert the floating point maps to fixed-point
+    const int w = cam.img_w;
+    const int h = cam.img_h;
+    cv::Mat map_x(h, w, CV_32FC1);
+    cv::Mat map_y(h, w, CV_32FC1);
+    std::vector<real_t> x(w), y(w), z(w, 1.0), u(w), v(w);
+    std::vector<uint8_t> valid(w);
+    for (int r = 0; r < h; r++) {
+      for (int c = 0; c < w; c++) {
+        x[c] = (c - cx) / fx;
+        y[c] = (r - cy) / fy;
+      }
+      camera_project_batch(model,
+                           cam.proj_params.data(),
+                           cam.dist_params.data(),
+                           w,
+                           x.data(),
+                           y.data(),
+                           z.data(),
+                           u.data(),
+                           v.data(),
+                           valid.data());
+
+      float *row_x = map_x.ptr<float>(r);
+      float *row_y = map_y.ptr<float>(r);
+      for (int c = 0; c < w; c++) {
+        row_x[c] = (valid[c]) ? u[c] : -1.0;
+        row_y[c] = (valid[c]) ? v[c] : -1.0;
+      }
+    }
+    cv::convertMaps(map_x, map_y, map.map1, map.map2, CV_16SC2);
+    map.K_new = convert(K);
+    break;
+  }
+  default:
+    LOG_ERROR("Unsupported camera model!");
+    return -1;
+  }
+
+  return 0;
+}
+
+int undistort_map_apply(const undistort_map_t &map,
+                        const cv::Mat &image,
+                        cv::Mat &image_ud) {
+  if (image.cols != map.img_w || image.rows != map.img_h) {
+    LOG_ERROR("Image size [%d, %d] != undistortion map size [%d, %d]!",
+              image.cols, image.rows, map.img_w, map.img_h);
+    return -1;
+  }
+
+  cv::remap(image, image_ud, map.map1, map.map2, cv::INTER_LINEAR);
+  return 0;
+}
+
+int undistort_map_save(const undistort_map_t &map,
+                       const std::string &save_path) {
+  const std::vector<cv::Mat> mats = {convert(map.K_new), map.map1, map.map2};
+  return cvmats_save(save_path, mats);
+}
+
+int undistort_map_load(undistort_map_t &map, const std::string &data_path) {
+  std::vector<cv::Mat> mats;
+  std::shared_ptr<void> mapping;
+  if (cvmats_load(data_path, mats, mapping) != 0) {
+    return -1;
+  }
+
+  // Check matrices
+  if (mats.size() != 3 ||
+      mats[0].rows != 3 || mats[0].cols != 3 || mats[0].type() != CV_64F ||
+      mats[1].type() != CV_16SC2 || mats[2].type() != CV_16UC1 ||
+      mats[1].size() != mats[2].size()) {
+    LOG_ERROR("Invalid undistortion map [%s]!", data_path.c_str());
+    return -1;
+  }
+
+  map = undistort_map_t{};
+  map.img_w = mats[1].cols;
+  map.img_h = mats[1].rows;
+  map.K_new = convert(mats[0]);
+  map.map1 = mats[1];
+  map.map2 = mats[2];
+  map.mapping = mapping;
+
+  return 0;
+}
+
+std::string undistort_map_fpath(const std::string &results_fpath,
+                                const int cam_index) {
+  const std::string cam = "cam" + std::to_string(cam_index);
+  return remove_ext(results_fpath) + "_" + cam + "_undistort.bin";
+}
+
+int rectify_map_init(rectify_map_t &map,
+                     const calib_params_t &cam0,
+                     const calib_params_t &cam1,
+                     const mat4_t &T_C0C1,
+                     const real_t balance) {
+  camera_model_t cam0_model;
+  camera_model_t cam1_model;
+  if (calib_camera_model(cam0, cam0_model) != 0 ||
+      calib_camera_model(cam1, cam1_model) != 0) {
+    return -1;
+  }
+  if (cam0_model != cam1_model) {
+    LOG_ERROR("Stereo cameras must have the same camera model!");
+    return -1;
+  }
+  if (cam0.img_w != cam1.img_w || cam0.img_h != cam1.img_h) {
+    LOG_ERROR("Stereo cameras must have the same resolution!");
+    return -1;
+  }
+
+  map = rectify_map_t{};
+  map.img_w = cam0.img_w;
+  map.img_h = cam0.img_h;
+
+  // OpenCV expects the rotation and translation from cam0 to cam1
+  const mat4_t T_C1C0 = T_C0C1.inverse();
+  const cv::Mat R = convert(tf_rot(T_C1C0));
+  const cv::Mat t = convert(tf_trans(T_C1C0));
+  const cv::Mat K0 = convert(pinhole_K(cam0.proj_params.head(4)));
+  const cv::Mat K1 = convert(pinhole_K(cam1.proj_params.head(4)));
+  const cv::Mat D0 = convert(cam0.dist_params);
+  const cv::Mat D1 = convert(cam1.dist_params);
+  const cv::Size size{cam0.img_w, cam0.img_h};
+
+  cv::Mat R0, R1, P0, P1, Q;
+  switch (cam0_model) {
+  case PINHOLE_RADTAN4: {
+    cv::stereoRectify(K0, D0, K1, D1, size, R, t, R0, R1, P0, P1, Q,
+                      cv::CALIB_ZERO_DISPARITY, balance);
+    cv::initUndistortRectifyMap(K0, D0, R0, P0, size, CV_16SC2,
+                                map.cam0_map1, map.cam0_map2);
+    cv::initUndistortRectifyMap(K1, D1, R1, P1, size, CV_16SC2,
+                                map.cam1_map1, map.cam1_map2);
+    break;
+  }
+  case PINHOLE_EQUI4: {
+    cv::fisheye::stereoRectify(K0, D0, K1, D1, size, R, t, R0, R1, P0, P1, Q,
+                               cv::fisheye::CALIB_ZERO_DISPARITY, size,
+                               balance);
+    cv::fisheye::initUndistortRectifyMap(K0, D0, R0, P0, size, CV_16SC2,
+                                         map.cam0_map1, map.cam0_map2);
+    cv::fisheye::initUndistortRectifyMap(K1, D1, R1, P1, size, CV_16SC2,
+                                         map.cam1_map1, map.cam1_map2);
+    break;
+  }
+  default:
+    LOG_ERROR("Unsupported camera model for stereo rectification!");
+    return -1;
+  }
+
+  map.R0 = convert(R0);
+  map.R1 = convert(R1);
+  map.P0 = convert(P0);
+  map.P1 = convert(P1);
+  map.Q = convert(Q);
+
+  return 0;
+}
+
+int rectify_map_apply(const rectify_map_t &map,
+                      const cv::Mat &image0,
+                      const cv::Mat &image1,
+                      cv::Mat &image0_rect,
+                      cv::Mat &image1_rect) {
+  const bool image0_ok = image0.cols == map.img_w && image0.rows == map.img_h;
+  const bool image1_ok = image1.cols == map.img_w && image1.rows == map.img_h;
+  if (image0_ok == false || image1_ok == false) {
+    LOG_ERROR("Image size != rectification map size [%d, %d]!",
+              map.img_w, map.img_h);
+    return -1;
+  }
+
+  cv::remap(image0, image0_rect, map.cam0_map1, map.cam0_map2,
+            cv::INTER_LINEAR);
+  cv::remap(image1, image1_rect, map.cam1_map1, map.cam1_map2,
+            cv::INTER_LINEAR);
+  return 0;
+}
+
+int rectify_map_save(const rectify_map_t &map, const std::string &save_path) {
+  const std::vector<cv::Mat> mats = {convert(map.R0),
+                                     convert(map.R1),
+                                     convert(map.P0),
+                                     convert(map.P1),
+                                     convert(map.Q),
+                                     map.cam0_map1,
+                                     map.cam0_map2,
+                                     map.cam1_map1,
+                                     map.cam1_map2};
+  return cvmats_save(save_path, mats);
+}
+
+int rectify_map_load(rectify_map_t &map, const std::string &data_path) {
+  std::vector<cv::Mat> mats;
+  std::shared_ptr<void> mapping;
+  if (cvmats_load(data_path, mats, mapping) != 0) {
+    return -1;
+  }
+
+  // Check matrices
+  const auto check_mat = [](const cv::Mat &mat, const int rows,
+                            const int cols, const int type) {
+    return mat.rows == rows && mat.cols == cols && mat.type() == type;
+  };
+  bool ok = mats.size() == 9;
+  ok = ok && check_mat(mats[0], 3, 3, CV_64F);
+  ok = ok && check_mat(mats[1], 3, 3, CV_64F);
+  ok = ok && check_mat(mats[2], 3, 4, CV_64F);
+  ok = ok && check_mat(mats[3], 3, 4, CV_64F);
+  ok = ok && check_mat(mats[4], 4, 4, CV_64F);
+  for (int i = 5; ok && i < 9; i += 2) {
+    ok = ok && mats[i].type() == CV_16SC2 && mats[i + 1].type() == CV_16UC1;
+    ok = ok && mats[i].size() == mats[5].size();
+    ok = ok && mats[i + 1].size() == mats[5].size();
+  }
+  if (ok == false) {
+    LOG_ERROR("Invalid rectification map [%s]!", data_path.c_str());
+    return -1;
+  }
+
+  map = rectify_map_t{};
+  map.img_w = mats[5].cols;
+  map.img_h = mats[5].rows;
+  map.R0 = convert(mats[0]);
+  map.R1 = convert(mats[1]);
+  map.P0 = convert(mats[2]);
+  map.P1 = convert(mats[3]);
+  map.Q = convert(mats[4]);
+  map.cam0_map1 = mats[5];
+  map.cam0_map2 = mats[6];
+  map.cam1_map1 = mats[7];
+  map.cam1_map2 = mats[8];
+  map.mapping = mapping;
+
+  return 0;
+}
+
+std::string rectify_map_fpath(const std::string &results_fpath) {
+  return remove_ext(results_fpath) + "_rectify.bin";
+}
+
+int undistort_poly_fit(undistort_poly_t &poly,
+                       const calib_params_t &cam,
+                       const int order,
+                       const real_t tolerance) {
+  camera_model_t model;
+  if (calib_camera_model(cam, model) != 0) {
+    return -1;
+  }
+  if (order < 1) {
+    LOG_ERROR("Invalid inverse distortion polynomial order [%d]!", order);
+    return -1;
+  }
+
+  poly = undistort_poly_t{};
+  poly.img_w = cam.img_w;
+  poly.img_h = cam.img_h;
+  poly.proj_params = cam.proj_params.head(4);
+  poly.tolerance = tolerance;
+
+  const int w = cam.img_w;
+  const int h = cam.img_h;
+  const real_t *proj_params = cam.proj_params.data();
+  const real_t *dist_params = cam.dist_params.data();
+  const real_t fx = proj_params[0];
+  const real_t fy = proj_params[1];
+  const real_t cx = proj_params[2];
+  const real_t cy = proj_params[3];
+
+  // Undistort a grid of pixels covering the whole image
+  const int grid_rows = 30;
+  const int grid_cols = 40;
+  std::vector<real_t> u;
+  std::vector<real_t> v;
+  for (int r = 0; r < grid_rows; r++) {
+    for (int c = 0; c < grid_cols; c++) {
+      u.push_back(c * (w - 1.0) / (grid_cols - 1.0));
+      v.push_back(r * (h - 1.0) / (grid_rows - 1.0));
+    }
+  }
+  const size_t n = u.size();
+  std::vector<real_t> x(n), y(n);
+  std::vector<uint8_t> converged(n);
+  camera_undistort_batch(model,
+                         proj_params,
+                         dist_params,
+                         n,
+                         u.data(),
+                         v.data(),
+                         x.data(),
+                         y.data(),
+                         converged.data());
+
+  // Form least squares problem, the polynomial is linear in its coefficients
+  std::vector<size_t> samples;
+  for (size_t i = 0; i < n; i++) {
+    if (converged[i]) {
+      samples.push_back(i);
+    }
+  }
+  const int nb_coeffs = order + 2;
+  if (samples.size() < (size_t) nb_coeffs) {
+    LOG_ERROR("Not enough undistorted pixels to fit polynomial!");
+    return -1;
+  }
+
+  matx_t A = zeros(2 * samples.size(), nb_coeffs);
+  vecx_t b = zeros(2 * samples.size(), 1);
+  for (size_t j = 0; j < samples.size(); j++) {
+    const size_t i = samples[j];
+    const real_t x_d = (u[i] - cx) / fx;
+    const real_t y_d = (v[i] - cy) / fy;
+    const real_t r2 = x_d * x_d + y_d * y_d;
+
+    real_t r2k = r2;
+    for (int k = 0; k < order; k++) {
+      A(2 * j, k) = x_d * r2k;
+      A(2 * j + 1, k) = y_d * r2k;
+      r2k *= r2;
+    }
+    A(2 * j, order) = 2.0 * x_d * y_d;
+    A(2 * j, order + 1) = r2 + 2.0 * x_d * x_d;
+    A(2 * j + 1, order) = r2 + 2.0 * y_d * y_d;
+    A(2 * j + 1, order + 1) = 2.0 * x_d * y_d;
+    b(2 * j) = x[i] - x_d;
+    b(2 * j + 1) = y[i] - y_d;
+  }
+  const vecx_t coeffs = A.colPivHouseholderQr().solve(b);
+  poly.radial = coeffs.head(order);
+  poly.tangential = coeffs.tail(2);
+
+  // Validate every pixel against the forward camera model
+  real_t max_error = 0.0;
+  real_t sse = 0.0;
+  size_t nb_pixels = 0;
+#pragma omp parallel for reduction(max : max_error) \
+    reduction(+ : sse, nb_pixels)
+  for (int r = 0; r < h; r++) {
+    std::vector<real_t> u_row(w), v_row(w, r);
+    std::vector<real_t> x_row(w), y_row(w), z_row(w, 1.0);
+    std::vector<real_t> x_ref(w), y_ref(w);
+    std::vector<real_t> u_est(w), v_est(w);
+    std::vector<uint8_t> valid(w), converged_row(w);
+    for (int c = 0; c < w; c++) {
+      u_row[c] = c;
+    }
+    camera_undistort_batch(model,
+                           proj_params,
+                           dist_params,
+                           w,
+                           u_row.data(),
+                           v_row.data(),
+                           x_ref.data(),
+                           y_ref.data(),
+                           converged_row.data());
+    undistort_poly_batch(poly,
+                         w,
+                         u_row.data(),
+                         v_row.data(),
+                         x_row.data(),
+                         y_row.data());
+    camera_project_batch(model,
+                         proj_params,
+                         dist_params,
+                         w,
+                         x_row.data(),
+                         y_row.data(),
+                         z_row.data(),
+                         u_est.data(),
+                         v_est.data(),
+                         valid.data());
+
+    for (int c = 0; c < w; c++) {
+      if (converged_row[c] == 0) {
+        continue;
+      }
+      real_t err = std::numeric_limits<real_t>::infinity();
+      if (valid[c]) {
+        const real_t du = u_est[c] - u_row[c];
+        const real_t dv = v_est[c] - v_row[c];
+        err = sqrt(du * du + dv * dv);
+      }
+      max_error = std::max(max_error, err);
+      sse += err * err;
+      nb_pixels++;
+    }
+  }
+  poly.max_error = max_error;
+  poly.rms_error = (nb_pixels) ? sqrt(sse / nb_pixels) : 0.0;
+
+  if (poly.max_error > tolerance) {
+    LOG_ERROR("Polynomial error [%f px] > tolerance [%f px]!",
+              poly.max_error,
+              tolerance);
+    return -1;
+  }
+
+  return 0;
+}
+
+void undistort_poly_batch(const undistort_poly_t &poly,
+                          const size_t n,
+                          const real_t *u,
+                          const real_t *v,
+                          real_t *x,
+                          real_t *y) {
+  const real_t fx = poly.proj_params(0);
+  const real_t fy = poly.proj_params(1);
+  const real_t cx = poly.proj_params(2);
+  const real_t cy = poly.proj_params(3);
+  const real_t t1 = poly.tangential(0);
+  const real_t t2 = poly.tangential(1);
+  const real_t *b = poly.radial.data();
+  const int order = poly.radial.size();
+
+#pragma omp simd
+  for (size_t i = 0; i < n; i++) {
+    const real_t x_d = (u[i] - cx) / fx;
+    const real_t y_d = (v[i] - cy) / fy;
+    const real_t xy = x_d * y_d;
+    const real_t r2 = x_d * x_d + y_d * y_d;
+
+    // Horner's scheme of R(r^2) - 1
+    real_t radial = 0.0;
+    for (int k = order - 1; k >= 0; k--) {
+      radial = (radial + b[k]) * r2;
+    }
+    radial += 1.0;
+
+    x[i] = x_d * radial + 2.0 * t1 * xy + t2 * (r2 + 2.0 * x_d * x_d);
+    y[i] = y_d * radial + t1 * (r2 + 2.0 * y_d * y_d) + 2.0 * t2 * xy;
+  }
+}
+
+vec2_t undistort_poly_point(const undistort_poly_t &poly, const vec2_t &z) {
+  vec2_t p;
+  undistort_poly_batch(poly, 1, &z(0), &z(1), &p(0), &p(1));
+  return p;
+}
+
+static std::string poly2str(const vecx_t &v) {
+  // Full precision, higher order coefficients grow large
+  std::ostringstream ss;
+  ss << std::setprecision(17) << "[";
+  for (int i = 0; i < v.size(); i++) {
+    ss << v(i) << ((i + 1 < v.size()) ? ", " : "");
+  }
+  ss << "]";
+  return ss.str();
+}
+
+int undistort_poly_save(const undistort_poly_t &poly,
+                        const std::string &save_path) {
+  FILE *outfile = fopen(save_path.c_str(), "w");
+  if (outfile == NULL) {
+    LOG_ERROR("Failed to open [%s] for writing!", save_path.c_str());
+    return -1;
+  }
+
+  const auto proj_params = poly2str(poly.proj_params);
+  const auto radial = poly2str(poly.radial);
+  const auto tangential = poly2str(poly.tangential);
+  fprintf(outfile, "resolution: [%d, %d]\n", poly.img_w, poly.img_h);
+  fprintf(outfile, "proj_params: %s\n", proj_params.c_str());
+  fprintf(outfile, "radial: %s\n", radial.c_str());
+  fprintf(outfile, "tangential: %s\n", tangential.c_str());
+  fprintf(outfile, "tolerance: %f  # [px]\n", poly.tolerance);
+  fprintf(outfile, "max_error: %f  # [px]\n", poly.max_error);
+  fprintf(outfile, "rms_error: %f  # [px]\n", poly.rms_error);
+  fclose(outfile);
+
+  return 0;
+}
+
+int undistort_poly_load(undistort_poly_t &poly, const std::string &data_path) {
+  config_t config{data_path};
+  if (config.ok == false) {
+    LOG_ERROR("Failed to load [%s]!", data_path.c_str());
+    return -1;
+  }
+
+  poly = undistort_poly_t{};
+  vec2_t resolution;
+  int retval = 0;
+  retval += parse(config, "resolution", resolution);
+  retval += parse(config, "proj_params", poly.proj_params);
+  retval += parse(config, "radial", poly.radial);
+  retval += parse(config, "tangential", poly.tangential);
+  retval += parse(config, "tolerance", poly.tolerance);
+  retval += parse(config, "max_error", poly.max_error);
+  retval += parse(config, "rms_error", poly.rms_error);
+  if (retval != 0) {
+    LOG_ERROR("Failed to parse [%s]!", data_path.c_str());
+    return -1;
+  }
+  poly.img_w = resolution(0);
+  poly.img_h = resolution(1);
+
+  return 0;
+}
+
+std::string undistort_poly_fpath(const std::string &results_fpath,
+                                 const int cam_index) {
+  const std::string cam = "cam" + std::to_string(cam_index);
+  return remove_ext(results_fpath) + "_" + cam + "_undistort_poly.yaml";
+}
+
+static int bearing_lut_size(const int size, const int step) {
+  // Nodes cover [0, size - 1], the last node may lie past the image
+  return (size - 1 + step - 1) / step + 1;
+}
+
+int bearing_lut_init(bearing_lut_t &lut,
+                     const calib_params_t &cam,
+                     const int step) {
+  camera_model_t model;
+  if (calib_camera_model(cam, model) != 0) {
+    return -1;
+  }
+  if (step < 1 || cam.img_w < 2 || cam.img_h < 2) {
+    LOG_ERROR("Invalid bearing lookup table step [%d] or resolution!", step);
+    return -1;
+  }
+
+  lut = bearing_lut_t{};
+  lut.img_w = cam.img_w;
+  lut.img_h = cam.img_h;
+  lut.step = step;
+
+  const int rows = bearing_lut_size(cam.img_h, step);
+  const int cols = bearing_lut_size(cam.img_w, step);
+  lut.bearings = cv::Mat(rows, cols, CV_32FC3);
+
+  const real_t *proj_params = cam.proj_params.data();
+  const real_t *dist_params = cam.dist_params.data();
+  const real_t params[8] = {proj_params[0], proj_params[1],
+                            proj_params[2], proj_params[3],
+                            dist_params[0], dist_params[1],
+                            dist_params[2], dist_params[3]};
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+
+#pragma omp parallel for
+  for (int r = 0; r < rows; r++) {
+    float *row = lut.bearings.ptr<float>(r);
+
+    // Double sphere unprojects in closed form, including bearings beyond 90
+    // degrees that have no normalized image point
+    if (model == DOUBLE_SPHERE) {
+      for (int c = 0; c < cols; c++) {
+        const real_t u = c * step;
+        const real_t v = r * step;
+        vec3_t bearing;
+        const bool ok = double_sphere_unproject(params, {u, v}, bearing) == 0;
+        row[3 * c + 0] = (ok) ? bearing(0) : nan;
+        row[3 * c + 1] = (ok) ? bearing(1) : nan;
+        row[3 * c + 2] = (ok) ? bearing(2) : nan;
+      }
+      continue;
+    }
+
+    std::vector<real_t> u(cols), v(cols, r * step), x(cols), y(cols);
+    std::vector<uint8_t> converged(cols);
+    for (int c = 0; c < cols; c++) {
+      u[c] = c * step;
+    }
+    camera_undistort_batch(model,
+                           proj_params,
+                           dist_params,
+                           cols,
+                           u.data(),
+                           v.data(),
+                           x.data(),
+                           y.data(),
+                           converged.data());
+    for (int c = 0; c < cols; c++) {
+      const real_t norm = sqrt(x[c] * x[c] + y[c] * y[c] + 1.0);
+      row[3 * c + 0] = (converged[c]) ? x[c] / norm : nan;
+      row[3 * c + 1] = (converged[c]) ? y[c] / norm : nan;
+      row[3 * c + 2] = (converged[c]) ? 1.0 / norm : nan;
+    }
+  }
+
+  return 0;
+}
+
+int bearing_lut_lookup(const bearing_lut_t &lut,
+                       const vec2_t &z,
+                       vec3_t &bearing) {
+  // Check point is inside the table, written so that NaNs fail too
+  const int rows = lut.bearings.rows;
+  const int cols = lut.bearings.cols;
+  const real_t gx = z(0) / lut.step;
+  const real_t gy = z(1) / lut.step;
+  if (!(gx >= 0.0 && gx <= cols - 1.0 && gy >= 0.0 && gy <= rows - 1.0)) {
+    return -1;
+  }
+
+  // Bilinear interpolation between the four surrounding nodes
+  const int c0 = std::min((int) gx, cols - 2);
+  const int r0 = std::min((int) gy, rows - 2);
+  const real_t a = gx - c0;
+  const real_t b = gy - r0;
+  const float *b00 = lut.bearings.ptr<float>(r0) + 3 * c0;
+  const float *b10 = lut.bearings.ptr<float>(r0 + 1) + 3 * c0;
+  for (int i = 0; i < 3; i++) {
+    bearing(i) = (1.0 - a) * (1.0 - b) * b00[i] + a * (1.0 - b) * b00[3 + i];
+    bearing(i) += (1.0 - a) * b * b10[i] + a * b * b10[3 + i];
+  }
+
+  const real_t norm = bearing.norm();
+  if (!(norm > 0.0)) {
+    return -1;
+  }
+  bearing /= norm;
+
+  return 0;
+}
+
+int bearing_lut_save(const bearing_lut_t &lut, const std::string &save_path) {
+  cv::Mat meta(1, 3, CV_32S);
+  meta.at<int32_t>(0, 0) = lut.img_w;
+  meta.at<int32_t>(0, 1) = lut.img_h;
+  meta.at<int32_t>(0, 2) = lut.step;
+  return cvmats_save(save_path, {meta, lut.bearings});
+}
+
+int bearing_lut_load(bearing_lut_t &lut, const std::string &data_path) {
+  std::vector<cv::Mat> mats;
+  std::shared_ptr<void> mapping;
+  if (cvmats_load(data_path, mats, mapping) != 0) {
+    return -1;
+  }
+
+  // Check matrices
+  bool ok = mats.size() == 2;
+  ok = ok && mats[0].rows == 1 && mats[0].cols == 3;
+  ok = ok && mats[0].type() == CV_32S && mats[1].type() == CV_32FC3;
+  if (ok) {
+    const int img_w = mats[0].at<int32_t>(0, 0);
+    const int img_h = mats[0].at<int32_t>(0, 1);
+    const int step = mats[0].at<int32_t>(0, 2);
+    ok = step >= 1 && img_w >= 2 && img_h >= 2;
+    ok = ok && mats[1].rows == bearing_lut_size(img_h, step);
+    ok = ok && mats[1].cols == bearing_lut_size(img_w, step);
+  }
+  if (ok == false) {
+    LOG_ERROR("Invalid bearing lookup table [%s]!", data_path.c_str());
+    return -1;
+  }
+
+  lut = bearing_lut_t{};
+  lut.img_w = mats[0].at<int32_t>(0, 0);
+  lut.img_h = mats[0].at<int32_t>(0, 1);
+  lut.step = mats[0].at<int32_t>(0, 2);
+  lut.bearings = mats[1];
+  lut.mapping = mapping;
+
+  return 0;
+}
+
+std::string bearing_lut_fpath(const std::string &results_fpath,
+                              const int cam_index) {
+  const std::string cam = "cam" + std::to_string(cam_index);
+  return remove_ext(results_fpath) + "_" + cam + "_bearings.bin";
+}
+
+} //  namespace yac
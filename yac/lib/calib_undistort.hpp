@@ -0,0 +1,312 @@
+#ifndef YAC_CALIB_UNDISTORT_HPP
+#define YAC_CALIB_UNDISTORT_HPP
+
+#include <iostream>
+#include <string>
+#include <memory>
+
+#include "core.hpp"
+#include "calib_data.hpp"
+
+namespace yac {
+
+/**
+ * Save `mats` to a binary file at `save_path`. The file starts with a header
+ * listing the size, type and offset of every matrix, followed by the raw
+ * matrix data aligned to 64 bytes, so it can be memory mapped by
+ * `cvmats_load()` without copying or parsing.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int cvmats_save(const std::string &save_path, const std::vector<cv::Mat> &mats);
+
+/**
+ * Load matrices saved by `cvmats_save()` from `data_path`. The file is memory
+ * mapped and `mats` point directly into the mapping, which is released once
+ * the last copy of `mapping` goes out of scope.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int cvmats_load(const std::string &data_path,
+                std::vector<cv::Mat> &mats,
+                std::shared_ptr<void> &mapping);
+
+/**
+ * Undistortion map. Maps every pixel of the undistorted image to the
+ * distorted image in OpenCV's fixed-point format, `map1` holds the integer
+ * pixel coordinates (CV_16SC2) and `map2` the interpolation table index
+ * (CV_16UC1). Build it once per camera calibration and apply it to every
+ * image with `undistort_map_apply()`.
+ */
+struct undistort_map_t {
+  int img_w = 0;
+  int img_h = 0;
+  mat3_t K_new = I(3);           ///< Camera matrix of the undistorted image
+  cv::Mat map1;
+  cv::Mat map2;
+  std::shared_ptr<void> mapping; ///< Backing memory if loaded from file
+
+  undistort_map_t() {}
+  ~undistort_map_t() {}
+};
+
+/**
+ * Initialize undistortion `map` of camera `cam`. Radial-tangential cameras
+ * keep their camera matrix as in `radtan_undistort_image()`, equidistant
+ * cameras estimate a new camera matrix with `balance` as in
+ * `equi_undistort_image()`. Double sphere cameras are undistorted to a
+ * pinhole camera with the same camera matrix.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int undistort_map_init(undistort_map_t &map,
+                       const calib_params_t &cam,
+                       const real_t balance = 0.0);
+
+/**
+ * Undistort `image` with undistortion `map`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int undistort_map_apply(const undistort_map_t &map,
+                        const cv::Mat &image,
+                        cv::Mat &image_ud);
+
+/**
+ * Save undistortion `map` to `save_path`, see `cvmats_save()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int undistort_map_save(const undistort_map_t &map,
+                       const std::string &save_path);
+
+/**
+ * Load undistortion `map` from `data_path` by memory mapping the file, see
+ * `cvmats_load()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int undistort_map_load(undistort_map_t &map, const std::string &data_path);
+
+/**
+ * Path of the undistortion map of camera `cam_index` saved next to the
+ * calibration results at `results_fpath`.
+ */
+std::string undistort_map_fpath(const std::string &results_fpath,
+                                const int cam_index);
+
+/**
+ * Stereo rectification map. Holds the rectifying rotations `R0` and `R1`,
+ * the projection matrices `P0` and `P1` of the rectified cameras, the
+ * disparity-to-depth matrix `Q` and the fixed-point remap tables of both
+ * cameras, in the same format as `undistort_map_t`.
+ */
+struct rectify_map_t {
+  int img_w = 0;
+  int img_h = 0;
+  mat3_t R0 = I(3);
+  mat3_t R1 = I(3);
+  mat34_t P0 = zeros(3, 4);
+  mat34_t P1 = zeros(3, 4);
+  mat4_t Q = I(4);
+  cv::Mat cam0_map1;
+  cv::Mat cam0_map2;
+  cv::Mat cam1_map1;
+  cv::Mat cam1_map2;
+  std::shared_ptr<void> mapping; ///< Backing memory if loaded from file
+
+  rectify_map_t() {}
+  ~rectify_map_t() {}
+};
+
+/**
+ * Initialize stereo rectification `map` of cameras `cam0` and `cam1` with
+ * relative pose `T_C0C1`. Both cameras must have the same resolution and use
+ * the same radial-tangential or equidistant camera model. `balance` in [0, 1]
+ * trades between keeping only valid pixels (0) and keeping all source pixels
+ * (1) in the rectified images.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int rectify_map_init(rectify_map_t &map,
+                     const calib_params_t &cam0,
+                     const calib_params_t &cam1,
+                     const mat4_t &T_C0C1,
+                     const real_t balance = 0.0);
+
+/**
+ * Rectify stereo images `image0` and `image1` with rectification `map`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int rectify_map_apply(const rectify_map_t &map,
+                      const cv::Mat &image0,
+                      const cv::Mat &image1,
+                      cv::Mat &image0_rect,
+                      cv::Mat &image1_rect);
+
+/**
+ * Save stereo rectification `map` to `save_path`, see `cvmats_save()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int rectify_map_save(const rectify_map_t &map, const std::string &save_path);
+
+/**
+ * Load stereo rectification `map` from `data_path` by memory mapping the
+ * file, see `cvmats_load()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int rectify_map_load(rectify_map_t &map, const std::string &data_path);
+
+/**
+ * Path of the stereo rectification map saved next to the calibration results
+ * at `results_fpath`.
+ */
+std::string rectify_map_fpath(const std::string &results_fpath);
+
+/**
+ * Inverse distortion polynomial. Maps the distorted normalized image point
+ * `p_d = (x_d, y_d)` of a pixel directly to the undistorted normalized point
+ *
+ *     x = x_d * R(r_d^2) + 2 t1 x_d y_d + t2 (r_d^2 + 2 x_d^2)
+ *     y = y_d * R(r_d^2) + t1 (r_d^2 + 2 y_d^2) + 2 t2 x_d y_d
+ *
+ * with R(r_d^2) = 1 + b1 r_d^2 + ... + bK r_d^2K, so undistorting a point is
+ * a fixed number of multiply-adds instead of an iterative solve. Fitted by
+ * `undistort_poly_fit()`, which also records its error in pixels against the
+ * forward camera model.
+ */
+struct undistort_poly_t {
+  int img_w = 0;
+  int img_h = 0;
+  vec4_t proj_params = zeros(4, 1); ///< fx, fy, cx, cy
+  vecx_t radial;                    ///< b1 ... bK
+  vec2_t tangential = zeros(2, 1);  ///< t1, t2
+  real_t tolerance = 0.0;           ///< Validation tolerance [px]
+  real_t max_error = 0.0;           ///< Max reprojection error [px]
+  real_t rms_error = 0.0;           ///< RMS reprojection error [px]
+
+  undistort_poly_t() {}
+  ~undistort_poly_t() {}
+};
+
+/**
+ * Fit inverse distortion polynomial `poly` with `order` radial coefficients
+ * to camera `cam`. The polynomial is fitted by linear least squares to a grid
+ * of pixels undistorted with `camera_undistort_batch()`, then validated by
+ * undistorting every pixel with the polynomial and reprojecting it with the
+ * forward camera model. Pixels the iterative undistortion fails on are
+ * outside the model and are not validated.
+ *
+ * @returns 0 or -1 for success or failure, including a max reprojection
+ * error above `tolerance` pixels
+ */
+int undistort_poly_fit(undistort_poly_t &poly,
+                       const calib_params_t &cam,
+                       const int order = 8,
+                       const real_t tolerance = 0.2);
+
+/**
+ * Undistort `n` image points (`u`, `v`) to normalized image points (`x`,
+ * `y`) with inverse distortion polynomial `poly`.
+ */
+void undistort_poly_batch(const undistort_poly_t &poly,
+                          const size_t n,
+                          const real_t *u,
+                          const real_t *v,
+                          real_t *x,
+                          real_t *y);
+
+/**
+ * Undistort image point `z` to a normalized image point with inverse
+ * distortion polynomial `poly`.
+ */
+vec2_t undistort_poly_point(const undistort_poly_t &poly, const vec2_t &z);
+
+/**
+ * Save inverse distortion polynomial `poly` as yaml to `save_path`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int undistort_poly_save(const undistort_poly_t &poly,
+                        const std::string &save_path);
+
+/**
+ * Load inverse distortion polynomial `poly` from yaml file `data_path`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int undistort_poly_load(undistort_poly_t &poly, const std::string &data_path);
+
+/**
+ * Path of the inverse distortion polynomial of camera `cam_index` saved next
+ * to the calibration results at `results_fpath`.
+ */
+std::string undistort_poly_fpath(const std::string &results_fpath,
+                                 const int cam_index);
+
+/**
+ * Bearing vector lookup table. Holds the unit bearing vector of every
+ * `step`-th pixel in a CV_32FC3 grid, so grid node (`r`, `c`) is the bearing
+ * of pixel (`c * step`, `r * step`). With a `step` of 1 every pixel is stored
+ * and dense back-projection is a plain table read, larger steps trade
+ * accuracy for memory with bilinear interpolation in `bearing_lut_lookup()`.
+ * Pixels the camera model cannot unproject are NaN.
+ */
+struct bearing_lut_t {
+  int img_w = 0;
+  int img_h = 0;
+  int step = 1;
+  cv::Mat bearings;
+  std::shared_ptr<void> mapping; ///< Backing memory if loaded from file
+
+  bearing_lut_t() {}
+  ~bearing_lut_t() {}
+};
+
+/**
+ * Initialize bearing lookup table `lut` of camera `cam`, sampling every
+ * `step`-th pixel. Rows of the table are computed in parallel.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int bearing_lut_init(bearing_lut_t &lut,
+                     const calib_params_t &cam,
+                     const int step = 1);
+
+/**
+ * Look up the unit `bearing` of image point `z` in `lut`, bilinearly
+ * interpolating between grid nodes.
+ *
+ * @returns 0 for success, -1 if `z` is outside the table or has no bearing
+ */
+int bearing_lut_lookup(const bearing_lut_t &lut,
+                       const vec2_t &z,
+                       vec3_t &bearing);
+
+/**
+ * Save bearing lookup table `lut` to `save_path`, see `cvmats_save()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int bearing_lut_save(const bearing_lut_t &lut, const std::string &save_path);
+
+/**
+ * Load bearing lookup table `lut` from `data_path` by memory mapping the
+ * file, see `cvmats_load()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int bearing_lut_load(bearing_lut_t &lut, const std::string &data_path);
+
+/**
+ * Path of the bearing lookup table of camera `cam_index` saved next to the
+ * calibration results at `results_fpath`.
+ */
+std::string bearing_lut_fpath(const std::string &results_fpath,
+                              const int cam_index);
+
+} //  namespace yac
+#endif // YAC_CALIB_UNDISTORT_HPP
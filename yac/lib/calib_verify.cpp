@@ -0,0 +1,399 @@
+#include "calib_verify.hpp"
+
+namespace yac {
+
+static int estimate_mono_pose(const calib_obs_t &obs,
+                              const size_t frame_idx,
+                              calib_params_t &cam,
+                              mat4_t &T_CF) {
+  // Optimization variables
+  calib_pose_t pose_param{T_CF};
+
+  // Setup optimization problem
+  ceres::Problem::Options problem_options;
+  problem_options.local_parameterization_ownership =
+      ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+
+  // Add frame observations
+  const size_t start = obs.frame_offsets[frame_idx];
+  const size_t end = obs.frame_offsets[frame_idx + 1];
+  for (size_t i = start; i < end; i++) {
+    const auto residual = new calib_mono_residual_t{cam.proj_model,
+                                                    cam.dist_model,
+                                                    obs.keypoints[i],
+                                                    obs.object_points[i]};
+    const auto cost_func =
+        new ceres::AutoDiffCostFunction<calib_mono_residual_t,
+                                        2, // Size of: residual
+                                        4, // Size of: intrinsics
+                                        4, // Size of: distortion
+                                        4, // Size of: q_CF
+                                        3  // Size of: r_CF
+                                        >(residual);
+    problem.AddResidualBlock(cost_func, // Cost function
+                             NULL,      // Loss function
+                             cam.proj_params.data(),
+                             cam.dist_params.data(),
+                             pose_param.q,
+                             pose_param.r);
+  }
+  if (problem.NumResidualBlocks() == 0) {
+    return -1;
+  }
+
+  // Only the pose is estimated
+  problem.SetParameterBlockConstant(cam.proj_params.data());
+  problem.SetParameterBlockConstant(cam.dist_params.data());
+  problem.SetParameterization(pose_param.q, &quaternion_parameterization);
+
+  // Solve
+  ceres::Solver::Options options;
+  options.max_num_iterations = 20;
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+  T_CF = pose_param.T();
+
+  return 0;
+}
+
+static int estimate_stereo_pose(const aprilgrid_t &cam0_aprilgrid,
+                                const aprilgrid_t &cam1_aprilgrid,
+                                const camera_model_t cam0_model,
+                                const camera_model_t cam1_model,
+                                const vec3s_t *object_points,
+                                calib_params_t &cam0,
+                                calib_params_t &cam1,
+                                calib_pose_t &extrinsic_param,
+                                mat4_t &T_C0F) {
+  // Optimization variables
+  calib_pose_t pose_param{T_C0F};
+
+  // Setup optimization problem
+  ceres::Problem::Options problem_options;
+  problem_options.local_parameterization_ownership =
+      ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+
+  // Add frame observations
+  for (const auto &tag_id : cam0_aprilgrid.ids) {
+    vec2s_t cam0_keypoints;
+    vec2s_t cam1_keypoints;
+    if (aprilgrid_get(cam0_aprilgrid, tag_id, cam0_keypoints) != 0 ||
+        aprilgrid_get(cam1_aprilgrid, tag_id, cam1_keypoints) != 0 ||
+        (size_t) (tag_id * 4 + 3) >= object_points->size()) {
+      LOG_ERROR("Failed to get AprilGrid measurements!");
+      return -1;
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+      const auto residual = new calib_stereo_residual_t{cam0_model,
+                                                        cam1_model,
+                                                        cam0_keypoints[i],
+                                                        cam1_keypoints[i],
+                                                        object_points,
+                                                        tag_id * 4 + i};
+      const auto cost_func =
+          new ceres::AutoDiffCostFunction<calib_stereo_residual_t,
+                                          4, // Size of: residual
+                                          4, // Size of: cam0_intrinsics
+                                          4, // Size of: cam0_distortion
+                                          4, // Size of: cam1_intrinsics
+                                          4, // Size of: cam1_distortion
+                                          4, // Size of: q_C1C0
+                                          3, // Size of: t_C1C0
+                                          4, // Size of: q_C0F
+                                          3  // Size of: t_C0F
+                                          >(residual);
+      problem.AddResidualBlock(cost_func, // Cost function
+                               NULL,      // Loss function
+                               cam0.proj_params.data(),
+                               cam0.dist_params.data(),
+                               cam1.proj_params.data(),
+                               cam1.dist_params.data(),
+                               extrinsic_param.q,
+                               extrinsic_param.r,
+                               pose_param.q,
+                               pose_param.r);
+    }
+  }
+  if (problem.NumResidualBlocks() == 0) {
+    return -1;
+  }
+
+  // Only the pose is estimated
+  problem.SetParameterBlockConstant(cam0.proj_params.data());
+  problem.SetParameterBlockConstant(cam0.dist_params.data());
+  problem.SetParameterBlockConstant(cam1.proj_params.data());
+  problem.SetParameterBlockConstant(cam1.dist_params.data());
+  problem.SetParameterBlockConstant(extrinsic_param.q);
+  problem.SetParameterBlockConstant(extrinsic_param.r);
+  problem.SetParameterization(pose_param.q, &quaternion_parameterization);
+
+  // Solve
+  ceres::Solver::Options options;
+  options.max_num_iterations = 20;
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+  T_C0F = pose_param.T();
+
+  return 0;
+}
+
+int calib_verify_mono(const aprilgrids_t &aprilgrids,
+                      const calib_params_t &cam,
+                      const real_t max_rmse,
+                      calib_verify_stats_t &stats) {
+  stats = calib_verify_stats_t{};
+
+  // Flatten observations
+  calib_obs_t obs;
+  if (calib_obs_init(obs, aprilgrids) != 0) {
+    LOG_ERROR("Failed to form calibration observations!");
+    return -1;
+  }
+
+  // Estimate per-frame poses in parallel
+  const size_t nb_frames = obs.nb_frames();
+  mat4s_t poses(nb_frames);
+  std::vector<uint8_t> estimated(nb_frames, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t k = 0; k < nb_frames; k++) {
+    calib_params_t cam_params = cam;
+    poses[k] = aprilgrids[k].T_CF;
+    estimated[k] = (estimate_mono_pose(obs, k, cam_params, poses[k]) == 0);
+  }
+
+  // Reprojection error statistics at the estimated poses
+  if (calib_stats_init(stats.reproj, obs, cam, poses) != 0) {
+    LOG_ERROR("Failed to evaluate calibration statistics!");
+    return -1;
+  }
+  stats.nb_frames = std::count(estimated.begin(), estimated.end(), 1);
+  stats.pass = (stats.reproj.nb_residuals > 0);
+  stats.pass = stats.pass && (stats.reproj.rmse <= max_rmse);
+
+  return 0;
+}
+
+int calib_verify_stereo(const aprilgrids_t &cam0_aprilgrids,
+                        const aprilgrids_t &cam1_aprilgrids,
+                        const calib_params_t &cam0,
+                        const calib_params_t &cam1,
+                        const mat4_t &T_C0C1,
+                        const real_t max_rmse,
+                        calib_verify_stats_t &cam0_stats,
+                        calib_verify_stats_t &cam1_stats) {
+  assert(cam0_aprilgrids.size() == cam1_aprilgrids.size());
+  cam0_stats = calib_verify_stats_t{};
+  cam1_stats = calib_verify_stats_t{};
+
+  // Flatten observations of each camera
+  calib_obs_t cam0_obs;
+  calib_obs_t cam1_obs;
+  if (calib_obs_init(cam0_obs, cam0_aprilgrids) != 0 ||
+      calib_obs_init(cam1_obs, cam1_aprilgrids) != 0) {
+    LOG_ERROR("Failed to form calibration observations!");
+    return -1;
+  }
+
+  // Camera models and object point table shared by all residuals
+  camera_model_t cam0_model;
+  camera_model_t cam1_model;
+  if (calib_camera_model(cam0, cam0_model) != 0 ||
+      calib_camera_model(cam1, cam1_model) != 0) {
+    return -1;
+  }
+  vec3s_t object_points;
+  if (cam0_aprilgrids.size() > 0 &&
+      aprilgrid_object_points(cam0_aprilgrids[0], object_points) != 0) {
+    LOG_ERROR("Failed to calculate AprilGrid object points!");
+    return -1;
+  }
+
+  // Estimate per-frame poses in parallel
+  const mat4_t T_C1C0 = T_C0C1.inverse();
+  const size_t nb_frames = cam0_aprilgrids.size();
+  mat4s_t cam0_poses(nb_frames);
+  mat4s_t cam1_poses(nb_frames);
+  std::vector<uint8_t> estimated(nb_frames, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t k = 0; k < nb_frames; k++) {
+    calib_params_t cam0_params = cam0;
+    calib_params_t cam1_params = cam1;
+    calib_pose_t extrinsic_param{T_C1C0};
+    cam0_poses[k] = cam0_aprilgrids[k].T_CF;
+    estimated[k] = (estimate_stereo_pose(cam0_aprilgrids[k],
+                                         cam1_aprilgrids[k],
+                                         cam0_model,
+                                         cam1_model,
+                                         &object_points,
+                                         cam0_params,
+                                         cam1_params,
+                                         extrinsic_param,
+                                         cam0_poses[k]) == 0);
+    cam1_poses[k] = T_C1C0 * cam0_poses[k];
+  }
+
+  // Reprojection error statistics of each camera at the estimated poses
+  if (calib_stats_init(cam0_stats.reproj, cam0_obs, cam0, cam0_poses) != 0 ||
+      calib_stats_init(cam1_stats.reproj, cam1_obs, cam1, cam1_poses) != 0) {
+    LOG_ERROR("Failed to evaluate calibration statistics!");
+    return -1;
+  }
+  calib_verify_stats_t *stats[2] = {&cam0_stats, &cam1_stats};
+  for (auto cam_stats : stats) {
+    cam_stats->nb_frames = std::count(estimated.begin(), estimated.end(), 1);
+    cam_stats->pass = (cam_stats->reproj.nb_residuals > 0);
+    cam_stats->pass = cam_stats->pass && (cam_stats->reproj.rmse <= max_rmse);
+  }
+
+  return 0;
+}
+
+static int preprocess_verify_data(const calib_target_t &target,
+                                  const std::string &data_path,
+                                  const calib_params_t &cam,
+                                  const int cam_index) {
+  const auto cam_str = "cam" + std::to_string(cam_index);
+  const auto image_path = data_path + "/" + cam_str + "/data";
+  const auto grid_path = data_path + "/grid0/" + cam_str + "/data";
+  if (dir_exists(grid_path) == false) {
+    dir_create(grid_path);
+  }
+
+  // Detect AprilGrids with the stored intrinsics, solvepnp assumes radtan
+  const vec4_t proj_params = cam.proj_params.head(4);
+  vec4_t dist_params = zeros(4, 1);
+  if (cam.dist_model == "radtan4") {
+    dist_params = cam.dist_params.head(4);
+  }
+
+  return preprocess_camera_data(target,
+                                image_path,
+                                pinhole_K(proj_params),
+                                dist_params,
+                                grid_path,
+                                false,
+                                (cam_index == 0) ? true : false);
+}
+
+int calib_verify(const std::string &config_file) {
+  // Parse verification config
+  std::string data_path;
+  std::string results_fpath;
+  real_t max_rmse = 1.0;
+  config_t config{config_file};
+  parse(config, "settings.data_path", data_path);
+  parse(config, "settings.results_fpath", results_fpath);
+  parse(config, "settings.max_rmse", max_rmse, true);
+
+  // Load calibration target
+  calib_target_t calib_target;
+  if (calib_target_load(calib_target, config_file, "calib_target") != 0) {
+    LOG_ERROR("Failed to load calib target in [%s]!", config_file.c_str());
+    return -1;
+  }
+
+  // Load calibration to verify
+  const bool stereo = (yaml_has_key(results_fpath, "cam1") == 0 &&
+                       yaml_has_key(results_fpath, "T_C0C1") == 0);
+  calib_params_t cam0;
+  calib_params_t cam1;
+  mat4_t T_C0C1 = I(4);
+  if (calib_params_load(cam0, results_fpath, "cam0") != 0) {
+    LOG_ERROR("Failed to load cam0 in [%s]!", results_fpath.c_str());
+    return -1;
+  }
+  if (stereo) {
+    config_t results{results_fpath};
+    if (calib_params_load(cam1, results_fpath, "cam1") != 0 ||
+        parse(results, "T_C0C1", T_C0C1) != 0) {
+      LOG_ERROR("Failed to load cam1 in [%s]!", results_fpath.c_str());
+      return -1;
+    }
+  }
+
+  // Preprocess new capture
+  struct timespec t_start = tic();
+  const int nb_cams = (stereo) ? 2 : 1;
+  const calib_params_t *cams[2] = {&cam0, &cam1};
+  int retvals[2] = {0, 0};
+#pragma omp parallel for
+  for (int i = 0; i < nb_cams; i++) {
+    retvals[i] = preprocess_verify_data(calib_target, data_path, *cams[i], i);
+  }
+  if (retvals[0] != 0 || retvals[1] != 0) {
+    LOG_ERROR("Failed to preprocess verification data!");
+    return -1;
+  }
+
+  // Verify
+  calib_verify_stats_t cam0_stats;
+  calib_verify_stats_t cam1_stats;
+  const auto cam0_grid_path = data_path + "/grid0/cam0/data";
+  const auto cam1_grid_path = data_path + "/grid0/cam1/data";
+  if (stereo) {
+    aprilgrids_t cam0_grids;
+    aprilgrids_t cam1_grids;
+    if (load_stereo_calib_data(cam0_grid_path,
+                               cam1_grid_path,
+                               cam0_grids,
+                               cam1_grids) != 0) {
+      LOG_ERROR("Failed to load verification data!");
+      return -1;
+    }
+
+    LOG_INFO("Verifying stereo calibration [%s]!", results_fpath.c_str());
+    t_start = tic();
+    if (calib_verify_stereo(cam0_grids,
+                            cam1_grids,
+                            cam0,
+                            cam1,
+                            T_C0C1,
+                            max_rmse,
+                            cam0_stats,
+                            cam1_stats) != 0) {
+      LOG_ERROR("Failed to verify stereo calibration!");
+      return -1;
+    }
+
+  } else {
+    aprilgrids_t grids;
+    timestamps_t timestamps;
+    if (load_camera_calib_data(cam0_grid_path, grids, timestamps) != 0) {
+      LOG_ERROR("Failed to load verification data!");
+      return -1;
+    }
+
+    LOG_INFO("Verifying mono calibration [%s]!", results_fpath.c_str());
+    t_start = tic();
+    if (calib_verify_mono(grids, cam0, max_rmse, cam0_stats) != 0) {
+      LOG_ERROR("Failed to verify mono calibration!");
+      return -1;
+    }
+  }
+  const float verify_time = toc(&t_start);
+
+  // Show results
+  std::cout << "Verification results:" << std::endl;
+  const calib_verify_stats_t *stats[2] = {&cam0_stats, &cam1_stats};
+  for (int i = 0; i < nb_cams; i++) {
+    printf("cam%d:\n", i);
+    printf("nb_frames: %zu\n", stats[i]->nb_frames);
+    calib_stats_print(stats[i]->reproj);
+    if (stats[i]->pass) {
+      printf("\x1B[92mPASS\033[0m\n");
+    } else {
+      printf("\x1B[31mFAIL\033[0m\n");
+    }
+  }
+  printf("verification time [s]: %f\n", verify_time);
+
+  const bool pass = cam0_stats.pass && (stereo == false || cam1_stats.pass);
+  return (pass) ? 0 : 1;
+}
+
+} //  namespace yac
@@ -0,0 +1,89 @@
+#ifndef YAC_CALIB_VERIFY_HPP
+#define YAC_CALIB_VERIFY_HPP
+
+#include <iostream>
+#include <string>
+#include <memory>
+
+#include <ceres/ceres.h>
+
+#include "core.hpp"
+#include "calib_data.hpp"
+#include "calib_mono.hpp"
+#include "calib_stereo.hpp"
+
+namespace yac {
+
+/**
+ * Calibration verification statistics of a single camera
+ */
+struct calib_verify_stats_t {
+  size_t nb_frames = 0; ///< Frames whose pose was estimated
+  calib_stats_t reproj; ///< Reprojection errors at the estimated poses
+  bool pass = false;
+
+  calib_verify_stats_t() {}
+  ~calib_verify_stats_t() {}
+};
+
+/**
+ * Verify an existing mono camera calibration `cam` against new calibration
+ * data `aprilgrids`. The camera parameters are kept fixed and only the
+ * relative pose between camera and calibration target is estimated for each
+ * frame, the calibration passes if the reprojection RMSE is below `max_rmse`
+ * [px]. The reprojection errors are broken down per frame, per tag and per
+ * image region with `calib_stats_init()`, frames whose pose could not be
+ * estimated are evaluated at their detection pose.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_verify_mono(const aprilgrids_t &aprilgrids,
+                      const calib_params_t &cam,
+                      const real_t max_rmse,
+                      calib_verify_stats_t &stats);
+
+/**
+ * Verify an existing stereo camera calibration (`cam0`, `cam1` and `T_C0C1`)
+ * against new calibration data observed by both cameras. The camera
+ * parameters and extrinsics are kept fixed and only the relative pose between
+ * cam0 and calibration target is estimated for each frame, each camera passes
+ * if its reprojection RMSE is below `max_rmse` [px]. The statistics of each
+ * camera are evaluated as in `calib_verify_mono()`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_verify_stereo(const aprilgrids_t &cam0_aprilgrids,
+                        const aprilgrids_t &cam1_aprilgrids,
+                        const calib_params_t &cam0,
+                        const calib_params_t &cam1,
+                        const mat4_t &T_C0C1,
+                        const real_t max_rmse,
+                        calib_verify_stats_t &cam0_stats,
+                        calib_verify_stats_t &cam1_stats);
+
+/**
+ * Verify an existing calibration against a new capture. This function
+ * assumes that the path to `config_file` is a yaml file of the form:
+ *
+ *     settings:
+ *       data_path: "/data/new_capture"
+ *       results_fpath: "/data/calib_results.yaml"  # Calibration to verify
+ *       max_rmse: 1.0                              # Optional [px]
+ *
+ *     calib_target:
+ *       target_type: 'aprilgrid'  # Target type
+ *       tag_rows: 6               # Number of rows
+ *       tag_cols: 6               # Number of cols
+ *       tag_size: 0.088           # Size of apriltag, edge to edge [m]
+ *       tag_spacing: 0.3          # Ratio of space between tags to tagSize
+ *
+ * where `results_fpath` is a results file written by `calib_mono_solve()` or
+ * `calib_stereo_solve()`. If the results file contains `cam1` and `T_C0C1`
+ * the stereo calibration is verified, else only `cam0` is verified.
+ *
+ * @returns 0 if the calibration passes, 1 if it fails and -1 on error
+ */
+int calib_verify(const std::string &config_file);
+
+} //  namespace yac
+#endif // YAC_CALIB_VERIFY_HPP
@@ -0,0 +1,516 @@
+#include "calib_window.hpp"
+
+namespace yac {
+
+int calib_marginalize(ceres::Problem *problem,
+                      const std::vector<double *> &keep_blocks,
+                      const std::vector<double *> &marg_blocks,
+                      matx_t &H,
+                      vecx_t &b) {
+  // Evaluate residuals and jacobian w.r.t. kept then marginalized blocks
+  std::vector<double *> blocks = keep_blocks;
+  blocks.insert(blocks.end(), marg_blocks.begin(), marg_blocks.end());
+  ceres::Problem::EvaluateOptions eval_opts;
+  eval_opts.parameter_blocks = blocks;
+  std::vector<double> residuals;
+  ceres::CRSMatrix J_crs;
+  if (problem->Evaluate(eval_opts, NULL, &residuals, NULL, &J_crs) == false) {
+    LOG_ERROR("Failed to evaluate problem jacobian!");
+    return -1;
+  }
+
+  int keep_size = 0;
+  for (const auto block : keep_blocks) {
+    keep_size += problem->ParameterBlockLocalSize(block);
+  }
+  const int marg_size = J_crs.num_cols - keep_size;
+
+  // Form Gauss-Newton system
+  matx_t J = zeros(J_crs.num_rows, J_crs.num_cols);
+  for (int r = 0; r < J_crs.num_rows; r++) {
+    for (int i = J_crs.rows[r]; i < J_crs.rows[r + 1]; i++) {
+      J(r, J_crs.cols[i]) = J_crs.values[i];
+    }
+  }
+  const Eigen::Map<const vecx_t> e(residuals.data(), residuals.size());
+  const matx_t H_full = J.transpose() * J;
+  const vecx_t b_full = -J.transpose() * e;
+
+  // Schur complement, the marginalized block may be rank deficient (e.g. a
+  // frame that only observed a few corners) so use its pseudo inverse
+  const matx_t H_kk = H_full.topLeftCorner(keep_size, keep_size);
+  const matx_t H_km = H_full.topRightCorner(keep_size, marg_size);
+  const matx_t H_mm = H_full.bottomRightCorner(marg_size, marg_size);
+  const vecx_t b_k = b_full.head(keep_size);
+  const vecx_t b_m = b_full.tail(marg_size);
+
+  const Eigen::SelfAdjointEigenSolver<matx_t> eig(H_mm);
+  const vecx_t lambda = eig.eigenvalues();
+  const real_t lambda_min = 1e-12 * lambda.maxCoeff();
+  vecx_t lambda_inv = zeros(marg_size, 1);
+  for (int i = 0; i < marg_size; i++) {
+    lambda_inv(i) = (lambda(i) > lambda_min) ? 1.0 / lambda(i) : 0.0;
+  }
+  const matx_t V = eig.eigenvectors();
+  const matx_t H_mm_inv = V * lambda_inv.asDiagonal() * V.transpose();
+
+  H = H_kk - H_km * H_mm_inv * H_km.transpose();
+  b = b_k - H_km * H_mm_inv * b_m;
+
+  return 0;
+}
+
+void calib_prior_diff(const std::vector<bool> &quaternions,
+                      double const *const *params,
+                      const std::vector<vecx_t> &x0,
+                      vecx_t &dx,
+                      matxs_t *J) {
+  // Tangent space size
+  int size = 0;
+  for (size_t k = 0; k < x0.size(); k++) {
+    size += (quaternions[k]) ? 3 : x0[k].size();
+  }
+  dx.resize(size);
+  if (J) {
+    J->clear();
+  }
+
+  int idx = 0;
+  for (size_t k = 0; k < x0.size(); k++) {
+    if (quaternions[k] == false) {
+      const int n = x0[k].size();
+      dx.segment(idx, n) = Eigen::Map<const vecx_t>(params[k], n) - x0[k];
+      if (J) {
+        J->push_back(I(n));
+      }
+      idx += n;
+      continue;
+    }
+
+    // Quaternion: ceres::EigenQuaternionParameterization perturbs on the
+    // left, q = Exp(dq) * q0, so dx is the vector part of q * q0^-1
+    const quat_t q{params[k][3], params[k][0], params[k][1], params[k][2]};
+    const quat_t q0{x0[k](3), x0[k](0), x0[k](1), x0[k](2)};
+    const quat_t p = q0.inverse();
+    const quat_t dq = q * p;
+    const real_t sign = (dq.w() < 0.0) ? -1.0 : 1.0;
+    dx.segment<3>(idx) = sign * dq.vec();
+    if (J) {
+      matx_t J_q = zeros(3, 4);
+      J_q.block(0, 0, 3, 3) = p.w() * I(3) - skew(p.vec());
+      J_q.block(0, 3, 3, 1) = p.vec();
+      J->push_back(sign * J_q);
+    }
+    idx += 3;
+  }
+}
+
+calib_prior_residual_t::calib_prior_residual_t(
+    const std::vector<bool> &quaternions,
+    const std::vector<vecx_t> &x0,
+    const matx_t &H,
+    const vecx_t &b,
+    const std::vector<int> &block_sizes)
+    : quaternions_{quaternions}, x0_{x0} {
+  // Square root of information matrix, S^T S = H, over its range only
+  const Eigen::SelfAdjointEigenSolver<matx_t> eig(H);
+  const vecx_t lambda = eig.eigenvalues();
+  const matx_t V = eig.eigenvectors();
+  const real_t lambda_min = 1e-12 * lambda.maxCoeff();
+
+  std::vector<int> range;
+  for (int i = 0; i < lambda.size(); i++) {
+    if (lambda(i) > lambda_min) {
+      range.push_back(i);
+    }
+  }
+  S_.resize(range.size(), H.cols());
+  t_.resize(range.size());
+  for (size_t i = 0; i < range.size(); i++) {
+    const real_t l = lambda(range[i]);
+    const vecx_t v = V.col(range[i]);
+    S_.row(i) = sqrt(l) * v.transpose();
+    t_(i) = v.dot(b) / sqrt(l);
+  }
+
+  // Residual and parameter block sizes
+  set_num_residuals(range.size());
+  for (size_t k = 0; k < x0_.size(); k++) {
+    const int size = (block_sizes.size()) ? block_sizes[k] : x0_[k].size();
+    mutable_parameter_block_sizes()->push_back(size);
+  }
+}
+
+bool calib_prior_residual_t::Evaluate(double const *const *params,
+                                      double *residuals,
+                                      double **jacobians) const {
+  vecx_t dx;
+  matxs_t J_dx;
+  calib_prior_diff(quaternions_, params, x0_, dx, &J_dx);
+
+  Eigen::Map<vecx_t> r(residuals, num_residuals());
+  r = S_ * dx - t_;
+
+  if (jacobians == NULL) {
+    return true;
+  }
+
+  int idx = 0;
+  for (size_t k = 0; k < x0_.size(); k++) {
+    // Entries beyond x0 are held constant and have zero Jacobian
+    const int local_size = J_dx[k].rows();
+    const int global_size = parameter_block_sizes()[k];
+    if (jacobians[k]) {
+      typedef Eigen::Matrix<real_t, Eigen::Dynamic, Eigen::Dynamic,
+                            Eigen::RowMajor> row_major_matx_t;
+      Eigen::Map<row_major_matx_t> J(jacobians[k],
+                                     num_residuals(),
+                                     global_size);
+      J.setZero();
+      J.leftCols(J_dx[k].cols()) = S_.middleCols(idx, local_size) * J_dx[k];
+    }
+    idx += local_size;
+  }
+
+  return true;
+}
+
+/**
+ * Parameter blocks kept in the marginalization prior, i.e. the camera
+ * parameters and for stereo also the extrinsics.
+ */
+static void window_keep_blocks(calib_window_t &window,
+                               std::vector<double *> &blocks,
+                               std::vector<int> &sizes,
+                               std::vector<bool> &quaternions,
+                               std::vector<vecx_t> &values) {
+  blocks.clear();
+  sizes.clear();
+  quaternions.clear();
+  values.clear();
+
+  // Only the `nb_free` leading values of a block are kept, the distortion
+  // parameters unused by the camera model are held constant
+  const auto add_block = [&](double *block,
+                             const int size,
+                             const int nb_free,
+                             const bool quat) {
+    blocks.push_back(block);
+    sizes.push_back(size);
+    quaternions.push_back(quat);
+    values.push_back(Eigen::Map<vecx_t>(block, nb_free));
+  };
+
+  calib_params_t &cam0 = window.cam0;
+  calib_params_t &cam1 = window.cam1;
+  const int proj_size = cam0.proj_params.size();
+  const int dist_size = cam0.dist_params.size();
+  const int cam0_dist_free = camera_dist_params_size(window.cam0_model);
+  const int cam1_dist_free = camera_dist_params_size(window.cam1_model);
+  add_block(cam0.proj_params.data(), proj_size, proj_size, false);
+  add_block(cam0.dist_params.data(), dist_size, cam0_dist_free, false);
+  if (window.stereo) {
+    add_block(cam1.proj_params.data(), proj_size, proj_size, false);
+    add_block(cam1.dist_params.data(), dist_size, cam1_dist_free, false);
+    add_block(window.T_C1C0.q, 4, 4, true);
+    add_block(window.T_C1C0.r, 3, 3, false);
+  }
+}
+
+static void window_setup_problem(calib_window_t &window,
+                                 ceres::LocalParameterization *quat_param,
+                                 ceres::Problem *problem) {
+  std::vector<double *> blocks;
+  std::vector<int> sizes;
+  std::vector<bool> quaternions;
+  std::vector<vecx_t> values;
+  window_keep_blocks(window, blocks, sizes, quaternions, values);
+  for (size_t k = 0; k < blocks.size(); k++) {
+    if (quaternions[k]) {
+      problem->AddParameterBlock(blocks[k], 4, quat_param);
+    } else {
+      problem->AddParameterBlock(blocks[k], sizes[k]);
+    }
+  }
+
+  calib_dist_params_setup(problem,
+                          window.cam0_model,
+                          window.cam0.dist_params.data());
+  if (window.stereo) {
+    calib_dist_params_setup(problem,
+                            window.cam1_model,
+                            window.cam1.dist_params.data());
+  }
+}
+
+static int window_add_frame(calib_window_t &window,
+                            const size_t k,
+                            ceres::LocalParameterization *quat_param,
+                            ceres::Problem *problem) {
+  const aprilgrid_t &cam0_grid = window.cam0_grids[k];
+  const aprilgrid_t &cam1_grid = window.cam1_grids[k];
+  calib_pose_t *T_C0F = &window.T_C0F[k];
+
+  if (window.stereo) {
+    if (calib_stereo_add_frame(cam0_grid,
+                               cam1_grid,
+                               &window.object_points,
+                               window.cam0,
+                               window.cam1,
+                               &window.T_C1C0,
+                               T_C0F,
+                               problem) != 0) {
+      return -1;
+    }
+  } else {
+    for (size_t i = 0; i < cam0_grid.ids.size(); i++) {
+      const int tag_id = cam0_grid.ids[i];
+      if ((size_t) (tag_id * 4 + 3) >= window.object_points.size()) {
+        LOG_ERROR("Incorrect tag id [%d]!", tag_id);
+        return -1;
+      }
+
+      for (size_t j = 0; j < 4; j++) {
+        const auto residual =
+            new calib_mono_residual_t{window.cam0.proj_model,
+                                      window.cam0.dist_model,
+                                      cam0_grid.keypoints[i * 4 + j],
+                                      window.object_points[tag_id * 4 + j]};
+        const auto cost_func =
+            new ceres::AutoDiffCostFunction<calib_mono_residual_t,
+                                            2, // Size of: residual
+                                            4, // Size of: intrinsics
+                                            4, // Size of: distortion
+                                            4, // Size of: q_CF
+                                            3  // Size of: r_CF
+                                            >(residual);
+        problem->AddResidualBlock(cost_func, // Cost function
+                                  NULL,      // Loss function
+                                  window.cam0.proj_params.data(),
+                                  window.cam0.dist_params.data(),
+                                  T_C0F->q,
+                                  T_C0F->r);
+      }
+    }
+  }
+  problem->SetParameterization(T_C0F->q, quat_param);
+
+  return 0;
+}
+
+static int window_marginalize(calib_window_t &window) {
+  // Problem with the residuals of the oldest frame only
+  ceres::Problem::Options problem_opts;
+  problem_opts.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem{problem_opts};
+  ceres::EigenQuaternionParameterization quat_param;
+  window_setup_problem(window, &quat_param, &problem);
+  if (window_add_frame(window, 0, &quat_param, &problem) != 0) {
+    LOG_ERROR("Failed to add frame to problem!");
+    return -1;
+  }
+
+  // Marginalize frame pose
+  std::vector<double *> keep_blocks;
+  std::vector<int> sizes;
+  std::vector<bool> quaternions;
+  std::vector<vecx_t> x;
+  window_keep_blocks(window, keep_blocks, sizes, quaternions, x);
+  const std::vector<double *> marg_blocks = {window.T_C0F[0].q,
+                                             window.T_C0F[0].r};
+  matx_t H;
+  vecx_t b;
+  if (calib_marginalize(&problem, keep_blocks, marg_blocks, H, b) != 0) {
+    LOG_ERROR("Failed to marginalize frame!");
+    return -1;
+  }
+
+  // Combine with existing prior, relinearized at the current estimate
+  if (window.prior_ok) {
+    vecx_t dx;
+    calib_prior_diff(quaternions, keep_blocks.data(), window.prior_x0, dx);
+    H += window.prior_H;
+    b += window.prior_b - window.prior_H * dx;
+  }
+  window.prior_ok = true;
+  window.prior_x0 = x;
+  window.prior_H = H;
+  window.prior_b = b;
+
+  // Remove frame from window
+  window.cam0_grids.pop_front();
+  window.cam1_grids.pop_front();
+  window.T_C0F.pop_front();
+  window.nb_marginalized++;
+
+  return 0;
+}
+
+static int window_solve(calib_window_t &window) {
+  struct timespec t_start = tic();
+
+  // Setup problem with frames in window
+  ceres::Problem::Options problem_opts;
+  problem_opts.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem{problem_opts};
+  ceres::EigenQuaternionParameterization quat_param;
+  window_setup_problem(window, &quat_param, &problem);
+  for (size_t k = 0; k < window.T_C0F.size(); k++) {
+    if (window_add_frame(window, k, &quat_param, &problem) != 0) {
+      LOG_ERROR("Failed to add frame to problem!");
+      return -1;
+    }
+  }
+  const size_t nb_corners = problem.NumResiduals() / 2;
+
+  // Marginalization prior
+  if (window.prior_ok) {
+    std::vector<double *> blocks;
+    std::vector<int> sizes;
+    std::vector<bool> quaternions;
+    std::vector<vecx_t> values;
+    window_keep_blocks(window, blocks, sizes, quaternions, values);
+    const auto prior = new calib_prior_residual_t{quaternions,
+                                                  window.prior_x0,
+                                                  window.prior_H,
+                                                  window.prior_b,
+                                                  sizes};
+    problem.AddResidualBlock(prior, NULL, blocks);
+  }
+
+  // Solve
+  ceres::Solver::Options options;
+  calib_solver_callbacks_t callbacks;
+  calib_solver_setup(window.opts,
+                     nb_corners,
+                     t_start,
+                     options,
+                     callbacks,
+                     &problem,
+                     "window");
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+  if (window.opts.verbose) {
+    std::cout << summary.BriefReport() << std::endl;
+  }
+  calib_solver_report(window.opts, "window", nb_corners, summary);
+
+  return 0;
+}
+
+static int window_update(calib_window_t &window,
+                         const aprilgrid_t &cam0_grid,
+                         const aprilgrid_t &cam1_grid,
+                         const mat4_t &T_C0F) {
+  // Object point table, shared by all residuals
+  if (window.object_points.size() == 0) {
+    const aprilgrid_t &grid = (cam0_grid.ids.size()) ? cam0_grid : cam1_grid;
+    if (aprilgrid_object_points(grid, window.object_points) != 0) {
+      LOG_ERROR("Failed to calculate AprilGrid object points!");
+      return -1;
+    }
+  }
+
+  // Add frame to window
+  window.cam0_grids.push_back(cam0_grid);
+  window.cam1_grids.push_back(cam1_grid);
+  window.T_C0F.emplace_back(T_C0F);
+  window.nb_frames++;
+
+  // Marginalize oldest frame if window is full
+  if (window.T_C0F.size() > window.window_size) {
+    if (window_marginalize(window) != 0) {
+      return -1;
+    }
+  }
+
+  return window_solve(window);
+}
+
+int calib_window_init(calib_window_t &window,
+                      const calib_params_t &cam0,
+                      const size_t window_size,
+                      const calib_solver_options_t &opts) {
+  if (window_size == 0) {
+    LOG_ERROR("Window size must be larger than 0!");
+    return -1;
+  }
+  camera_model_t model;
+  if (calib_camera_model(cam0, model) != 0) {
+    LOG_ERROR("Unsupported [%s-%s] projection distortion combination!",
+              cam0.proj_model.c_str(), cam0.dist_model.c_str());
+    return -1;
+  }
+
+  window = calib_window_t{};
+  window.window_size = window_size;
+  window.opts = opts;
+  window.stereo = false;
+  window.cam0 = cam0;
+  window.cam0_model = model;
+
+  return 0;
+}
+
+int calib_window_init(calib_window_t &window,
+                      const calib_params_t &cam0,
+                      const calib_params_t &cam1,
+                      const mat4_t &T_C0C1,
+                      const size_t window_size,
+                      const calib_solver_options_t &opts) {
+  if (calib_window_init(window, cam0, window_size, opts) != 0) {
+    return -1;
+  }
+  camera_model_t model;
+  if (calib_camera_model(cam1, model) != 0) {
+    LOG_ERROR("Unsupported [%s-%s] projection distortion combination!",
+              cam1.proj_model.c_str(), cam1.dist_model.c_str());
+    return -1;
+  }
+
+  window.stereo = true;
+  window.cam1 = cam1;
+  window.cam1_model = model;
+  window.T_C1C0 = calib_pose_t{T_C0C1.inverse()};
+
+  return 0;
+}
+
+int calib_window_add(calib_window_t &window, const aprilgrid_t &grid) {
+  if (window.stereo) {
+    LOG_ERROR("Stereo window expects AprilGrids from both cameras!");
+    return -1;
+  }
+  if (grid.ids.size() == 0) {
+    return 0;
+  }
+
+  return window_update(window, grid, aprilgrid_t{}, grid.T_CF);
+}
+
+int calib_window_add(calib_window_t &window,
+                     const aprilgrid_t &cam0_grid,
+                     const aprilgrid_t &cam1_grid) {
+  if (window.stereo == false) {
+    LOG_ERROR("Mono window expects AprilGrids from one camera!");
+    return -1;
+  }
+  if (cam0_grid.ids.size() == 0 && cam1_grid.ids.size() == 0) {
+    return 0;
+  }
+
+  // Initialize frame pose from cam0, or cam1 if cam0 did not see the target
+  mat4_t T_C0F = cam0_grid.T_CF;
+  if (cam0_grid.ids.size() == 0) {
+    T_C0F = calib_window_extrinsics(window) * cam1_grid.T_CF;
+  }
+
+  return window_update(window, cam0_grid, cam1_grid, T_C0F);
+}
+
+mat4_t calib_window_extrinsics(const calib_window_t &window) {
+  calib_pose_t T_C1C0 = window.T_C1C0;
+  return T_C1C0.T().inverse();
+}
+
+} //  namespace yac
@@ -0,0 +1,167 @@
+#ifndef YAC_CALIB_WINDOW_HPP
+#define YAC_CALIB_WINDOW_HPP
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <deque>
+
+#include <ceres/ceres.h>
+
+#include "core.hpp"
+#include "calib_data.hpp"
+#include "calib_solver.hpp"
+#include "calib_mono.hpp"
+#include "calib_stereo.hpp"
+
+namespace yac {
+
+/**
+ * Marginalize `marg_blocks` out of all residuals in `problem` by taking the
+ * Schur complement of the Gauss-Newton system linearized at the current
+ * parameter values. The resulting information `H` and vector `b` are over
+ * `keep_blocks` in their tangent space and in order, such that the
+ * Gauss-Newton step of the kept parameters is `H^-1 b`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_marginalize(ceres::Problem *problem,
+                      const std::vector<double *> &keep_blocks,
+                      const std::vector<double *> &marg_blocks,
+                      matx_t &H,
+                      vecx_t &b);
+
+/**
+ * Marginalization prior residual. Represents the quadratic cost
+ *
+ *     0.5 * dx^T H dx - b^T dx
+ *
+ * where `dx` is the difference between the parameters and the linearization
+ * point `x0` in the tangent space. Parameter blocks flagged in `quaternions`
+ * are quaternions (x, y, z, w) with `ceres::EigenQuaternionParameterization`,
+ * all others are vectors. A vector block may be larger than its `x0`, as
+ * given by `block_sizes`, if its trailing entries are held constant (see
+ * `calib_dist_params_setup()`). The cost is written as a residual
+ * `r = S dx - t` with `S^T S = H`, dropping directions of `H` that carry no
+ * information.
+ */
+struct calib_prior_residual_t : ceres::CostFunction {
+  std::vector<bool> quaternions_;
+  std::vector<vecx_t> x0_;
+  matx_t S_;
+  vecx_t t_;
+
+  calib_prior_residual_t(const std::vector<bool> &quaternions,
+                         const std::vector<vecx_t> &x0,
+                         const matx_t &H,
+                         const vecx_t &b,
+                         const std::vector<int> &block_sizes = {});
+  ~calib_prior_residual_t() {}
+
+  bool Evaluate(double const *const *params,
+                double *residuals,
+                double **jacobians) const;
+};
+
+/**
+ * Difference `dx` between parameter blocks `params` and `x0` in the tangent
+ * space, see `calib_prior_residual_t`. Where `J` are the Jacobians of `dx`
+ * w.r.t. each parameter block, if not NULL.
+ */
+void calib_prior_diff(const std::vector<bool> &quaternions,
+                      double const *const *params,
+                      const std::vector<vecx_t> &x0,
+                      vecx_t &dx,
+                      matxs_t *J = nullptr);
+
+/**
+ * Sliding window calibrator. Only the latest `window_size` frames are kept in
+ * the optimization problem, older frames are marginalized into a prior on the
+ * camera parameters (and stereo extrinsics) so the cost of each update does
+ * not grow with the number of frames seen.
+ */
+struct calib_window_t {
+  size_t window_size = 10;
+  calib_solver_options_t opts;
+  bool stereo = false;
+
+  // Calibration parameters
+  calib_params_t cam0;
+  calib_params_t cam1;
+  camera_model_t cam0_model = PINHOLE_RADTAN4;
+  camera_model_t cam1_model = PINHOLE_RADTAN4;
+  calib_pose_t T_C1C0{I(4)};
+  vec3s_t object_points;
+
+  // Frames in window
+  std::deque<aprilgrid_t> cam0_grids;
+  std::deque<aprilgrid_t> cam1_grids;
+  std::deque<calib_pose_t> T_C0F;
+
+  // Marginalization prior, linearized at x0
+  bool prior_ok = false;
+  std::vector<vecx_t> prior_x0;
+  matx_t prior_H;
+  vecx_t prior_b;
+
+  // Stats
+  size_t nb_frames = 0;      ///< Number of frames added
+  size_t nb_marginalized = 0; ///< Number of frames marginalized
+
+  calib_window_t() {}
+  ~calib_window_t() {}
+};
+
+/**
+ * Initialize mono sliding window calibrator with initial camera parameters
+ * `cam0`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_window_init(calib_window_t &window,
+                      const calib_params_t &cam0,
+                      const size_t window_size = 10,
+                      const calib_solver_options_t &opts =
+                          calib_solver_options_t());
+
+/**
+ * Initialize stereo sliding window calibrator with initial camera parameters
+ * `cam0`, `cam1` and extrinsics `T_C0C1`.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_window_init(calib_window_t &window,
+                      const calib_params_t &cam0,
+                      const calib_params_t &cam1,
+                      const mat4_t &T_C0C1,
+                      const size_t window_size = 10,
+                      const calib_solver_options_t &opts =
+                          calib_solver_options_t());
+
+/**
+ * Add a new mono frame `grid` to the window, marginalize the oldest frame if
+ * the window is full and re-solve. The AprilGrid relative pose `T_CF` is used
+ * to initialize the frame pose.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_window_add(calib_window_t &window, const aprilgrid_t &grid);
+
+/**
+ * Add a new stereo frame `cam0_grid` and `cam1_grid` to the window,
+ * marginalize the oldest frame if the window is full and re-solve. Either
+ * AprilGrid may be empty.
+ *
+ * @returns 0 or -1 for success or failure
+ */
+int calib_window_add(calib_window_t &window,
+                     const aprilgrid_t &cam0_grid,
+                     const aprilgrid_t &cam1_grid);
+
+/**
+ * Get stereo extrinsics T_C0C1 of sliding window calibrator.
+ */
+mat4_t calib_window_extrinsics(const calib_window_t &window);
+
+} //  namespace yac
+#endif // YAC_CALIB_WINDOW_HPP
@@ -3324,4 +3324,383 @@ mat3_t pinhole_K(const int img_w,
   return K;
 }
 
+int double_sphere_unproject(const real_t *params,
+                            const vec2_t &z,
+                            vec3_t &bearing) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const real_t xi = params[4];
+  const real_t alpha = params[5];
+
+  // Check image point is in the valid unprojection region
+  const real_t mx = (z(0) - cx) / fx;
+  const real_t my = (z(1) - cy) / fy;
+  const real_t r2 = mx * mx + my * my;
+  const real_t s = 1.0 - (2.0 * alpha - 1.0) * r2;
+  if (s < 0.0) {
+    return -1;
+  }
+
+  // Unproject
+  const real_t mz =
+      (1.0 - alpha * alpha * r2) / (alpha * sqrt(s) + 1.0 - alpha);
+  const real_t t = mz * mz + (1.0 - xi * xi) * r2;
+  if (t < 0.0) {
+    return -1;
+  }
+  const real_t k = (mz * xi + sqrt(t)) / (mz * mz + r2);
+  bearing = vec3_t{k * mx, k * my, k * mz - xi}.normalized();
+
+  return 0;
+}
+
+TARGET_CLONES_AVX2
+void pinhole_radtan4_project_batch(const real_t *params,
+                                   const size_t n,
+                                   const real_t *x,
+                                   const real_t *y,
+                                   const real_t *z,
+                                   real_t *u,
+                                   real_t *v,
+                                   uint8_t *valid) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const radtan4_t radtan4{params + 4};
+
+#pragma omp simd
+  for (size_t i = 0; i < n; i++) {
+    // Points behind or too close to the camera are masked out
+    const bool ok = (z[i] >= 1.0e-12);
+    const real_t z_inv = 1.0 / (ok ? z[i] : 1.0);
+
+    // Project and apply radial and tangential distortion
+    real_t x_dist = 0.0;
+    real_t y_dist = 0.0;
+    radtan4.distort(x[i] * z_inv, y[i] * z_inv, x_dist, y_dist);
+
+    // Scale and center
+    u[i] = ok ? fx * x_dist + cx : 0.0;
+    v[i] = ok ? fy * y_dist + cy : 0.0;
+    valid[i] = ok;
+  }
+}
+
+TARGET_CLONES_AVX2
+void pinhole_equi4_project_batch(const real_t *params,
+                                 const size_t n,
+                                 const real_t *x,
+                                 const real_t *y,
+                                 const real_t *z,
+                                 real_t *u,
+                                 real_t *v,
+                                 uint8_t *valid) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const real_t k1 = params[4];
+  const real_t k2 = params[5];
+  const real_t k3 = params[6];
+  const real_t k4 = params[7];
+
+  // Project in blocks, the atan pass is scalar while the others vectorize
+  const size_t block_size = 256;
+  real_t th[block_size];
+  for (size_t i0 = 0; i0 < n; i0 += block_size) {
+    const size_t m = std::min(block_size, n - i0);
+
+#pragma omp simd
+    for (size_t j = 0; j < m; j++) {
+      const size_t i = i0 + j;
+      const real_t z_inv = 1.0 / ((z[i] >= 1.0e-12) ? z[i] : 1.0);
+      const real_t px = x[i] * z_inv;
+      const real_t py = y[i] * z_inv;
+      th[j] = sqrt(px * px + py * py);
+    }
+
+    for (size_t j = 0; j < m; j++) {
+      th[j] = atan(th[j]);
+    }
+
+#pragma omp simd
+    for (size_t j = 0; j < m; j++) {
+      // Project, points behind the camera or on the optical axis are masked
+      const size_t i = i0 + j;
+      const bool z_ok = (z[i] >= 1.0e-12);
+      const real_t z_inv = 1.0 / (z_ok ? z[i] : 1.0);
+      const real_t px = x[i] * z_inv;
+      const real_t py = y[i] * z_inv;
+      const real_t r = sqrt(px * px + py * py);
+      const bool ok = z_ok && (r >= 1e-8);
+      const real_t r_safe = ok ? r : 1.0;
+
+      // Apply equi distortion
+      const real_t th2 = th[j] * th[j];
+      const real_t th4 = th2 * th2;
+      const real_t th6 = th4 * th2;
+      const real_t th8 = th4 * th4;
+      const real_t poly = 1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8;
+      const real_t s = th[j] * poly / r_safe;
+
+      // Scale and center
+      u[i] = ok ? fx * s * px + cx : 0.0;
+      v[i] = ok ? fy * s * py + cy : 0.0;
+      valid[i] = ok;
+    }
+  }
+}
+
+TARGET_CLONES_AVX2
+size_t pinhole_radtan4_undistort_batch(const real_t *params,
+                                       const size_t n,
+                                       const real_t *u,
+                                       const real_t *v,
+                                       real_t *x,
+                                       real_t *y,
+                                       uint8_t *converged,
+                                       const int max_iter) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const radtan4_t radtan4{params + 4};
+
+  // Undistort in blocks with the Newton iterations outermost, so the loops
+  // over the points vectorize. The iterates are kept in `x` and `y`.
+  const size_t block_size = 256;
+  real_t xd[block_size];
+  real_t yd[block_size];
+  size_t nb_converged = 0;
+  for (size_t i0 = 0; i0 < n; i0 += block_size) {
+    const size_t m = std::min(block_size, n - i0);
+    real_t *px = x + i0;
+    real_t *py = y + i0;
+
+    // Distorted normalized point, also the initial guess
+#pragma omp simd
+    for (size_t j = 0; j < m; j++) {
+      xd[j] = (u[i0 + j] - cx) / fx;
+      yd[j] = (v[i0 + j] - cy) / fy;
+      px[j] = xd[j];
+      py[j] = yd[j];
+    }
+
+    for (int k = 0; k < max_iter; k++) {
+#pragma omp simd
+      for (size_t j = 0; j < m; j++) {
+        // Error
+        real_t dx = 0.0;
+        real_t dy = 0.0;
+        radtan4.distort(px[j], py[j], dx, dy);
+        const real_t ex = xd[j] - dx;
+        const real_t ey = yd[j] - dy;
+
+        // Jacobian
+        real_t J00 = 0.0;
+        real_t J01 = 0.0;
+        real_t J10 = 0.0;
+        real_t J11 = 0.0;
+        radtan4.J_point(px[j], py[j], J00, J01, J10, J11);
+
+        // Newton step, skipped if the Jacobian is singular
+        const real_t det = J00 * J11 - J01 * J10;
+        const bool ok = (fabs(det) > 1e-12);
+        const real_t det_inv = 1.0 / (ok ? det : 1.0);
+        px[j] += ok ? (J11 * ex - J01 * ey) * det_inv : 0.0;
+        py[j] += ok ? (J00 * ey - J10 * ex) * det_inv : 0.0;
+      }
+    }
+
+    // Final error
+#pragma omp simd reduction(+ : nb_converged)
+    for (size_t j = 0; j < m; j++) {
+      real_t dx = 0.0;
+      real_t dy = 0.0;
+      radtan4.distort(px[j], py[j], dx, dy);
+      const real_t ex = xd[j] - dx;
+      const real_t ey = yd[j] - dy;
+      const bool ok = (ex * ex + ey * ey < 1e-15);
+      converged[i0 + j] = ok;
+      nb_converged += ok;
+    }
+  }
+
+  return nb_converged;
+}
+
+TARGET_CLONES_AVX2
+size_t pinhole_equi4_undistort_batch(const real_t *params,
+                                     const size_t n,
+                                     const real_t *u,
+                                     const real_t *v,
+                                     real_t *x,
+                                     real_t *y,
+                                     uint8_t *converged,
+                                     const int max_iter) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const real_t k1 = params[4];
+  const real_t k2 = params[5];
+  const real_t k3 = params[6];
+  const real_t k4 = params[7];
+
+  // Undistort in blocks with the Newton iterations outermost, so the loops
+  // over the points vectorize, see pinhole_radtan4_undistort_batch(). Only
+  // the tan pass is scalar.
+  const size_t block_size = 256;
+  real_t thd[block_size];
+  real_t th[block_size];
+  real_t tan_th[block_size];
+  size_t nb_converged = 0;
+  for (size_t i0 = 0; i0 < n; i0 += block_size) {
+    const size_t m = std::min(block_size, n - i0);
+
+    // Distorted incidence angle, also the initial guess
+#pragma omp simd
+    for (size_t j = 0; j < m; j++) {
+      const real_t xd = (u[i0 + j] - cx) / fx;
+      const real_t yd = (v[i0 + j] - cy) / fy;
+      thd[j] = sqrt(xd * xd + yd * yd);
+      th[j] = thd[j];
+    }
+
+    // Solve thd = th * (1 + k1 * th^2 + k2 * th^4 + k3 * th^6 + k4 * th^8)
+    for (int k = 0; k < max_iter; k++) {
+#pragma omp simd
+      for (size_t j = 0; j < m; j++) {
+        const real_t th2 = th[j] * th[j];
+        const real_t th4 = th2 * th2;
+        const real_t th6 = th4 * th2;
+        const real_t th8 = th4 * th4;
+        const real_t poly = 1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8;
+        const real_t e = thd[j] - th[j] * poly;
+
+        // Newton step, skipped if the derivative vanishes
+        real_t f_th = 1.0 + 3.0 * k1 * th2 + 5.0 * k2 * th4;
+        f_th += 7.0 * k3 * th6 + 9.0 * k4 * th8;
+        const bool ok = (fabs(f_th) > 1e-12);
+        th[j] += ok ? e / (ok ? f_th : 1.0) : 0.0;
+      }
+    }
+
+    // Final error
+#pragma omp simd
+    for (size_t j = 0; j < m; j++) {
+      const real_t th2 = th[j] * th[j];
+      const real_t th4 = th2 * th2;
+      const real_t th6 = th4 * th2;
+      const real_t th8 = th4 * th4;
+      const real_t poly = 1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8;
+      const real_t e = thd[j] - th[j] * poly;
+      const bool th_ok = (th[j] >= 0.0) && (th[j] < M_PI / 2.0);
+      tan_th[j] = th_ok ? th[j] : 0.0;
+      converged[i0 + j] = th_ok && (e * e < 1e-15);
+    }
+
+    for (size_t j = 0; j < m; j++) {
+      tan_th[j] = tan(tan_th[j]);
+    }
+
+#pragma omp simd reduction(+ : nb_converged)
+    for (size_t j = 0; j < m; j++) {
+      // Points on the optical axis are not scaled
+      const size_t i = i0 + j;
+      const real_t xd = (u[i] - cx) / fx;
+      const real_t yd = (v[i] - cy) / fy;
+      const bool r_ok = (thd[j] > 1e-8);
+      const real_t scale = r_ok ? tan_th[j] / (r_ok ? thd[j] : 1.0) : 1.0;
+
+      x[i] = xd * scale;
+      y[i] = yd * scale;
+      nb_converged += converged[i];
+    }
+  }
+
+  return nb_converged;
+}
+
+TARGET_CLONES_AVX2
+void double_sphere_project_batch(const real_t *params,
+                                 const size_t n,
+                                 const real_t *x,
+                                 const real_t *y,
+                                 const real_t *z,
+                                 real_t *u,
+                                 real_t *v,
+                                 uint8_t *valid) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const real_t xi = params[4];
+  const real_t alpha = params[5];
+  const real_t w1 = (alpha <= 0.5) ? alpha / (1.0 - alpha)
+                                   : (1.0 - alpha) / alpha;
+  const real_t w2 = (w1 + xi) / sqrt(2.0 * w1 * xi + xi * xi + 1.0);
+
+#pragma omp simd
+  for (size_t i = 0; i < n; i++) {
+    // Project, points outside the valid projection region are masked out
+    const real_t r2 = x[i] * x[i] + y[i] * y[i];
+    const real_t d1 = sqrt(r2 + z[i] * z[i]);
+    const real_t zz = xi * d1 + z[i];
+    const real_t d2 = sqrt(r2 + zz * zz);
+    const real_t denom = alpha * d2 + (1.0 - alpha) * zz;
+    const bool ok = (z[i] > -w2 * d1) && (denom >= 1.0e-12);
+    const real_t denom_inv = 1.0 / (ok ? denom : 1.0);
+
+    // Scale and center
+    u[i] = ok ? fx * x[i] * denom_inv + cx : 0.0;
+    v[i] = ok ? fy * y[i] * denom_inv + cy : 0.0;
+    valid[i] = ok;
+  }
+}
+
+TARGET_CLONES_AVX2
+size_t double_sphere_undistort_batch(const real_t *params,
+                                     const size_t n,
+                                     const real_t *u,
+                                     const real_t *v,
+                                     real_t *x,
+                                     real_t *y,
+                                     uint8_t *converged) {
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const real_t xi = params[4];
+  const real_t alpha = params[5];
+
+  size_t nb_converged = 0;
+#pragma omp simd reduction(+ : nb_converged)
+  for (size_t i = 0; i < n; i++) {
+    // Unproject, see double_sphere_unproject()
+    const real_t mx = (u[i] - cx) / fx;
+    const real_t my = (v[i] - cy) / fy;
+    const real_t r2 = mx * mx + my * my;
+    const real_t s = 1.0 - (2.0 * alpha - 1.0) * r2;
+    const real_t mz = (1.0 - alpha * alpha * r2) /
+                      (alpha * sqrt(s >= 0.0 ? s : 0.0) + 1.0 - alpha);
+    const real_t t = mz * mz + (1.0 - xi * xi) * r2;
+    const real_t k = (mz * xi + sqrt(t >= 0.0 ? t : 0.0)) / (mz * mz + r2);
+    const real_t bz = k * mz - xi;
+
+    // Normalize onto the z = 1 plane, points behind the camera are masked out
+    const bool ok = (s >= 0.0) && (t >= 0.0) && (bz > 1.0e-12);
+    const real_t bz_inv = 1.0 / (ok ? bz : 1.0);
+    x[i] = ok ? k * mx * bz_inv : 0.0;
+    y[i] = ok ? k * my * bz_inv : 0.0;
+    converged[i] = ok;
+    nb_converged += ok;
+  }
+
+  return nb_converged;
+}
+
 } // namespace yac
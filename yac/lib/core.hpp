@@ -189,6 +189,18 @@ typedef std::vector<timestamp_t> timestamps_t;
 
 #endif // ENABLE_MACROS ------------------------------------------------------
 
+/**
+ * Compile a function for AVX2 as well as for the baseline x86-64 ISA, the
+ * version matching the CPU is selected at load time. Used on the batch camera
+ * kernels so their `#pragma omp simd` loops run 4 doubles wide where
+ * available, without building the whole library with `-mavx2`.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define TARGET_CLONES_AVX2 __attribute__((target_clones("avx2", "default")))
+#else
+#define TARGET_CLONES_AVX2
+#endif
+
 /******************************************************************************
  *                                  DATA
  *****************************************************************************/
@@ -2369,93 +2381,113 @@ std::vector<cv::Point2f> grid_good(const cv::Mat &image,
                                    const real_t k = 0.04);
 
 /**
- * Distortion model
+ * Distortion model with `N` parameters, statically dispatched: distortion
+ * model `DM` derives from `distortion_t<DM, N>` and implements
+ *
+ *     void distort(x, y, x_dist, y_dist) const;
+ *     void J_point(x, y, J00, J01, J10, J11) const;
+ *     vec2_t undistort(const vec2_t &p) const;
+ *     J_dist_t J_dist(const vec2_t &p) const;
+ *     void distort_jacobians(p, p_dist, J_p, J_params) const;
+ *
+ * Nothing is virtual and the parameters and Jacobians are fixed size, so per
+ * point loops over a model are inlined and do not allocate. The scalar forms
+ * of `distort()` and `J_point()` let loops over arrays of points vectorize,
+ * this base adds their `vec2_t` forms. `distort_jacobians()` evaluates the
+ * distorted point and both Jacobians at once, sharing the work between them.
  */
+template <typename DM, int N>
 struct distortion_t {
-  vecx_t params;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  static const int params_size = N;
+  typedef mat_t<2, N> J_dist_t;
+
+  vec_t<N> params = vec_t<N>::Zero();
 
   distortion_t() {}
 
   distortion_t(const vecx_t &params_)
     : params{params_} {}
 
-  distortion_t(const real_t *params_, const size_t params_size_) {
-    params.resize(params_size_);
-    for (size_t i = 0; i < params_size_; i++) {
-      params(i) = params_[i];
-    }
-  }
+  distortion_t(const real_t *params_)
+    : params{Eigen::Map<const vec_t<N>>(params_)} {}
 
-  virtual ~distortion_t() {}
+  ~distortion_t() {}
 
-  virtual vec2_t distort(const vec2_t &p) = 0;
-  virtual vec2_t distort(const vec2_t &p) const = 0;
+  const DM &derived() const { return static_cast<const DM &>(*this); }
 
-  virtual vec2_t undistort(const vec2_t &p) = 0;
-  virtual vec2_t undistort(const vec2_t &p) const = 0;
-
-  virtual mat2_t J_point(const vec2_t &p) = 0;
-  virtual mat2_t J_point(const vec2_t &p) const = 0;
-
-  virtual matx_t J_dist(const vec2_t &p) = 0;
-  virtual matx_t J_dist(const vec2_t &p) const = 0;
+  vec2_t distort(const vec2_t &p) const {
+    vec2_t p_dist;
+    derived().distort(p(0), p(1), p_dist(0), p_dist(1));
+    return p_dist;
+  }
 
-  // virtual void operator=(const distortion_t &src) throw() = 0;
+  mat2_t J_point(const vec2_t &p) const {
+    mat2_t J;
+    derived().J_point(p(0), p(1), J(0, 0), J(0, 1), J(1, 0), J(1, 1));
+    return J;
+  }
 };
 
 /**
  * No distortion
  */
-struct nodist_t : distortion_t {
-  static const size_t params_size = 0;
+struct nodist_t : distortion_t<nodist_t, 0> {
+  using distortion_t::distort;
+  using distortion_t::J_point;
 
   nodist_t() {}
   nodist_t(const vecx_t &) {}
   nodist_t(const real_t *) {}
   ~nodist_t() {}
 
-  vec2_t distort(const vec2_t &p) {
-    return static_cast<const nodist_t &>(*this).distort(p);
-  }
-
-  vec2_t distort(const vec2_t &p) const {
-    return p;
-  }
-
-  vec2_t undistort(const vec2_t &p) {
-    return static_cast<const nodist_t &>(*this).undistort(p);
+  void distort(const real_t x,
+               const real_t y,
+               real_t &x_dist,
+               real_t &y_dist) const {
+    x_dist = x;
+    y_dist = y;
   }
 
   vec2_t undistort(const vec2_t &p) const {
     return p;
   }
 
-  mat2_t J_point(const vec2_t &p) {
-    return static_cast<const nodist_t &>(*this).J_point(p);
+  void J_point(const real_t x,
+               const real_t y,
+               real_t &J00,
+               real_t &J01,
+               real_t &J10,
+               real_t &J11) const {
+    UNUSED(x);
+    UNUSED(y);
+    J00 = 1.0;
+    J01 = 0.0;
+    J10 = 0.0;
+    J11 = 1.0;
   }
 
-  mat2_t J_point(const vec2_t &p) const {
+  J_dist_t J_dist(const vec2_t &p) const {
     UNUSED(p);
-    return I(2);
+    return J_dist_t{};
   }
 
-  matx_t J_dist(const vec2_t &p) {
-    return static_cast<const nodist_t &>(*this).J_dist(p);
-  }
-
-  matx_t J_dist(const vec2_t &p) const {
-    UNUSED(p);
-    matx_t J;
-    J.resize(2, 0);
-    return J;
+  void distort_jacobians(const vec2_t &p,
+                         vec2_t &p_dist,
+                         mat2_t &J_p,
+                         J_dist_t &J_params) const {
+    UNUSED(J_params);
+    p_dist = p;
+    J_p.setIdentity();
   }
 };
 
 /**
  * Radial-tangential distortion
  */
-struct radtan4_t : distortion_t {
-  static const size_t params_size = 4;
+struct radtan4_t : distortion_t<radtan4_t, 4> {
+  using distortion_t::distort;
+  using distortion_t::J_point;
 
   radtan4_t() {}
 
@@ -2463,7 +2495,7 @@ struct radtan4_t : distortion_t {
     : distortion_t{params_} {}
 
   radtan4_t(const real_t *dist_params)
-    : distortion_t{dist_params, params_size} {}
+    : distortion_t{dist_params} {}
 
   radtan4_t(const real_t k1,
             const real_t k2,
@@ -2471,44 +2503,29 @@ struct radtan4_t : distortion_t {
             const real_t p2)
     : distortion_t{vec4_t{k1, k2, p1, p2}} {}
 
-  virtual ~radtan4_t() {}
+  ~radtan4_t() {}
 
-  real_t k1() { return static_cast<const radtan4_t &>(*this).k1(); }
-  real_t k2() { return static_cast<const radtan4_t &>(*this).k2(); }
-  real_t p1() { return static_cast<const radtan4_t &>(*this).p1(); }
-  real_t p2() { return static_cast<const radtan4_t &>(*this).p2(); }
   real_t k1() const { return params(0); }
   real_t k2() const { return params(1); }
   real_t p1() const { return params(2); }
   real_t p2() const { return params(3); }
 
-  vec2_t distort(const vec2_t &p) {
-    return static_cast<const radtan4_t &>(*this).distort(p);
-  }
-
-  vec2_t distort(const vec2_t &p) const {
-    const real_t x = p(0);
-    const real_t y = p(1);
-
+  void distort(const real_t x,
+               const real_t y,
+               real_t &x_dist,
+               real_t &y_dist) const {
     // Apply radial distortion
     const real_t x2 = x * x;
     const real_t y2 = y * y;
+    const real_t xy = x * y;
     const real_t r2 = x2 + y2;
-    const real_t r4 = r2 * r2;
-    const real_t radial_factor = 1 + (k1() * r2) + (k2() * r4);
-    const real_t x_dash = x * radial_factor;
-    const real_t y_dash = y * radial_factor;
+    const real_t radial = 1.0 + k1() * r2 + k2() * r2 * r2;
+    x_dist = x * radial + 2.0 * p1() * xy;
+    y_dist = y * radial + p1() * (r2 + 2.0 * y2);
 
     // Apply tangential distortion
-    const real_t xy = x * y;
-    const real_t x_ddash = x_dash + (2 * p1() * xy + p2() * (r2 + 2 * x2));
-    const real_t y_ddash = y_dash + (p1() * (r2 + 2 * y2) + 2 * p2() * xy);
-
-    return vec2_t{x_ddash, y_ddash};
-  }
-
-  vec2_t undistort(const vec2_t &p0) {
-    return static_cast<const radtan4_t &>(*this).undistort(p0);
+    x_dist += p2() * (r2 + 2.0 * x2);
+    y_dist += 2.0 * p2() * xy;
   }
 
   vec2_t undistort(const vec2_t &p0) const {
@@ -2534,42 +2551,31 @@ struct radtan4_t : distortion_t {
     return p;
   }
 
-  mat2_t J_point(const vec2_t &p) {
-    return static_cast<const radtan4_t &>(*this).J_point(p);
-  }
-
-  mat2_t J_point(const vec2_t &p) const {
-    const real_t x = p(0);
-    const real_t y = p(1);
-
+  void J_point(const real_t x,
+               const real_t y,
+               real_t &J00,
+               real_t &J01,
+               real_t &J10,
+               real_t &J11) const {
     const real_t x2 = x * x;
     const real_t y2 = y * y;
+    const real_t xy = x * y;
     const real_t r2 = x2 + y2;
-    const real_t r4 = r2 * r2;
+    const real_t radial = 1.0 + k1() * r2 + k2() * r2 * r2;
+    const real_t radial_r = 2.0 * k1() + 4.0 * k2() * r2;
 
     // Let p = [x; y] normalized point
     // Let p' be the distorted p
     // The jacobian of p' w.r.t. p (or dp'/dp) is:
-    mat2_t J_point;
-    J_point(0, 0) = 1 + k1() * r2 + k2() * r4;
-    J_point(0, 0) += 2 * p1() * y + 6 * p2() * x;
-    J_point(0, 0) += x * (2 * k1() * x + 4 * k2() * x * r2);
-    J_point(1, 0) = 2 * p1() * x + 2 * p2() * y;
-    J_point(1, 0) += y * (2 * k1() * x + 4 * k2() * x * r2);
-    J_point(0, 1) = J_point(1, 0);
-    J_point(1, 1) = 1 + k1() * r2 + k2() * r4;
-    J_point(1, 1) += 6 * p1() * y + 2 * p2() * x;
-    J_point(1, 1) += y * (2 * k1() * y + 4 * k2() * y * r2);
-    // Above is generated using sympy
-
-    return J_point;
-  }
-
-  matx_t J_dist(const vec2_t &p) {
-    return static_cast<const radtan4_t &>(*this).J_dist(p);
+    J00 = radial + 2.0 * p1() * y + 6.0 * p2() * x;
+    J00 += x2 * radial_r;
+    J01 = 2.0 * p1() * x + 2.0 * p2() * y + xy * radial_r;
+    J10 = J01;
+    J11 = radial + 6.0 * p1() * y + 2.0 * p2() * x;
+    J11 += y2 * radial_r;
   }
 
-  matx_t J_dist(const vec2_t &p) const {
+  J_dist_t J_dist(const vec2_t &p) const {
     const real_t x = p(0);
     const real_t y = p(1);
 
@@ -2579,7 +2585,7 @@ struct radtan4_t : distortion_t {
     const real_t r2 = x2 + y2;
     const real_t r4 = r2 * r2;
 
-    mat_t<2, 4> J_dist = zeros(2, 4);
+    J_dist_t J_dist;
     J_dist(0, 0) = x * r2;
     J_dist(0, 1) = x * r4;
     J_dist(0, 2) = 2 * xy;
@@ -2592,6 +2598,16 @@ struct radtan4_t : distortion_t {
 
     return J_dist;
   }
+
+  void distort_jacobians(const vec2_t &p,
+                         vec2_t &p_dist,
+                         mat2_t &J_p,
+                         J_dist_t &J_params) const {
+    // Inlined, the common terms are only evaluated once
+    distort(p(0), p(1), p_dist(0), p_dist(1));
+    J_point(p(0), p(1), J_p(0, 0), J_p(0, 1), J_p(1, 0), J_p(1, 1));
+    J_params = J_dist(p);
+  }
 };
 
 std::ostream &operator<<(std::ostream &os, const radtan4_t &radtan4);
@@ -2599,8 +2615,9 @@ std::ostream &operator<<(std::ostream &os, const radtan4_t &radtan4);
 /**
  * Equi-distant distortion
  */
-struct equi4_t : distortion_t {
-  static const size_t params_size = 4;
+struct equi4_t : distortion_t<equi4_t, 4> {
+  using distortion_t::distort;
+  using distortion_t::J_point;
 
   equi4_t() {}
 
@@ -2608,36 +2625,30 @@ struct equi4_t : distortion_t {
     : distortion_t{dist_params} {}
 
   equi4_t(const real_t *dist_params)
-    : distortion_t{dist_params, params_size} {}
+    : distortion_t{dist_params} {}
 
   equi4_t(const real_t k1,
           const real_t k2,
           const real_t k3,
-          const real_t k4) {
-    params.resize(4);
-    params << k1, k2, k3, k4;
-  }
+          const real_t k4)
+    : distortion_t{vec4_t{k1, k2, k3, k4}} {}
 
   ~equi4_t() {}
 
-  real_t k1() { return static_cast<const equi4_t &>(*this).k1(); }
-  real_t k2() { return static_cast<const equi4_t &>(*this).k2(); }
-  real_t k3() { return static_cast<const equi4_t &>(*this).k3(); }
-  real_t k4() { return static_cast<const equi4_t &>(*this).k4(); }
-
   real_t k1() const { return this->params(0); }
   real_t k2() const { return this->params(1); }
   real_t k3() const { return this->params(2); }
   real_t k4() const { return this->params(3); }
 
-  vec2_t distort(const vec2_t &p) {
-    return static_cast<const equi4_t &>(*this).distort(p);
-  }
-
-  vec2_t distort(const vec2_t &p) const {
-    const real_t r = p.norm();
+  void distort(const real_t x,
+               const real_t y,
+               real_t &x_dist,
+               real_t &y_dist) const {
+    const real_t r = sqrt(x * x + y * y);
     if (r < 1e-8) {
-      return p;
+      x_dist = x;
+      y_dist = y;
+      return;
     }
 
     // Apply equi distortion
@@ -2646,15 +2657,10 @@ struct equi4_t : distortion_t {
     const real_t th4 = th2 * th2;
     const real_t th6 = th4 * th2;
     const real_t th8 = th4 * th4;
-    const real_t thd = th * (1 + k1() * th2 + k2() * th4 + k3() * th6 + k4() * th8);
-    const real_t x_dash = (thd / r) * p(0);
-    const real_t y_dash = (thd / r) * p(1);
-
-    return vec2_t{x_dash, y_dash};
-  }
-
-  vec2_t undistort(const vec2_t &p) {
-    return static_cast<const equi4_t &>(*this).undistort(p);
+    real_t thd = 1.0 + k1() * th2 + k2() * th4 + k3() * th6 + k4() * th8;
+    thd *= th;
+    x_dist = (thd / r) * x;
+    y_dist = (thd / r) * y;
   }
 
   vec2_t undistort(const vec2_t &p) const {
@@ -2673,20 +2679,28 @@ struct equi4_t : distortion_t {
     return vec2_t{p(0) * scaling, p(1) * scaling};
   }
 
-  mat2_t J_point(const vec2_t &p) {
-    return static_cast<const equi4_t &>(*this).J_point(p);
-  }
+  void J_point(const real_t x,
+               const real_t y,
+               real_t &J00,
+               real_t &J01,
+               real_t &J10,
+               real_t &J11) const {
+    const real_t r = sqrt(x * x + y * y);
+    if (r < 1e-8) {
+      J00 = 1.0;
+      J01 = 0.0;
+      J10 = 0.0;
+      J11 = 1.0;
+      return;
+    }
 
-  mat2_t J_point(const vec2_t &p) const {
-    const real_t x = p(0);
-    const real_t y = p(1);
-    const real_t r = p.norm();
     const real_t th = atan(r);
     const real_t th2 = th * th;
     const real_t th4 = th2 * th2;
     const real_t th6 = th4 * th2;
     const real_t th8 = th4 * th4;
-    const real_t thd = th * (1.0 + k1() * th2 + k2() * th4 + k3() * th6 + k4() * th8);
+    real_t thd = 1.0 + k1() * th2 + k2() * th4 + k3() * th6 + k4() * th8;
+    thd *= th;
     const real_t s = thd / r;
 
     // Form jacobian
@@ -2699,31 +2713,27 @@ struct equi4_t : distortion_t {
     const real_t r_x = 1.0 / r * x;
     const real_t r_y = 1.0 / r * y;
 
-    mat2_t J_point = I(2);
-    J_point(0, 0) = s + x * s_r * r_x;
-    J_point(0, 1) = x * s_r * r_y;
-    J_point(1, 0) = y * s_r * r_x;
-    J_point(1, 1) = s + y * s_r * r_y;
-
-    return J_point;
-  }
-
-  matx_t J_dist(const vec2_t &p) {
-    return static_cast<const equi4_t &>(*this).J_dist(p);
+    J00 = s + x * s_r * r_x;
+    J01 = x * s_r * r_y;
+    J10 = y * s_r * r_x;
+    J11 = s + y * s_r * r_y;
   }
 
-  matx_t J_dist(const vec2_t &p) const {
+  J_dist_t J_dist(const vec2_t &p) const {
     const real_t x = p(0);
     const real_t y = p(1);
     const real_t r = p.norm();
-    const real_t th = atan(r);
+    if (r < 1e-8) {
+      return J_dist_t::Zero();
+    }
 
+    const real_t th = atan(r);
     const real_t th3 = th * th * th;
     const real_t th5 = th3 * th * th;
     const real_t th7 = th5 * th * th;
     const real_t th9 = th7 * th * th;
 
-    matx_t J_dist = zeros(2, 4);
+    J_dist_t J_dist;
     J_dist(0, 0) = x * th3 / r;
     J_dist(0, 1) = x * th5 / r;
     J_dist(0, 2) = x * th7 / r;
@@ -2736,18 +2746,72 @@ struct equi4_t : distortion_t {
 
     return J_dist;
   }
+
+  void distort_jacobians(const vec2_t &p,
+                         vec2_t &p_dist,
+                         mat2_t &J_p,
+                         J_dist_t &J_params) const {
+    const real_t x = p(0);
+    const real_t y = p(1);
+    const real_t r = sqrt(x * x + y * y);
+    if (r < 1e-8) {
+      p_dist = p;
+      J_p.setIdentity();
+      J_params.setZero();
+      return;
+    }
+
+    // Distort, see distort()
+    const real_t th = atan(r);
+    const real_t th2 = th * th;
+    const real_t th4 = th2 * th2;
+    const real_t th6 = th4 * th2;
+    const real_t th8 = th4 * th4;
+    real_t thd = 1.0 + k1() * th2 + k2() * th4 + k3() * th6 + k4() * th8;
+    thd *= th;
+    const real_t s = thd / r;
+    p_dist(0) = s * x;
+    p_dist(1) = s * y;
+
+    // Jacobian w.r.t. point, see J_point()
+    real_t thd_th = 1.0 + 3.0 * k1() * th2 + 5.0 * k2() * th4;
+    thd_th += 7.0 * k3() * th6 + 9.0 * k4() * th8;
+    const real_t th_r = 1.0 / (r * r + 1.0);
+    const real_t s_r = (thd_th * th_r - s) / r;
+    J_p(0, 0) = s + x * s_r * x / r;
+    J_p(0, 1) = x * s_r * y / r;
+    J_p(1, 0) = J_p(0, 1);
+    J_p(1, 1) = s + y * s_r * y / r;
+
+    // Jacobian w.r.t. distortion parameters, see J_dist()
+    const real_t th3 = th2 * th;
+    J_params.row(0) << th3, th3 * th2, th3 * th4, th3 * th6;
+    J_params.row(1) = J_params.row(0);
+    J_params.row(0) *= x / r;
+    J_params.row(1) *= y / r;
+  }
 };
 
 std::ostream &operator<<(std::ostream &os, const equi4_t &equi4);
 
 /**
- * Projection model
+ * Projection model with `N` projection parameters and distortion model `DM`,
+ * statically dispatched like `distortion_t`: projection model `PM` derives
+ * from `projection_t<PM, N, DM>` and implements `project()`, `J_point()`,
+ * `J_proj()` and `J_dist()`. The parameter Jacobians `J_proj_t` and
+ * `J_dist_t` are fixed size.
  */
-template <typename DM = nodist_t>
+template <typename PM, int N, typename DM = nodist_t>
 struct projection_t {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  static const int proj_params_size = N;
+  static const int dist_params_size = DM::params_size;
+  typedef mat_t<2, N> J_proj_t;
+  typedef mat_t<2, DM::params_size> J_dist_t;
+
   int img_w = 0;
   int img_h = 0;
-  vecx_t params;
+  vec_t<N> params = vec_t<N>::Zero();
   DM distortion;
 
   projection_t() {}
@@ -2764,36 +2828,28 @@ struct projection_t {
   projection_t(const int img_w_,
                const int img_h_,
                const real_t *proj_params_,
-               const size_t proj_params_size_,
                const real_t *dist_params_)
     : img_w{img_w_},
       img_h{img_h_},
-      distortion{dist_params_} {
-    params.resize(proj_params_size_);
-    for (size_t i = 0; i < proj_params_size_; i++) {
-      params(i) = proj_params_[i];
-    }
-  }
+      params{Eigen::Map<const vec_t<N>>(proj_params_)},
+      distortion{dist_params_} {}
 
   ~projection_t() {}
 
-  virtual mat2_t J_point() = 0;
-  virtual mat2_t J_point() const = 0;
-
-  virtual matx_t J_proj(const vec2_t &p) = 0;
-  virtual matx_t J_proj(const vec2_t &p) const = 0;
+  const PM &derived() const { return static_cast<const PM &>(*this); }
 
-  virtual matx_t J_dist(const vec2_t &p) = 0;
-  virtual matx_t J_dist(const vec2_t &p) const = 0;
+  vecx_t proj_params() const { return params; }
+  vecx_t dist_params() const { return distortion.params; }
 };
 
 /**
  * Pinhole projection model
  */
 template <typename DM = nodist_t>
-struct pinhole_t : projection_t<DM> {
-  static const size_t proj_params_size = 4;
-  static const size_t dist_params_size = DM::params_size;
+struct pinhole_t : projection_t<pinhole_t<DM>, 4, DM> {
+  typedef projection_t<pinhole_t<DM>, 4, DM> projection_base_t;
+  typedef typename projection_base_t::J_proj_t J_proj_t;
+  typedef typename projection_base_t::J_dist_t J_dist_t;
 
   pinhole_t() {}
 
@@ -2801,13 +2857,13 @@ struct pinhole_t : projection_t<DM> {
             const int img_h,
             const vecx_t &proj_params,
             const vecx_t &dist_params)
-    : projection_t<DM>{img_w, img_h, proj_params, dist_params} {}
+    : projection_base_t{img_w, img_h, proj_params, dist_params} {}
 
   pinhole_t(const int img_w,
             const int img_h,
             const real_t *proj_params,
             const real_t *dist_params)
-    : projection_t<DM>{img_w, img_h, proj_params, proj_params_size, dist_params} {}
+    : projection_base_t{img_w, img_h, proj_params, dist_params} {}
 
   pinhole_t(const int img_w,
             const int img_h,
@@ -2815,40 +2871,18 @@ struct pinhole_t : projection_t<DM> {
             const real_t fy,
             const real_t cx,
             const real_t cy)
-      : projection_t<DM>{img_w, img_h, vec4_t{fx, fy, cx, cy}, zeros(0)} {}
+      : projection_base_t{img_w,
+                          img_h,
+                          vec4_t{fx, fy, cx, cy},
+                          vec_t<DM::params_size>::Zero()} {}
 
   ~pinhole_t() {}
 
-  real_t fx() { return static_cast<const pinhole_t &>(*this).fx(); }
-  real_t fy() { return static_cast<const pinhole_t &>(*this).fy(); }
-  real_t cx() { return static_cast<const pinhole_t &>(*this).cx(); }
-  real_t cy() { return static_cast<const pinhole_t &>(*this).cy(); }
-
   real_t fx() const { return this->params(0); }
   real_t fy() const { return this->params(1); }
   real_t cx() const { return this->params(2); }
   real_t cy() const { return this->params(3); }
 
-  vecx_t proj_params() {
-    return static_cast<const pinhole_t &>(*this).proj_params();
-  }
-
-  vecx_t proj_params() const {
-    return this->params;
-  }
-
-  vecx_t dist_params() {
-    return static_cast<const pinhole_t &>(*this).dist_params();
-  }
-
-  vecx_t dist_params() const {
-    return this->distortion.params;
-  }
-
-  mat3_t K() {
-    return static_cast<const pinhole_t &>(*this).K();
-  }
-
   mat3_t K() const {
     mat3_t K = zeros(3, 3);
     K(0, 0) = fx();
@@ -2859,10 +2893,6 @@ struct pinhole_t : projection_t<DM> {
     return K;
   }
 
-  int project(const vec3_t &p_C, vec2_t &z_hat) {
-    return static_cast<const pinhole_t &>(*this).project(p_C, z_hat);
-  }
-
   int project(const vec3_t &p_C, vec2_t &z_hat) const {
     // Check validity of the point, simple depth test.
     const real_t x = p_C(0);
@@ -2888,10 +2918,6 @@ struct pinhole_t : projection_t<DM> {
     return 0;
   }
 
-  int project(const vec3_t &p_C, vec2_t &z_hat, mat_t<2, 3> &J_h) {
-    return static_cast<const pinhole_t &>(*this).project(p_C, z_hat, J_h);
-  }
-
   int project(const vec3_t &p_C, vec2_t &z_hat, mat_t<2, 3> &J_h) const {
     int retval = project(p_C, z_hat);
     if (retval != 0) {
@@ -2902,7 +2928,7 @@ struct pinhole_t : projection_t<DM> {
     const real_t x = p_C(0);
     const real_t y = p_C(1);
     const real_t z = p_C(2);
-    mat_t<2, 3> J_proj = zeros(2, 3);
+    mat_t<2, 3> J_proj = mat_t<2, 3>::Zero();
     J_proj(0, 0) = 1.0 / z;
     J_proj(1, 1) = 1.0 / z;
     J_proj(0, 2) = -x / (z * z);
@@ -2915,26 +2941,63 @@ struct pinhole_t : projection_t<DM> {
     return 0;
   }
 
-  mat2_t J_point() {
-    return static_cast<const pinhole_t &>(*this).J_point();
+  /**
+   * Project point `p_C` to image point `z_hat`, with the Jacobians of `z_hat`
+   * w.r.t. the point `J_h`, the projection parameters `J_proj` and the
+   * distortion parameters `J_dist`. Unlike `project()` points outside the
+   * image are not rejected, as calibration residuals need them.
+   *
+   * @returns 0 for success, -1 if `p_C` is on the z = 0 plane and 1 if it is
+   * behind the camera
+   */
+  int project_jacobians(const vec3_t &p_C,
+                        vec2_t &z_hat,
+                        mat_t<2, 3> &J_h,
+                        J_proj_t &J_proj,
+                        J_dist_t &J_dist) const {
+    if (fabs(p_C(2)) < 1e-12) {
+      return -1;
+    }
+
+    // Project to normalized image plane
+    const real_t z_inv = 1.0 / p_C(2);
+    const vec2_t p{p_C(0) * z_inv, p_C(1) * z_inv};
+    mat_t<2, 3> J_norm;
+    J_norm << z_inv, 0.0, -p(0) * z_inv,
+              0.0, z_inv, -p(1) * z_inv;
+
+    // Distort
+    vec2_t p_dist;
+    mat2_t J_dist_point;
+    this->distortion.distort_jacobians(p, p_dist, J_dist_point, J_dist);
+
+    // Scale and center, `J_point()` is diagonal so it scales the rows
+    const vec2_t f{fx(), fy()};
+    z_hat(0) = f(0) * p_dist(0) + cx();
+    z_hat(1) = f(1) * p_dist(1) + cy();
+    J_h = J_dist_point * J_norm;
+    J_h.row(0) *= f(0);
+    J_h.row(1) *= f(1);
+    J_proj << p_dist(0), 0.0, 1.0, 0.0,
+              0.0, p_dist(1), 0.0, 1.0;
+    J_dist.row(0) *= f(0);
+    J_dist.row(1) *= f(1);
+
+    return (p_C(2) > 0.0) ? 0 : 1;
   }
 
   mat2_t J_point() const {
-    mat2_t J_K = zeros(2, 2);
+    mat2_t J_K = mat2_t::Zero();
     J_K(0, 0) = fx();
     J_K(1, 1) = fy();
     return J_K;
   }
 
-  matx_t J_proj(const vec2_t &p) {
-    return static_cast<const pinhole_t &>(*this).J_proj(p);
-  }
-
-  matx_t J_proj(const vec2_t &p) const {
+  J_proj_t J_proj(const vec2_t &p) const {
     const real_t x = p(0);
     const real_t y = p(1);
 
-    mat_t<2, 4> J_proj = zeros(2, 4);
+    J_proj_t J_proj = J_proj_t::Zero();
     J_proj(0, 0) = x;
     J_proj(1, 1) = y;
     J_proj(0, 2) = 1;
@@ -2943,11 +3006,7 @@ struct pinhole_t : projection_t<DM> {
     return J_proj;
   }
 
-  matx_t J_dist(const vec2_t &p) {
-    return static_cast<const pinhole_t &>(*this).J_dist(p);
-  }
-
-  matx_t J_dist(const vec2_t &p) const {
+  J_dist_t J_dist(const vec2_t &p) const {
     return J_point() * this->distortion.J_dist(p);
   }
 };
@@ -3079,6 +3138,166 @@ int pinhole_equi4_project(const Eigen::Matrix<T, 8, 1> &params,
   }
 }
 
+/**
+ * Double sphere projection, see "The Double Sphere Camera Model" (Usenko et
+ * al. 2018). Where `params` are (fx, fy, cx, cy, xi, alpha, -, -), the last
+ * two are unused so the model shares the parameter layout of the pinhole
+ * models.
+ *
+ * @returns 0 for success, -1 if point is outside the valid projection region
+ */
+template <typename T>
+int double_sphere_project(const Eigen::Matrix<T, 8, 1> &params,
+                          const Eigen::Matrix<T, 3, 1> &point,
+                          Eigen::Matrix<T, 2, 1> &image_point) {
+  // Extract intrinsics params
+  const T fx = params(0);
+  const T fy = params(1);
+  const T cx = params(2);
+  const T cy = params(3);
+  const T xi = params(4);
+  const T alpha = params(5);
+
+  // Check point is in the valid projection region
+  const T x = point(0);
+  const T y = point(1);
+  const T z = point(2);
+  const T r2 = x * x + y * y;
+  const T d1 = sqrt(r2 + z * z);
+  const T w1 = (alpha <= T(0.5)) ? alpha / (T(1) - alpha)
+                                 : (T(1) - alpha) / alpha;
+  const T w2 = (w1 + xi) / sqrt(T(2) * w1 * xi + xi * xi + T(1));
+  if (z <= -w2 * d1) {
+    return -1;
+  }
+
+  // Project
+  const T zz = xi * d1 + z;
+  const T d2 = sqrt(r2 + zz * zz);
+  const T denom = alpha * d2 + (T(1) - alpha) * zz;
+  if ((T) denom < (T) 1.0e-12) {
+    return -1;
+  }
+
+  // Scale and center
+  image_point(0) = fx * x / denom + cx;
+  image_point(1) = fy * y / denom + cy;
+
+  return 0;
+}
+
+/**
+ * Double sphere closed-form unprojection of image point `z` to unit
+ * `bearing` vector, see `double_sphere_project()`.
+ *
+ * @returns 0 for success, -1 if `z` is outside the valid unprojection region
+ */
+int double_sphere_unproject(const real_t *params,
+                            const vec2_t &z,
+                            vec3_t &bearing);
+
+/**
+ * Project `n` points in structure-of-arrays layout (`x`, `y`, `z`) with the
+ * pinhole-radtan4 model `params` (fx, fy, cx, cy, k1, k2, p1, p2) to image
+ * points (`u`, `v`). Where `valid[i]` is 1 if the point projects like
+ * `pinhole_radtan4_project()` returning 0, else 0 and `u[i]`, `v[i]` are 0.
+ * The loop is branch free so the compiler can vectorize it, and is built for
+ * AVX2 where available, see `TARGET_CLONES_AVX2`.
+ */
+void pinhole_radtan4_project_batch(const real_t *params,
+                                   const size_t n,
+                                   const real_t *x,
+                                   const real_t *y,
+                                   const real_t *z,
+                                   real_t *u,
+                                   real_t *v,
+                                   uint8_t *valid);
+
+/**
+ * Project `n` points in structure-of-arrays layout with the pinhole-equi4
+ * model `params` (fx, fy, cx, cy, k1, k2, k3, k4), see
+ * `pinhole_radtan4_project_batch()`. There is no vector `atan` without
+ * `-ffast-math`, so the points are projected in blocks where only the `atan`
+ * pass is scalar.
+ */
+void pinhole_equi4_project_batch(const real_t *params,
+                                 const size_t n,
+                                 const real_t *x,
+                                 const real_t *y,
+                                 const real_t *z,
+                                 real_t *u,
+                                 real_t *v,
+                                 uint8_t *valid);
+
+/**
+ * Undistort `n` image points (`u`, `v`) with the pinhole-radtan4 model
+ * `params` (fx, fy, cx, cy, k1, k2, p1, p2) to normalized image points
+ * (`x`, `y`) on the z = 1 plane. Runs a fixed `max_iter` Newton iterations
+ * with the analytic point Jacobian on every point. The points are processed
+ * in blocks with the iterations as the outer loop, so the loop over the
+ * points is branch free and vectorizes. Where `converged[i]` is 1 if the
+ * squared residual of the distorted point is below 1e-15, else 0.
+ *
+ * @returns Number of converged points
+ */
+size_t pinhole_radtan4_undistort_batch(const real_t *params,
+                                       const size_t n,
+                                       const real_t *u,
+                                       const real_t *v,
+                                       real_t *x,
+                                       real_t *y,
+                                       uint8_t *converged,
+                                       const int max_iter = 10);
+
+/**
+ * Undistort `n` image points with the pinhole-equi4 model `params` (fx, fy,
+ * cx, cy, k1, k2, k3, k4) by solving for the incidence angle with Newton's
+ * method, see `pinhole_radtan4_undistort_batch()`. Points whose incidence
+ * angle does not lie in [0, pi / 2) are not converged. Like
+ * `pinhole_equi4_project_batch()` only the final `tan` pass is scalar.
+ *
+ * @returns Number of converged points
+ */
+size_t pinhole_equi4_undistort_batch(const real_t *params,
+                                     const size_t n,
+                                     const real_t *u,
+                                     const real_t *v,
+                                     real_t *x,
+                                     real_t *y,
+                                     uint8_t *converged,
+                                     const int max_iter = 10);
+
+/**
+ * Project `n` points in structure-of-arrays layout with the double sphere
+ * model `params` (fx, fy, cx, cy, xi, alpha, -, -), see
+ * `pinhole_radtan4_project_batch()` and `double_sphere_project()`.
+ */
+void double_sphere_project_batch(const real_t *params,
+                                 const size_t n,
+                                 const real_t *x,
+                                 const real_t *y,
+                                 const real_t *z,
+                                 real_t *u,
+                                 real_t *v,
+                                 uint8_t *valid);
+
+/**
+ * Unproject `n` image points with the double sphere model `params` (fx, fy,
+ * cx, cy, xi, alpha, -, -) to normalized image points on the z = 1 plane.
+ * The unprojection is closed-form, points are `converged` if they are in the
+ * valid unprojection region and in front of the camera, see
+ * `pinhole_radtan4_undistort_batch()`.
+ *
+ * @returns Number of converged points
+ */
+size_t double_sphere_undistort_batch(const real_t *params,
+                                     const size_t n,
+                                     const real_t *u,
+                                     const real_t *v,
+                                     real_t *x,
+                                     real_t *y,
+                                     uint8_t *converged);
+
 } //  namespace yac
 
 #endif // YAC_CORE_HPP
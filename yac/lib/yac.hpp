@@ -1,6 +1,11 @@
 #include "core.hpp"
 #include "aprilgrid.hpp"
 #include "calib_data.hpp"
+#include "calib_solver.hpp"
+#include "calib_undistort.hpp"
 #include "calib_mono.hpp"
 #include "calib_stereo.hpp"
 #include "calib_mocap_marker.hpp"
+#include "calib_verify.hpp"
+#include "calib_window.hpp"
+#include "calib_batch.hpp"
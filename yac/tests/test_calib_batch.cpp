@@ -0,0 +1,157 @@
+#include <omp.h>
+
+#include "munit.hpp"
+#include "calib_batch.hpp"
+
+namespace yac {
+
+#define TEST_DATA_PATH "/data/euroc_mav/cam_april/mav0"
+#define TEST_BATCH_PATH "/tmp/calib_batch_test"
+
+static void write_config(const std::string &config_file,
+                         const bool stereo,
+                         const bool imshow,
+                         const int num_threads = 1) {
+  FILE *outfile = fopen(config_file.c_str(), "w");
+  fprintf(outfile, "settings:\n");
+  fprintf(outfile, "  data_path: \"%s\"\n", TEST_DATA_PATH);
+  fprintf(outfile, "  results_fpath: \"%s/results.yaml\"\n", TEST_BATCH_PATH);
+  fprintf(outfile, "  imshow: %s\n", (imshow) ? "true" : "false");
+  fprintf(outfile, "\n");
+  fprintf(outfile, "solver:\n");
+  fprintf(outfile, "  num_threads: %d\n", num_threads);
+  fprintf(outfile, "\n");
+  fprintf(outfile, "calib_target:\n");
+  fprintf(outfile, "  target_type: 'aprilgrid'\n");
+  fprintf(outfile, "  tag_rows: 6\n");
+  fprintf(outfile, "  tag_cols: 6\n");
+  fprintf(outfile, "  tag_size: 0.088\n");
+  fprintf(outfile, "  tag_spacing: 0.3\n");
+  fprintf(outfile, "\n");
+  const int nb_cams = (stereo) ? 2 : 1;
+  for (int i = 0; i < nb_cams; i++) {
+    fprintf(outfile, "cam%d:\n", i);
+    fprintf(outfile, "  resolution: [752, 480]\n");
+    fprintf(outfile, "  lens_hfov: 98.0\n");
+    fprintf(outfile, "  lens_vfov: 73.0\n");
+    fprintf(outfile, "  proj_model: \"pinhole\"\n");
+    fprintf(outfile, "  dist_model: \"radtan4\"\n");
+  }
+  fclose(outfile);
+}
+
+int test_calib_batch_job_setup() {
+  dir_create(TEST_BATCH_PATH);
+  const std::string mono_config = TEST_BATCH_PATH "/mono.yaml";
+  const std::string stereo_config = TEST_BATCH_PATH "/stereo.yaml";
+  const std::string imshow_config = TEST_BATCH_PATH "/imshow.yaml";
+  write_config(mono_config, false, false);
+  write_config(stereo_config, true, false);
+  write_config(imshow_config, false, true);
+
+  calib_batch_options_t opts;
+  calib_batch_job_t mono;
+  MU_CHECK(calib_batch_job_setup(mono, mono_config, opts) == 0);
+  MU_CHECK(mono.type == "mono");
+  MU_CHECK(mono.threads == 1);
+  MU_CHECK(mono.memory > 752 * 480 * 3);
+
+  calib_batch_job_t stereo;
+  MU_CHECK(calib_batch_job_setup(stereo, stereo_config, opts) == 0);
+  MU_CHECK(stereo.type == "stereo");
+  MU_CHECK(stereo.threads == 2);
+  MU_CHECK(stereo.memory > mono.memory);
+
+  // Interactive configs are rejected
+  calib_batch_job_t imshow;
+  MU_CHECK(calib_batch_job_setup(imshow, imshow_config, opts) != 0);
+
+  // Missing config file or settings are rejected, and the job marked failed
+  calib_batch_job_t missing;
+  const std::string missing_config = TEST_BATCH_PATH "/missing.yaml";
+  MU_CHECK(calib_batch_job_setup(missing, missing_config, opts) != 0);
+  MU_CHECK(missing.retval != 0);
+
+  const std::string no_results_config = TEST_BATCH_PATH "/no_results.yaml";
+  FILE *outfile = fopen(no_results_config.c_str(), "w");
+  fprintf(outfile, "settings:\n");
+  fprintf(outfile, "  data_path: \"%s\"\n", TEST_DATA_PATH);
+  fclose(outfile);
+  calib_batch_job_t no_results;
+  MU_CHECK(calib_batch_job_setup(no_results, no_results_config, opts) != 0);
+  MU_CHECK(no_results.retval != 0);
+
+  return 0;
+}
+
+int test_calib_batch_job_threads() {
+  dir_create(TEST_BATCH_PATH);
+  const std::string mono_config = TEST_BATCH_PATH "/mono_threads.yaml";
+  const std::string stereo_config = TEST_BATCH_PATH "/stereo_threads.yaml";
+  write_config(mono_config, false, false, 3);
+  write_config(stereo_config, true, false, 16);
+
+  // Solver threads are reserved if more than the cameras
+  calib_batch_options_t opts;
+  opts.max_threads = 4;
+  calib_batch_job_t mono;
+  MU_CHECK(calib_batch_job_setup(mono, mono_config, opts) == 0);
+  MU_CHECK(mono.threads == 3);
+
+  // Solver threads above the budget are clamped to it
+  calib_batch_job_t stereo;
+  MU_CHECK(calib_batch_job_setup(stereo, stereo_config, opts) == 0);
+  MU_CHECK(stereo.threads == opts.max_threads);
+
+  // The solver uses no more threads than OpenMP allows the running job
+  const int omp_threads = omp_get_max_threads();
+  omp_set_num_threads(stereo.threads);
+  calib_solver_options_t solver_opts;
+  MU_CHECK(calib_solver_options_load(solver_opts, stereo_config) == 0);
+  MU_CHECK(solver_opts.num_threads == 16);
+  ceres::Solver::Options options;
+  calib_solver_callbacks_t callbacks;
+  calib_solver_setup(solver_opts, 0, tic(), options, callbacks);
+  MU_CHECK(options.num_threads == stereo.threads);
+  omp_set_num_threads(omp_threads);
+
+  return 0;
+}
+
+int test_calib_batch_run() {
+  dir_create(TEST_BATCH_PATH);
+  const std::string imshow_config = TEST_BATCH_PATH "/imshow.yaml";
+  write_config(imshow_config, false, true);
+
+  // Failed jobs are reported in the summary
+  calib_batch_options_t opts;
+  opts.summary_fpath = TEST_BATCH_PATH "/summary.yaml";
+  std::vector<calib_batch_job_t> jobs;
+  const std::vector<std::string> configs = {imshow_config,
+                                            TEST_BATCH_PATH "/missing.yaml"};
+  MU_CHECK(calib_batch_run(configs, opts, jobs) == -1);
+  MU_CHECK(jobs.size() == 2);
+  MU_CHECK(jobs[0].retval != 0);
+  MU_CHECK(jobs[1].retval != 0);
+
+  config_t summary{opts.summary_fpath};
+  MU_CHECK(summary.ok);
+  size_t nb_jobs = 0;
+  size_t nb_failed = 0;
+  parse(summary, "nb_jobs", nb_jobs);
+  parse(summary, "nb_failed", nb_failed);
+  MU_CHECK(nb_jobs == 2);
+  MU_CHECK(nb_failed == 2);
+
+  return 0;
+}
+
+void test_suite() {
+  MU_ADD_TEST(test_calib_batch_job_setup);
+  MU_ADD_TEST(test_calib_batch_job_threads);
+  MU_ADD_TEST(test_calib_batch_run);
+}
+
+} // namespace yac
+
+MU_RUN_TESTS(yac::test_suite);
@@ -97,6 +97,32 @@ int test_preprocess_and_load_stereo_data() {
   MU_CHECK(cam1_aprilgrids[0].ids.size() > 0);
   MU_CHECK(cam0_aprilgrids.size() == cam1_aprilgrids.size());
 
+  // Test load all observations
+  aprilgrids_t cam0_all_aprilgrids;
+  aprilgrids_t cam1_all_aprilgrids;
+  retval = load_stereo_calib_data(cam0_output_dir,
+                                  cam1_output_dir,
+                                  cam0_all_aprilgrids,
+                                  cam1_all_aprilgrids,
+                                  false);
+  MU_CHECK(retval == 0);
+  MU_CHECK(cam0_all_aprilgrids.size() == cam1_all_aprilgrids.size());
+  MU_CHECK(cam0_all_aprilgrids.size() >= cam0_aprilgrids.size());
+
+  size_t nb_common_tags = 0;
+  size_t nb_all_tags = 0;
+  for (size_t i = 0; i < cam0_aprilgrids.size(); i++) {
+    nb_common_tags += cam0_aprilgrids[i].ids.size();
+  }
+  for (size_t i = 0; i < cam0_all_aprilgrids.size(); i++) {
+    const auto &grid0 = cam0_all_aprilgrids[i];
+    const auto &grid1 = cam1_all_aprilgrids[i];
+    MU_CHECK(grid0.timestamp == grid1.timestamp);
+    MU_CHECK(grid0.ids.size() > 0 || grid1.ids.size() > 0);
+    nb_all_tags += grid0.ids.size();
+  }
+  MU_CHECK(nb_all_tags >= nb_common_tags);
+
   return 0;
 }
 
@@ -156,6 +182,336 @@ int test_load_multicam_calib_data() {
   return 0;
 }
 
+int test_camera_project_batch() {
+  const double proj_params[4] = {458.654, 457.296, 367.215, 248.375};
+  const double radtan_params[4] = {-0.2834, 0.0740, 0.0002, 0.00002};
+  const double equi_params[4] = {0.0034, 0.0007, -0.0019, 0.0004};
+  const double ds_params[4] = {-0.2, 0.6, 0.0, 0.0};
+
+  // Random points in front of the camera, plus points on the optical axis,
+  // on the image plane and behind the camera
+  const size_t n = 1003;
+  std::vector<real_t> x(n), y(n), z(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = randf(-1.0, 1.0);
+    y[i] = randf(-1.0, 1.0);
+    z[i] = randf(0.5, 5.0);
+  }
+  x[0] = 0.0, y[0] = 0.0, z[0] = 1.0;
+  x[1] = 0.1, y[1] = 0.2, z[1] = 0.0;
+  x[2] = 0.1, y[2] = 0.2, z[2] = -1.0;
+
+  const camera_model_t models[3] = {PINHOLE_RADTAN4,
+                                    PINHOLE_EQUI4,
+                                    DOUBLE_SPHERE};
+  const double *dist_params[3] = {radtan_params, equi_params, ds_params};
+  for (int m = 0; m < 3; m++) {
+    std::vector<real_t> u(n), v(n);
+    std::vector<uint8_t> valid(n);
+    int retval = camera_project_batch(models[m],
+                                      proj_params,
+                                      dist_params[m],
+                                      n,
+                                      x.data(),
+                                      y.data(),
+                                      z.data(),
+                                      u.data(),
+                                      v.data(),
+                                      valid.data());
+    MU_CHECK(retval == 0);
+
+    // Compare against scalar projection
+    for (size_t i = 0; i < n; i++) {
+      const vec3_t p_C{x[i], y[i], z[i]};
+      vec2_t z_hat;
+      retval = camera_project(models[m],
+                              proj_params,
+                              dist_params[m],
+                              p_C,
+                              z_hat);
+      MU_CHECK(valid[i] == (retval == 0));
+      if (retval == 0) {
+        MU_CHECK(fabs(u[i] - z_hat(0)) < 1e-8);
+        MU_CHECK(fabs(v[i] - z_hat(1)) < 1e-8);
+      }
+    }
+    if (models[m] != DOUBLE_SPHERE) {
+      MU_CHECK(valid[1] == 0);
+      MU_CHECK(valid[2] == 0);
+    }
+  }
+
+  return 0;
+}
+
+int test_camera_undistort_batch() {
+  const double proj_params[4] = {458.654, 457.296, 367.215, 248.375};
+  const double radtan_params[4] = {-0.2834, 0.0740, 0.0002, 0.00002};
+  const double equi_params[4] = {0.0034, 0.0007, -0.0019, 0.0004};
+  const double ds_params[4] = {-0.2, 0.6, 0.0, 0.0};
+
+  // Random points in the camera field of view
+  const size_t n = 1000;
+  std::vector<real_t> x(n), y(n), z(n);
+  for (size_t i = 0; i < n; i++) {
+    z[i] = randf(0.5, 5.0);
+    x[i] = randf(-0.7, 0.7) * z[i];
+    y[i] = randf(-0.5, 0.5) * z[i];
+  }
+
+  const camera_model_t models[3] = {PINHOLE_RADTAN4,
+                                    PINHOLE_EQUI4,
+                                    DOUBLE_SPHERE};
+  const double *dist_params[3] = {radtan_params, equi_params, ds_params};
+  for (int m = 0; m < 3; m++) {
+    // Project then undistort back to the z = 1 plane
+    std::vector<real_t> u(n), v(n);
+    std::vector<uint8_t> valid(n);
+    camera_project_batch(models[m],
+                         proj_params,
+                         dist_params[m],
+                         n,
+                         x.data(),
+                         y.data(),
+                         z.data(),
+                         u.data(),
+                         v.data(),
+                         valid.data());
+
+    std::vector<real_t> x_ud(n), y_ud(n);
+    std::vector<uint8_t> converged(n);
+    const size_t nb_converged = camera_undistort_batch(models[m],
+                                                       proj_params,
+                                                       dist_params[m],
+                                                       n,
+                                                       u.data(),
+                                                       v.data(),
+                                                       x_ud.data(),
+                                                       y_ud.data(),
+                                                       converged.data());
+    MU_CHECK(nb_converged == n);
+    for (size_t i = 0; i < n; i++) {
+      MU_CHECK(converged[i] == 1);
+      MU_CHECK(fabs(x_ud[i] - x[i] / z[i]) < 1e-6);
+      MU_CHECK(fabs(y_ud[i] - y[i] / z[i]) < 1e-6);
+    }
+
+    // Principal point undistorts onto the optical axis
+    real_t x_pp = 1.0;
+    real_t y_pp = 1.0;
+    uint8_t converged_pp = 0;
+    camera_undistort_batch(models[m],
+                           proj_params,
+                           dist_params[m],
+                           1,
+                           &proj_params[2],
+                           &proj_params[3],
+                           &x_pp,
+                           &y_pp,
+                           &converged_pp);
+    MU_CHECK(converged_pp == 1);
+    MU_CHECK(fabs(x_pp) < 1e-12);
+    MU_CHECK(fabs(y_pp) < 1e-12);
+  }
+
+  // Unsupported model converges no points
+  const real_t u_pp = proj_params[2];
+  const real_t v_pp = proj_params[3];
+  real_t x_pp = 1.0;
+  real_t y_pp = 1.0;
+  uint8_t converged_pp = 1;
+  const size_t nb_converged = camera_undistort_batch((camera_model_t) 3,
+                                                     proj_params,
+                                                     radtan_params,
+                                                     1,
+                                                     &u_pp,
+                                                     &v_pp,
+                                                     &x_pp,
+                                                     &y_pp,
+                                                     &converged_pp);
+  MU_CHECK(nb_converged == 0);
+  MU_CHECK(converged_pp == 0);
+
+  return 0;
+}
+
+int test_camera_batch_benchmark() {
+  const double proj_params[4] = {458.654, 457.296, 367.215, 248.375};
+  const double radtan_params[4] = {-0.2834, 0.0740, 0.0002, 0.00002};
+  const double equi_params[4] = {0.0034, 0.0007, -0.0019, 0.0004};
+  const double ds_params[4] = {-0.2, 0.6, 0.0, 0.0};
+
+  const size_t n = 1000000;
+  std::vector<real_t> x(n), y(n), z(n);
+  for (size_t i = 0; i < n; i++) {
+    z[i] = randf(0.5, 5.0);
+    x[i] = randf(-0.7, 0.7) * z[i];
+    y[i] = randf(-0.5, 0.5) * z[i];
+  }
+
+  const camera_model_t models[3] = {PINHOLE_RADTAN4,
+                                    PINHOLE_EQUI4,
+                                    DOUBLE_SPHERE};
+  const char *names[3] = {"pinhole-radtan4", "pinhole-equi4", "double-sphere"};
+  const double *dist_params[3] = {radtan_params, equi_params, ds_params};
+  for (int m = 0; m < 3; m++) {
+    std::vector<real_t> u(n), v(n);
+    std::vector<uint8_t> valid(n);
+
+    // Project point by point
+    struct timespec t_start = tic();
+    for (size_t i = 0; i < n; i++) {
+      const vec3_t p_C{x[i], y[i], z[i]};
+      vec2_t z_hat;
+      valid[i] = camera_project(models[m],
+                                proj_params,
+                                dist_params[m],
+                                p_C,
+                                z_hat) == 0;
+      u[i] = z_hat(0);
+      v[i] = z_hat(1);
+    }
+    const real_t t_project = toc(&t_start);
+
+    // Project in one batch
+    t_start = tic();
+    camera_project_batch(models[m],
+                         proj_params,
+                         dist_params[m],
+                         n,
+                         x.data(),
+                         y.data(),
+                         z.data(),
+                         u.data(),
+                         v.data(),
+                         valid.data());
+    const real_t t_project_batch = toc(&t_start);
+
+    printf("%s project: %f [s]\n", names[m], t_project);
+    printf("%s project batch: %f [s]\n", names[m], t_project_batch);
+    printf("speed up: %.2fx\n", t_project / t_project_batch);
+
+    // Undistort point by point, then in one batch
+    std::vector<real_t> x_ud(n), y_ud(n);
+    std::vector<uint8_t> converged(n);
+    t_start = tic();
+    for (size_t i = 0; i < n; i++) {
+      camera_undistort_batch(models[m],
+                             proj_params,
+                             dist_params[m],
+                             1,
+                             &u[i],
+                             &v[i],
+                             &x_ud[i],
+                             &y_ud[i],
+                             &converged[i]);
+    }
+    const real_t t_undistort = toc(&t_start);
+
+    t_start = tic();
+    camera_undistort_batch(models[m],
+                           proj_params,
+                           dist_params[m],
+                           n,
+                           u.data(),
+                           v.data(),
+                           x_ud.data(),
+                           y_ud.data(),
+                           converged.data());
+    const real_t t_undistort_batch = toc(&t_start);
+
+    printf("%s undistort: %f [s]\n", names[m], t_undistort);
+    printf("%s undistort batch: %f [s]\n", names[m], t_undistort_batch);
+    printf("speed up: %.2fx\n", t_undistort / t_undistort_batch);
+  }
+
+  return 0;
+}
+
+int test_calib_stats() {
+  const vecx_t proj_params = vec4_t{458.654, 457.296, 367.215, 248.375};
+  const vecx_t dist_params = vec4_t{-0.2834, 0.0740, 0.0002, 0.00002};
+  const calib_params_t cam{"pinhole", "radtan4", 752, 480,
+                           proj_params, dist_params};
+
+  // Synthetic observations of a 3x2 grid of tags, the keypoints of tag 3 are
+  // offset by 2 pixels
+  calib_obs_t obs;
+  mat4s_t poses;
+  const size_t nb_frames = 10;
+  for (size_t k = 0; k < nb_frames; k++) {
+    const vec3_t r_CF{-0.3 + 0.02 * k, -0.2, 1.0 + 0.1 * k};
+    const mat4_t T_CF = tf(I(3), r_CF);
+    obs.timestamps.push_back(k);
+    obs.frame_offsets.push_back(obs.nb_corners());
+    poses.push_back(T_CF);
+
+    for (int tag_id = 0; tag_id < 6; tag_id++) {
+      for (int corner_id = 0; corner_id < 4; corner_id++) {
+        const real_t x = 0.2 * (tag_id % 3) + 0.1 * (corner_id % 2);
+        const real_t y = 0.2 * (tag_id / 3) + 0.1 * (corner_id / 2);
+        const vec3_t p_F{x, y, 0.0};
+        vec2_t z;
+        MU_CHECK(camera_project(PINHOLE_RADTAN4,
+                                proj_params.data(),
+                                dist_params.data(),
+                                tf_point(T_CF, p_F),
+                                z) == 0);
+        if (tag_id == 3) {
+          z(0) += 2.0;
+        }
+        obs.tag_ids.push_back(tag_id);
+        obs.corner_ids.push_back(corner_id);
+        obs.keypoints.push_back(z);
+        obs.object_points.push_back(p_F);
+      }
+    }
+  }
+  obs.frame_offsets.push_back(obs.nb_corners());
+
+  calib_stats_t stats;
+  MU_CHECK(calib_stats_init(stats, obs, cam, poses) == 0);
+  calib_stats_print(stats);
+
+  // Global and per frame
+  MU_CHECK(stats.nb_residuals == nb_frames * 24);
+  MU_CHECK(stats.corner_errors.size() == obs.nb_corners());
+  MU_CHECK(fabs(stats.rmse - sqrt(4.0 / 6.0)) < 1e-6);
+  MU_CHECK(fabs(stats.max - 2.0) < 1e-6);
+  for (size_t k = 0; k < nb_frames; k++) {
+    MU_CHECK(stats.frame_nb_residuals[k] == 24);
+    MU_CHECK(fabs(stats.frame_rmse[k] - sqrt(4.0 / 6.0)) < 1e-6);
+  }
+
+  // Per tag
+  MU_CHECK(stats.tag_rmse.size() == 6);
+  for (const auto &kv : stats.tag_rmse) {
+    MU_CHECK(stats.tag_nb_residuals[kv.first] == nb_frames * 4);
+    MU_CHECK(fabs(kv.second - ((kv.first == 3) ? 2.0 : 0.0)) < 1e-6);
+  }
+
+  // Per corner, aligned with the observations
+  for (size_t i = 0; i < obs.nb_corners(); i++) {
+    const real_t expected = (obs.tag_ids[i] == 3) ? 2.0 : 0.0;
+    MU_CHECK(fabs(stats.corner_errors[i] - expected) < 1e-6);
+  }
+
+  // Per image region
+  MU_CHECK(stats.grid_nb_residuals.rows() == 6);
+  MU_CHECK(stats.grid_nb_residuals.cols() == 8);
+  MU_CHECK((size_t) stats.grid_nb_residuals.sum() == stats.nb_residuals);
+  const matx_t grid_err_sq = stats.grid_rmse.array().square();
+  const real_t err_sq_sum =
+      (stats.grid_nb_residuals.array() * grid_err_sq.array()).sum();
+  MU_CHECK(fabs(err_sq_sum - nb_frames * 4 * 4.0) < 1e-6);
+
+  // Mismatched poses
+  poses.pop_back();
+  MU_CHECK(calib_stats_init(stats, obs, cam, poses) == -1);
+
+  return 0;
+}
+
 // int test_draw_calib_validation() {
 //   // Setup camera geometry
 //   // -- Camera model
@@ -383,6 +739,10 @@ void test_suite() {
   MU_ADD_TEST(test_preprocess_and_load_camera_data);
   MU_ADD_TEST(test_preprocess_and_load_stereo_data);
   MU_ADD_TEST(test_load_multicam_calib_data);
+  MU_ADD_TEST(test_camera_project_batch);
+  MU_ADD_TEST(test_camera_undistort_batch);
+  MU_ADD_TEST(test_camera_batch_benchmark);
+  MU_ADD_TEST(test_calib_stats);
   // MU_ADD_TEST(test_draw_calib_validation);
   // MU_ADD_TEST(test_validate_intrinsics);
   // MU_ADD_TEST(test_validate_stereo);
@@ -0,0 +1,587 @@
+#include "munit.hpp"
+#include "calib_mocap_marker.hpp"
+
+namespace yac {
+
+struct test_data_t {
+  calib_params_t cam;
+  aprilgrids_t grids;
+  mat4s_t T_WM;
+  mat4_t T_MC;
+  mat4_t T_WF;
+};
+
+static aprilgrid_t simulate_aprilgrid(const calib_params_t &cam,
+                                      const timestamp_t ts,
+                                      const mat4_t &T_CF) {
+  aprilgrid_t grid{ts, 6, 6, 0.088, 0.3};
+
+  // Transform all target corners to camera frame and project in one batch
+  camera_model_t model = PINHOLE_RADTAN4;
+  calib_camera_model(cam, model);
+  vec3s_t object_points;
+  aprilgrid_object_points(grid, object_points);
+  const size_t n = object_points.size();
+  std::vector<real_t> x(n), y(n), z(n), u(n), v(n);
+  std::vector<uint8_t> valid(n);
+  for (size_t i = 0; i < n; i++) {
+    const vec3_t p_C = tf_point(T_CF, object_points[i]);
+    x[i] = p_C(0);
+    y[i] = p_C(1);
+    z[i] = p_C(2);
+  }
+  camera_project_batch(model,
+                       cam.proj_params.data(),
+                       cam.dist_params.data(),
+                       n,
+                       x.data(),
+                       y.data(),
+                       z.data(),
+                       u.data(),
+                       v.data(),
+                       valid.data());
+
+  for (int tag_id = 0; tag_id < 36; tag_id++) {
+    std::vector<cv::Point2f> keypoints;
+    for (int j = 0; j < 4; j++) {
+      const size_t i = tag_id * 4 + j;
+      keypoints.emplace_back(u[i] + 0.5, v[i] - 0.25);
+    }
+    aprilgrid_add(grid, tag_id, keypoints);
+  }
+  grid.T_CF = T_CF;
+
+  return grid;
+}
+
+static test_data_t setup_test_data() {
+  test_data_t data;
+
+  // Camera
+  const vec4_t proj_params{458.0, 457.0, 367.0, 248.0};
+  const vec4_t dist_params{-0.28, 0.07, 0.0002, 0.00002};
+  data.cam = calib_params_t{"pinhole", "radtan4", 752, 480,
+                            proj_params, dist_params};
+
+  // Marker to camera extrinsics and fiducial pose
+  const vec3_t euler{-90.0, 0.0, -90.0};
+  data.T_MC = tf(euler321(deg2rad(euler)), vec3_t{0.01, 0.02, 0.03});
+  data.T_WF = tf(I(3), vec3_t{0.0, 0.0, 0.0});
+
+  // Simulate AprilGrid observations from camera poses looking at the target
+  for (int k = 0; k < 10; k++) {
+    const vec3_t r_WC{0.2 + 0.02 * k, 0.2 - 0.01 * k, -1.5};
+    const mat4_t T_WC = tf(I(3), r_WC);
+    const mat4_t T_CF = T_WC.inverse() * data.T_WF;
+
+    const aprilgrid_t grid = simulate_aprilgrid(data.cam, k, T_CF);
+    data.grids.push_back(grid);
+    data.T_WM.push_back(T_WC * data.T_MC.inverse());
+  }
+
+  return data;
+}
+
+int test_evaluate_mocap_marker_cost() {
+  test_data_t data = setup_test_data();
+  calib_obs_t obs;
+  MU_CHECK(calib_obs_init(obs, data.grids) == 0);
+
+  // Form ceres problem with the same residuals
+  calib_pose_t T_MC_param{data.T_MC};
+  calib_pose_t T_WF_param{data.T_WF};
+  std::vector<calib_pose_t> T_WM_params;
+  for (const auto &T_WM : data.T_WM) {
+    T_WM_params.emplace_back(T_WM);
+  }
+
+  ceres::Problem problem;
+  for (size_t k = 0; k < obs.nb_frames(); k++) {
+    for (size_t i = obs.frame_offsets[k]; i < obs.frame_offsets[k + 1]; i++) {
+      const auto residual = new mocap_marker_residual_t{data.cam.proj_model,
+                                                        data.cam.dist_model,
+                                                        obs.keypoints[i],
+                                                        obs.object_points[i]};
+      const auto cost_func =
+          new ceres::AutoDiffCostFunction<mocap_marker_residual_t,
+                                          2, 4, 4, 4, 3, 4, 3, 4, 3>(residual);
+      problem.AddResidualBlock(cost_func,
+                               NULL,
+                               data.cam.proj_params.data(),
+                               data.cam.dist_params.data(),
+                               T_MC_param.q,
+                               T_MC_param.r,
+                               T_WM_params[k].q,
+                               T_WM_params[k].r,
+                               T_WF_param.q,
+                               T_WF_param.r);
+    }
+  }
+  double expected = 0.0;
+  problem.Evaluate(ceres::Problem::EvaluateOptions(),
+                   &expected,
+                   NULL,
+                   NULL,
+                   NULL);
+
+  // Test direct evaluation
+  struct timespec t_start = tic();
+  const double cost = evaluate_mocap_marker_cost(obs,
+                                                 data.cam,
+                                                 data.T_WM,
+                                                 data.T_MC,
+                                                 data.T_WF);
+  printf("evaluate_mocap_marker_cost: %f [s]\n", toc(&t_start));
+  MU_CHECK(expected > 0.0);
+  MU_CHECK(fabs(cost - expected) < 1e-6 * expected);
+
+  // Test evaluation with the fiducial pose from the first AprilGrid
+  const double cost2 = evaluate_mocap_marker_cost(data.grids,
+                                                  data.cam,
+                                                  data.T_WM,
+                                                  data.T_MC);
+  MU_CHECK(fabs(cost2 - expected) < 1e-6 * expected);
+
+  return 0;
+}
+
+int test_lerp_body_poses() {
+  // Body moves along x at 1 [m/s] from t = 1 [s] to t = 3 [s]
+  timestamps_t body_timestamps;
+  mat4s_t body_poses;
+  for (int k = 0; k <= 20; k++) {
+    const timestamp_t ts = 1e9 + k * 1e8;
+    body_timestamps.push_back(ts);
+    body_poses.push_back(tf(I(3), vec3_t{ts * 1e-9, 0.0, 0.0}));
+  }
+
+  // Camera clock lags the body clock by 0.5 [s], i.e. a negative offset
+  const int64_t ts_offset = -0.5e9;
+  aprilgrids_t grids;
+  for (const timestamp_t ts : {0.4e9, 1.25e9, 2.45e9, 2.6e9}) {
+    grids.emplace_back(ts, 6, 6, 0.088, 0.3);
+  }
+
+  // Only the AprilGrids within the shifted body poses are lerped
+  aprilgrids_t lerped_grids;
+  mat4s_t lerped_poses;
+  lerp_body_poses(grids,
+                  body_timestamps,
+                  body_poses,
+                  lerped_grids,
+                  lerped_poses,
+                  ts_offset);
+  MU_CHECK(lerped_grids.size() == 2);
+  MU_CHECK(lerped_poses.size() == 2);
+  MU_CHECK(lerped_grids[0].timestamp == 1.25e9);
+  MU_CHECK(lerped_grids[1].timestamp == 2.45e9);
+  MU_CHECK(fabs(tf_trans(lerped_poses[0])(0) - 1.75) < 1e-6);
+  MU_CHECK(fabs(tf_trans(lerped_poses[1])(0) - 2.95) < 1e-6);
+
+  return 0;
+}
+
+int test_calib_mocap_marker_sweep() {
+  test_data_t data = setup_test_data();
+
+  // Simulate camera moving at constant velocity, the body poses are
+  // timestamped with a clock that lags the camera by `ts_offset`
+  const int64_t ts_offset = 20e6;
+  const auto T_WC_at = [](const int64_t ts) {
+    const real_t t = ts * 1e-9;
+    return tf(I(3), vec3_t{0.1 + 0.1 * t, 0.2 - 0.05 * t, -1.5});
+  };
+
+  timestamps_t body_timestamps;
+  mat4s_t body_poses;
+  for (int64_t ts = 0; ts <= 3e9; ts += 10e6) {
+    body_timestamps.push_back(ts);
+    body_poses.push_back(T_WC_at(ts + ts_offset) * data.T_MC.inverse());
+  }
+
+  aprilgrids_t grids;
+  for (int64_t ts = 0; ts <= 3e9; ts += 100e6) {
+    const mat4_t T_CF = T_WC_at(ts).inverse() * data.T_WF;
+    grids.push_back(simulate_aprilgrid(data.cam, ts, T_CF));
+  }
+
+  // Sweep time offsets
+  std::vector<int64_t> ts_offsets;
+  for (int64_t dt = -50e6; dt <= 50e6; dt += 10e6) {
+    ts_offsets.push_back(dt);
+  }
+
+  mocap_marker_sweep_t sweep;
+  struct timespec t_start = tic();
+  int retval = calib_mocap_marker_sweep(grids,
+                                        body_timestamps,
+                                        body_poses,
+                                        data.cam,
+                                        data.T_MC,
+                                        data.T_WF,
+                                        ts_offsets,
+                                        sweep);
+  printf("calib_mocap_marker_sweep: %f [s]\n", toc(&t_start));
+  MU_CHECK(retval == 0);
+  MU_CHECK(sweep.costs.size() == ts_offsets.size());
+  MU_CHECK(sweep.rmses.size() == ts_offsets.size());
+  MU_CHECK(sweep.nb_frames > 0);
+  MU_CHECK(sweep.nb_frames < grids.size());
+  MU_CHECK(sweep.ts_offsets[sweep.best_idx] == ts_offset);
+
+  // Sweeping a single offset matches lerping the body poses directly
+  aprilgrids_t lerped_grids;
+  mat4s_t lerped_poses;
+  lerp_body_poses(grids,
+                  body_timestamps,
+                  body_poses,
+                  lerped_grids,
+                  lerped_poses);
+  calib_obs_t lerped_obs;
+  MU_CHECK(calib_obs_init(lerped_obs, lerped_grids) == 0);
+  const double expected = evaluate_mocap_marker_cost(lerped_obs,
+                                                     data.cam,
+                                                     lerped_poses,
+                                                     data.T_MC,
+                                                     data.T_WF);
+
+  retval = calib_mocap_marker_sweep(grids,
+                                    body_timestamps,
+                                    body_poses,
+                                    data.cam,
+                                    data.T_MC,
+                                    data.T_WF,
+                                    {0},
+                                    sweep);
+  MU_CHECK(retval == 0);
+  MU_CHECK(sweep.nb_frames == lerped_grids.size());
+  MU_CHECK(fabs(sweep.costs[0] - expected) < 1e-6 * expected);
+
+  return 0;
+}
+
+int test_calib_mocap_marker_solve_td() {
+  test_data_t data = setup_test_data();
+
+  // Simulate camera moving and rotating, the body poses are timestamped with
+  // a clock that lags the camera by `ts_offset`
+  const int64_t ts_offset = 20e6;
+  const auto T_WC_at = [](const int64_t ts) {
+    const real_t t = ts * 1e-9;
+    const vec3_t rpy{deg2rad(5.0 * sin(t)), deg2rad(5.0 * cos(2.0 * t)), 0.0};
+    const vec3_t r{0.1 + 0.1 * sin(2.0 * t), 0.1 * cos(1.5 * t), -1.5};
+    return tf(euler321(rpy), r);
+  };
+
+  timestamps_t body_timestamps;
+  mat4s_t body_poses;
+  for (int64_t ts = 0; ts <= 3e9; ts += 10e6) {
+    body_timestamps.push_back(ts);
+    body_poses.push_back(T_WC_at(ts + ts_offset) * data.T_MC.inverse());
+  }
+
+  aprilgrids_t grids;
+  for (int64_t ts = 0; ts <= 3e9; ts += 100e6) {
+    const mat4_t T_CF = T_WC_at(ts).inverse() * data.T_WF;
+    grids.push_back(simulate_aprilgrid(data.cam, ts, T_CF));
+  }
+
+  // Perturb marker to camera extrinsics and estimate time offset
+  const mat4_t dT = tf(euler321(deg2rad(vec3_t{1.0, -1.0, 1.0})),
+                       vec3_t{0.01, -0.01, 0.01});
+  mat4_t T_MC = data.T_MC * dT;
+  mat4_t T_WF = data.T_WF;
+  real_t td = 0.0;
+  int retval = calib_mocap_marker_solve(grids,
+                                        body_timestamps,
+                                        body_poses,
+                                        data.cam,
+                                        T_MC,
+                                        T_WF,
+                                        td,
+                                        0.05);
+  MU_CHECK(retval == 0);
+  MU_CHECK(fabs(td - ts_offset * 1e-9) < 1e-3);
+
+  return 0;
+}
+
+int test_calib_mocap_marker_init() {
+  // Marker to camera extrinsics and fiducial pose
+  const vec3_t euler_MC{-80.0, 5.0, -95.0};
+  const mat4_t T_MC_gnd = tf(euler321(deg2rad(euler_MC)),
+                             vec3_t{0.01, 0.02, 0.03});
+  const mat4_t T_WF_gnd = tf(euler321(deg2rad(vec3_t{0.0, 0.0, 10.0})),
+                             vec3_t{1.0, 2.0, 0.5});
+
+  // Simulate marker poses rotating about different axes
+  mat4s_t T_WM;
+  mat4s_t T_CF;
+  for (int k = 0; k < 20; k++) {
+    const real_t t = k * 0.1;
+    const vec3_t rpy{deg2rad(20.0 * sin(t)), deg2rad(15.0 * cos(2.0 * t)), t};
+    const vec3_t r{0.5 * sin(t), 0.5 * cos(t), 1.5 + 0.1 * t};
+    T_WM.push_back(tf(euler321(rpy), r));
+    T_CF.push_back(T_MC_gnd.inverse() * T_WM.back().inverse() * T_WF_gnd);
+  }
+
+  // Initialize
+  mat4_t T_MC;
+  mat4_t T_WF;
+  struct timespec t_start = tic();
+  MU_CHECK(calib_mocap_marker_init(T_WM, T_CF, T_MC, T_WF) == 0);
+  printf("calib_mocap_marker_init: %f [s]\n", toc(&t_start));
+  MU_CHECK((T_MC - T_MC_gnd).norm() < 1e-6);
+  MU_CHECK((T_WF - T_WF_gnd).norm() < 1e-6);
+
+  // Rotation about a single axis is degenerate
+  mat4s_t T_WM_yaw;
+  mat4s_t T_CF_yaw;
+  for (int k = 0; k < 20; k++) {
+    const vec3_t rpy{0.0, 0.0, k * 0.1};
+    const vec3_t r{0.5 * sin(k * 0.1), 0.5 * cos(k * 0.1), 1.5};
+    T_WM_yaw.push_back(tf(euler321(rpy), r));
+    const mat4_t T_MW = T_WM_yaw.back().inverse();
+    T_CF_yaw.push_back(T_MC_gnd.inverse() * T_MW * T_WF_gnd);
+  }
+  MU_CHECK(calib_mocap_marker_init(T_WM_yaw, T_CF_yaw, T_MC, T_WF) == -1);
+
+  // So is mostly yaw with a sub-degree roll and pitch wobble
+  mat4s_t T_WM_wobble;
+  mat4s_t T_CF_wobble;
+  for (int k = 0; k < 20; k++) {
+    const real_t wobble = deg2rad(0.5);
+    const vec3_t rpy{wobble * sin(k * 0.7), wobble * cos(k * 0.9), k * 0.1};
+    const vec3_t r{0.5 * sin(k * 0.1), 0.5 * cos(k * 0.1), 1.5};
+    T_WM_wobble.push_back(tf(euler321(rpy), r));
+    const mat4_t T_MW = T_WM_wobble.back().inverse();
+    T_CF_wobble.push_back(T_MC_gnd.inverse() * T_MW * T_WF_gnd);
+  }
+  MU_CHECK(calib_mocap_marker_init(T_WM_wobble, T_CF_wobble, T_MC, T_WF) ==
+           -1);
+
+  return 0;
+}
+
+int test_calib_covar_dense() {
+  // Simulate camera rotating about different axes, else the translations of
+  // T_MC and T_WF are not observable
+  test_data_t data = setup_test_data();
+  data.grids.clear();
+  data.T_WM.clear();
+  for (int k = 0; k < 20; k++) {
+    const real_t t = k * 0.3;
+    const vec3_t rpy{deg2rad(15.0 * sin(t)), deg2rad(15.0 * cos(2.0 * t)), t};
+    const vec3_t r_WC{0.1 * sin(t), 0.1 * cos(t), -1.5};
+    const mat4_t T_WC = tf(euler321(rpy), r_WC);
+    const mat4_t T_CF = T_WC.inverse() * data.T_WF;
+    data.grids.push_back(simulate_aprilgrid(data.cam, k, T_CF));
+    data.T_WM.push_back(T_WC * data.T_MC.inverse());
+  }
+
+  calib_obs_t obs;
+  MU_CHECK(calib_obs_init(obs, data.grids) == 0);
+
+  // Form mocap marker problem with constant marker poses
+  calib_pose_t T_MC_param{data.T_MC};
+  calib_pose_t T_WF_param{data.T_WF};
+  std::vector<calib_pose_t> T_WM_params;
+  for (const auto &T_WM : data.T_WM) {
+    T_WM_params.emplace_back(T_WM);
+  }
+
+  ceres::Problem::Options problem_opts;
+  problem_opts.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem{problem_opts};
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+  for (size_t k = 0; k < obs.nb_frames(); k++) {
+    for (size_t i = obs.frame_offsets[k]; i < obs.frame_offsets[k + 1]; i++) {
+      const auto residual = new mocap_marker_residual_t{data.cam.proj_model,
+                                                        data.cam.dist_model,
+                                                        obs.keypoints[i],
+                                                        obs.object_points[i]};
+      const auto cost_func =
+          new ceres::AutoDiffCostFunction<mocap_marker_residual_t,
+                                          2, 4, 4, 4, 3, 4, 3, 4, 3>(residual);
+      problem.AddResidualBlock(cost_func,
+                               NULL,
+                               data.cam.proj_params.data(),
+                               data.cam.dist_params.data(),
+                               T_MC_param.q,
+                               T_MC_param.r,
+                               T_WM_params[k].q,
+                               T_WM_params[k].r,
+                               T_WF_param.q,
+                               T_WF_param.r);
+    }
+    problem.SetParameterization(T_WM_params[k].q, &quaternion_parameterization);
+    problem.SetParameterBlockConstant(T_WM_params[k].q);
+    problem.SetParameterBlockConstant(T_WM_params[k].r);
+  }
+  problem.SetParameterization(T_MC_param.q, &quaternion_parameterization);
+  problem.SetParameterization(T_WF_param.q, &quaternion_parameterization);
+
+  // Dense covariance
+  std::vector<double *> blocks = {data.cam.proj_params.data(),
+                                  data.cam.dist_params.data(),
+                                  T_MC_param.q,
+                                  T_MC_param.r,
+                                  T_WF_param.q,
+                                  T_WF_param.r};
+  matx_t covar;
+  struct timespec t_start = tic();
+  MU_CHECK(calib_covar_dense(&problem, blocks, covar) == 0);
+  printf("calib_covar_dense: %f [s]\n", toc(&t_start));
+  MU_CHECK(covar.rows() == 20);
+  MU_CHECK(covar.cols() == 20);
+
+  // Compare against ceres covariance
+  ceres::Covariance::Options covar_options;
+  covar_options.algorithm_type = ceres::DENSE_SVD;
+  ceres::Covariance ceres_covar(covar_options);
+  std::vector<std::pair<const double *, const double *>> covar_blocks;
+  covar_blocks.push_back({T_MC_param.q, T_MC_param.q});
+  covar_blocks.push_back({T_MC_param.r, T_MC_param.r});
+  MU_CHECK(ceres_covar.Compute(covar_blocks, &problem));
+
+  double q_MC_covar[3 * 3] = {0};
+  double r_MC_covar[3 * 3] = {0};
+  ceres_covar.GetCovarianceBlockInTangentSpace(T_MC_param.q,
+                                               T_MC_param.q,
+                                               q_MC_covar);
+  ceres_covar.GetCovarianceBlockInTangentSpace(T_MC_param.r,
+                                               T_MC_param.r,
+                                               r_MC_covar);
+  const Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> q_MC_expected(
+      q_MC_covar);
+  const Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> r_MC_expected(
+      r_MC_covar);
+  const mat3_t q_MC_diff = covar.block(8, 8, 3, 3) - q_MC_expected;
+  const mat3_t r_MC_diff = covar.block(11, 11, 3, 3) - r_MC_expected;
+  MU_CHECK(q_MC_diff.norm() < 1e-6 * q_MC_expected.norm());
+  MU_CHECK(r_MC_diff.norm() < 1e-6 * r_MC_expected.norm());
+
+  return 0;
+}
+
+int test_calib_mocap_marker_solve_double_sphere() {
+  // Double sphere camera, only the first two distortion parameters are used
+  test_data_t data = setup_test_data();
+  const vec4_t proj_params{350.0, 350.0, 376.0, 240.0};
+  const vec4_t dist_params{-0.2, 0.6, 0.0, 0.0};
+  data.cam = calib_params_t{"double_sphere", "none", 752, 480,
+                            proj_params, dist_params};
+
+  // Simulate camera rotating about different axes, see
+  // test_calib_covar_dense()
+  data.grids.clear();
+  data.T_WM.clear();
+  for (int k = 0; k < 20; k++) {
+    const real_t t = k * 0.3;
+    const vec3_t rpy{deg2rad(15.0 * sin(t)), deg2rad(15.0 * cos(2.0 * t)), t};
+    const vec3_t r_WC{0.1 * sin(t), 0.1 * cos(t), -1.5};
+    const mat4_t T_WC = tf(euler321(rpy), r_WC);
+    const mat4_t T_CF = T_WC.inverse() * data.T_WF;
+    data.grids.push_back(simulate_aprilgrid(data.cam, k, T_CF));
+    data.T_WM.push_back(T_WC * data.T_MC.inverse());
+  }
+
+  // Perturb camera parameters and marker to camera extrinsics
+  calib_params_t cam = data.cam;
+  cam.proj_params += vec4_t{5.0, -5.0, 2.0, -2.0};
+  cam.dist_params += vec4_t{0.02, -0.02, 0.0, 0.0};
+  const mat4_t dT = tf(euler321(deg2rad(vec3_t{1.0, -1.0, 1.0})),
+                       vec3_t{0.01, -0.01, 0.01});
+  mat4s_t T_WM = data.T_WM;
+  mat4_t T_MC = data.T_MC * dT;
+  mat4_t T_WF = data.T_WF;
+  calib_solver_options_t opts;
+  opts.verbose = false;
+  int retval = calib_mocap_marker_solve(data.grids,
+                                        cam,
+                                        T_WM,
+                                        T_MC,
+                                        T_WF,
+                                        opts);
+  MU_CHECK(retval == 0);
+
+  // The simulated keypoints are offset by (0.5, -0.25) [px], which the
+  // principal point absorbs. The unused distortion parameters stay put.
+  const vec4_t proj_expected = proj_params + vec4_t{0.0, 0.0, 0.5, -0.25};
+  MU_CHECK((cam.proj_params - proj_expected).norm() < 1e-2);
+  MU_CHECK(fabs(cam.dist_params(0) - dist_params(0)) < 1e-4);
+  MU_CHECK(fabs(cam.dist_params(1) - dist_params(1)) < 1e-4);
+  MU_CHECK(cam.dist_params(2) == 0.0);
+  MU_CHECK(cam.dist_params(3) == 0.0);
+  MU_CHECK((tf_trans(T_MC) - tf_trans(data.T_MC)).norm() < 1e-3);
+
+  // Covariance is full rank with the unused distortion parameters held
+  // constant, it has 2 distortion parameters instead of 4
+  calib_pose_t T_MC_param{T_MC};
+  calib_pose_t T_WF_param{T_WF};
+  std::vector<calib_pose_t> T_WM_params;
+  for (const auto &pose : T_WM) {
+    T_WM_params.emplace_back(pose);
+  }
+
+  calib_obs_t obs;
+  MU_CHECK(calib_obs_init(obs, data.grids) == 0);
+  ceres::Problem::Options problem_opts;
+  problem_opts.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem{problem_opts};
+  ceres::EigenQuaternionParameterization quaternion_parameterization;
+  for (size_t k = 0; k < obs.nb_frames(); k++) {
+    for (size_t i = obs.frame_offsets[k]; i < obs.frame_offsets[k + 1]; i++) {
+      const auto residual = new mocap_marker_residual_t{cam.proj_model,
+                                                        cam.dist_model,
+                                                        obs.keypoints[i],
+                                                        obs.object_points[i]};
+      const auto cost_func =
+          new ceres::AutoDiffCostFunction<mocap_marker_residual_t,
+                                          2, 4, 4, 4, 3, 4, 3, 4, 3>(residual);
+      problem.AddResidualBlock(cost_func,
+                               NULL,
+                               cam.proj_params.data(),
+                               cam.dist_params.data(),
+                               T_MC_param.q,
+                               T_MC_param.r,
+                               T_WM_params[k].q,
+                               T_WM_params[k].r,
+                               T_WF_param.q,
+                               T_WF_param.r);
+    }
+    problem.SetParameterization(T_WM_params[k].q, &quaternion_parameterization);
+    problem.SetParameterBlockConstant(T_WM_params[k].q);
+    problem.SetParameterBlockConstant(T_WM_params[k].r);
+  }
+  problem.SetParameterization(T_MC_param.q, &quaternion_parameterization);
+  problem.SetParameterization(T_WF_param.q, &quaternion_parameterization);
+  calib_dist_params_setup(&problem, DOUBLE_SPHERE, cam.dist_params.data());
+
+  std::vector<double *> blocks = {cam.proj_params.data(),
+                                  cam.dist_params.data(),
+                                  T_MC_param.q,
+                                  T_MC_param.r,
+                                  T_WF_param.q,
+                                  T_WF_param.r};
+  matx_t covar;
+  MU_CHECK(calib_covar_dense(&problem, blocks, covar) == 0);
+  MU_CHECK(covar.rows() == 18);
+  MU_CHECK(covar.cols() == 18);
+
+  return 0;
+}
+
+void test_suite() {
+  MU_ADD_TEST(test_evaluate_mocap_marker_cost);
+  MU_ADD_TEST(test_lerp_body_poses);
+  MU_ADD_TEST(test_calib_mocap_marker_sweep);
+  MU_ADD_TEST(test_calib_mocap_marker_solve_td);
+  MU_ADD_TEST(test_calib_mocap_marker_init);
+  MU_ADD_TEST(test_calib_covar_dense);
+  MU_ADD_TEST(test_calib_mocap_marker_solve_double_sphere);
+}
+
+} // namespace yac
+
+MU_RUN_TESTS(yac::test_suite);
@@ -121,6 +121,247 @@ int test_calib_mono_solve() {
   return 0;
 }
 
+int test_calib_mono_solve_early_stop() {
+  // Load calibration data
+  std::vector<aprilgrid_t> aprilgrids;
+  std::vector<timestamp_t> timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  // Setup camera intrinsics and distortion
+  calib_params_t calib_params("pinhole", "radtan4",
+                              752, 480, 98.0, 73.0);
+
+  // Test RMSE plateau, the callback terminates the solver before the
+  // function tolerance or the max number of iterations are reached
+  calib_solver_options_t opts;
+  opts.rmse_plateau_tol = 1e-2;
+  opts.rmse_plateau_iters = 2;
+  opts.verbose = false;
+
+  mat4s_t T_CF;
+  ceres::Solver::Summary summary;
+  retval = calib_mono_solve(aprilgrids, calib_params, T_CF, opts, &summary);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() == T_CF.size());
+  MU_CHECK(summary.termination_type == ceres::USER_SUCCESS);
+  MU_CHECK((int) summary.iterations.size() - 1 < opts.max_iter);
+  MU_CHECK(summary.final_cost < summary.initial_cost);
+
+  return 0;
+}
+
+int test_calib_mono_solve_deadline() {
+  // Load calibration data
+  std::vector<aprilgrid_t> aprilgrids;
+  std::vector<timestamp_t> timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  // Setup camera intrinsics and distortion
+  calib_params_t calib_params("pinhole", "radtan4",
+                              752, 480, 98.0, 73.0);
+
+  // Test deadline, which has already passed by the first iteration so the
+  // solver stops straight after evaluating the initial estimate
+  calib_solver_options_t opts;
+  opts.deadline = 1e-6;
+  opts.verbose = false;
+
+  mat4s_t T_CF;
+  ceres::Solver::Summary summary;
+  retval = calib_mono_solve(aprilgrids, calib_params, T_CF, opts, &summary);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() == T_CF.size());
+  MU_CHECK(summary.termination_type == ceres::USER_SUCCESS);
+  MU_CHECK(summary.iterations.size() <= 1);
+
+  return 0;
+}
+
+int test_calib_mono_analytic_residual() {
+  // Load calibration data
+  aprilgrids_t aprilgrids;
+  timestamps_t timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  const std::vector<std::pair<std::string, std::string>> models = {
+      {"pinhole", "radtan4"},
+      {"pinhole", "equi4"},
+      {"double_sphere", "none"}};
+  for (const auto &model : models) {
+    const std::string &proj_model = model.first;
+    const std::string &dist_model = model.second;
+    calib_params_t cam(proj_model, dist_model, 752, 480, 98.0, 73.0);
+    camera_model_t cam_model;
+    MU_CHECK(calib_camera_model(cam, cam_model) == 0);
+
+    // Residual of first corner
+    const auto &grid = aprilgrids[0];
+    vec3_t p_F;
+    MU_CHECK(aprilgrid_object_point(grid, grid.ids[0], 0, p_F) == 0);
+    const vec2_t z = grid.keypoints[0];
+    calib_pose_t pose{grid.T_CF};
+    double *params[4] = {cam.proj_params.data(),
+                         cam.dist_params.data(),
+                         pose.q,
+                         pose.r};
+
+    // Analytic jacobians
+    calib_mono_analytic_residual_t analytic{cam_model, z, p_F};
+    mat_t<2, 4, Eigen::RowMajor> J_proj;
+    mat_t<2, 4, Eigen::RowMajor> J_dist;
+    mat_t<2, 4, Eigen::RowMajor> J_rot;
+    mat_t<2, 3, Eigen::RowMajor> J_trans;
+    double *J[4] = {J_proj.data(), J_dist.data(), J_rot.data(), J_trans.data()};
+    vec2_t r;
+    MU_CHECK(analytic.Evaluate(params, r.data(), J));
+
+    // Auto diff jacobians
+    const auto residual = new calib_mono_residual_t{proj_model, dist_model,
+                                                    z, p_F};
+    ceres::AutoDiffCostFunction<calib_mono_residual_t, 2, 4, 4, 4, 3>
+        autodiff{residual};
+    mat_t<2, 4, Eigen::RowMajor> J_proj_ad;
+    mat_t<2, 4, Eigen::RowMajor> J_dist_ad;
+    mat_t<2, 4, Eigen::RowMajor> J_rot_ad;
+    mat_t<2, 3, Eigen::RowMajor> J_trans_ad;
+    double *J_ad[4] = {J_proj_ad.data(),
+                       J_dist_ad.data(),
+                       J_rot_ad.data(),
+                       J_trans_ad.data()};
+    vec2_t r_ad;
+    MU_CHECK(autodiff.Evaluate(params, r_ad.data(), J_ad));
+    MU_CHECK((r - r_ad).norm() < 1e-8);
+    MU_CHECK((J_proj - J_proj_ad).norm() < 1e-6);
+    MU_CHECK((J_dist - J_dist_ad).norm() < 1e-6);
+    MU_CHECK((J_trans - J_trans_ad).norm() < 1e-6);
+    MU_CHECK((J_rot - J_rot_ad).norm() < 1e-6);
+  }
+
+  return 0;
+}
+
+int test_calib_mono_solve_analytic() {
+  // Load calibration data
+  aprilgrids_t aprilgrids;
+  timestamps_t timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  // Solve with auto diff and analytic jacobians
+  calib_solver_options_t opts;
+  opts.verbose = false;
+  calib_params_t cam_ad("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  mat4s_t T_CF_ad;
+  ceres::Solver::Summary summary_ad;
+  retval = calib_mono_solve(aprilgrids, cam_ad, T_CF_ad, opts, &summary_ad);
+  MU_CHECK(retval == 0);
+
+  opts.analytic_jacobians = true;
+  calib_params_t cam("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  mat4s_t T_CF;
+  ceres::Solver::Summary summary;
+  retval = calib_mono_solve(aprilgrids, cam, T_CF, opts, &summary);
+  MU_CHECK(retval == 0);
+
+  // Time spent evaluating residuals and jacobians per iteration
+  const double t_ad = summary_ad.jacobian_evaluation_time_in_seconds /
+                      summary_ad.iterations.size();
+  const double t_analytic = summary.jacobian_evaluation_time_in_seconds /
+                            summary.iterations.size();
+  printf("auto diff jacobian evaluation: %f [s]\n", t_ad);
+  printf("analytic jacobian evaluation:  %f [s]\n", t_analytic);
+  printf("speed up: %.2fx\n", t_ad / t_analytic);
+  printf("auto diff solve: %f [s]\n", summary_ad.total_time_in_seconds);
+  printf("analytic solve:  %f [s]\n", summary.total_time_in_seconds);
+
+  // Both should converge to the same solution
+  MU_CHECK((cam.proj_params - cam_ad.proj_params).norm() < 1e-2);
+  MU_CHECK((cam.dist_params - cam_ad.dist_params).norm() < 1e-4);
+
+  return 0;
+}
+
+int test_calib_mono_solve_telemetry() {
+  // Load calibration data
+  aprilgrids_t aprilgrids;
+  timestamps_t timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  // Solve with telemetry
+  const std::string telemetry_path = "/tmp/calib_mono_telemetry.jsonl";
+  remove(telemetry_path.c_str());
+  calib_solver_options_t opts;
+  opts.verbose = false;
+  opts.telemetry = telemetry_path;
+  calib_params_t calib_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  mat4s_t poses;
+  MU_CHECK(calib_mono_solve(aprilgrids, calib_params, poses, opts) == 0);
+
+  // One line per iteration followed by a summary line
+  std::ifstream telemetry(telemetry_path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(telemetry, line)) {
+    lines.push_back(line);
+  }
+  MU_CHECK(lines.size() > 2);
+  for (size_t i = 0; i < lines.size(); i++) {
+    const bool last = (i == lines.size() - 1);
+    const std::string type = (last) ? "summary" : "iteration";
+    MU_CHECK(lines[i].front() == '{' && lines[i].back() == '}');
+    MU_CHECK(lines[i].find("\"solve\": \"mono\"") != std::string::npos);
+    MU_CHECK(lines[i].find("\"type\": \"" + type + "\"") != std::string::npos);
+    MU_CHECK(lines[i].find("\"nb_residual_blocks\"") != std::string::npos);
+  }
+
+  return 0;
+}
+
+int test_calib_telemetry() {
+  const std::string telemetry_path = "/tmp/calib_telemetry.jsonl";
+  remove(telemetry_path.c_str());
+
+  // Sink stays open across iterations, non-finite values are written as null
+  {
+    calib_telemetry_t telemetry{telemetry_path, "test", 10, 1, 1};
+    ceres::IterationSummary summary;
+    summary.iteration = 0;
+    summary.cost = 1.0;
+    summary.cost_change = NAN;
+    MU_CHECK(telemetry(summary) == ceres::SOLVER_CONTINUE);
+    summary.iteration = 1;
+    summary.cost = INFINITY;
+    MU_CHECK(telemetry(summary) == ceres::SOLVER_CONTINUE);
+  }
+
+  std::ifstream file(telemetry_path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(file, line)) {
+    lines.push_back(line);
+  }
+  MU_CHECK(lines.size() == 2);
+  MU_CHECK(lines[0].find("\"cost\": 1,") != std::string::npos);
+  MU_CHECK(lines[0].find("\"cost_change\": null") != std::string::npos);
+  MU_CHECK(lines[1].find("\"cost\": null") != std::string::npos);
+  MU_CHECK(lines[1].find("\"rmse\": null") != std::string::npos);
+  for (const auto &l : lines) {
+    MU_CHECK(l.find("nan") == std::string::npos);
+    MU_CHECK(l.find("inf") == std::string::npos);
+  }
+
+  return 0;
+}
+
 int test_calib_mono_stats() {
   // Load calibration data
   std::vector<aprilgrid_t> aprilgrids;
@@ -144,6 +385,74 @@ int test_calib_mono_stats() {
   return 0;
 }
 
+int test_calib_mono_frame_influence() {
+  // Load calibration data
+  std::vector<aprilgrid_t> aprilgrids;
+  std::vector<timestamp_t> timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 1);
+
+  const std::vector<std::pair<std::string, std::string>> models = {
+      {"pinhole", "radtan4"},
+      {"double_sphere", "none"}};
+  for (const auto &model : models) {
+    // Calibrate camera
+    calib_params_t calib_params(model.first, model.second,
+                                752, 480, 98.0, 73.0);
+    camera_model_t cam_model;
+    MU_CHECK(calib_camera_model(calib_params, cam_model) == 0);
+    const int nb_dist = camera_dist_params_size(cam_model);
+    const int nb_x = 4 + nb_dist;
+    calib_solver_options_t opts;
+    opts.verbose = false;
+    mat4s_t T_CF;
+    MU_CHECK(calib_mono_solve(aprilgrids, calib_params, T_CF, opts) == 0);
+
+    // Frame influence
+    std::vector<calib_frame_influence_t> influences;
+    struct timespec t_start = tic();
+    retval = calib_mono_frame_influence(aprilgrids,
+                                        calib_params,
+                                        T_CF,
+                                        influences);
+    printf("calib_mono_frame_influence [%s-%s]: %f [s]\n",
+           model.first.c_str(),
+           model.second.c_str(),
+           toc(&t_start));
+    MU_CHECK(retval == 0);
+    MU_CHECK(influences.size() == aprilgrids.size());
+
+    // Every frame is observable, i.e. unused distortion parameters are not
+    // part of the information
+    for (const auto &influence : influences) {
+      MU_CHECK(influence.score >= 0.0);
+    }
+
+    // Compare predicted change against re-solving without the first frame
+    const auto &influence = influences[0];
+    MU_CHECK(influence.dparams.size() == nb_x);
+    MU_CHECK(influence.covar.rows() == nb_x);
+
+    aprilgrids_t grids_drop{aprilgrids.begin() + 1, aprilgrids.end()};
+    for (size_t i = 0; i < grids_drop.size(); i++) {
+      grids_drop[i].T_CF = T_CF[i + 1];
+    }
+    calib_params_t params_drop = calib_params;
+    mat4s_t T_CF_drop;
+    MU_CHECK(calib_mono_solve(grids_drop, params_drop, T_CF_drop, opts) == 0);
+
+    vecx_t dparams{nb_x};
+    dparams << params_drop.proj_params - calib_params.proj_params,
+               (params_drop.dist_params - calib_params.dist_params)
+                   .head(nb_dist);
+    const real_t err = (influence.dparams - dparams).norm();
+    MU_CHECK(err < 0.1 * dparams.norm() + 1e-6);
+  }
+
+  return 0;
+}
+
 int test_calib_generate_poses() {
   // Setup calibration target
   calib_target_t target;
@@ -247,8 +556,15 @@ void test_suite() {
   test_setup();
 
   MU_ADD_TEST(test_calib_mono_residual);
+  MU_ADD_TEST(test_calib_mono_analytic_residual);
   MU_ADD_TEST(test_calib_mono_stats);
   MU_ADD_TEST(test_calib_mono_solve);
+  MU_ADD_TEST(test_calib_mono_solve_early_stop);
+  MU_ADD_TEST(test_calib_mono_solve_deadline);
+  MU_ADD_TEST(test_calib_mono_solve_analytic);
+  MU_ADD_TEST(test_calib_mono_solve_telemetry);
+  MU_ADD_TEST(test_calib_telemetry);
+  MU_ADD_TEST(test_calib_mono_frame_influence);
   // MU_ADD_TEST(test_calib_generate_poses);
 }
 
@@ -37,6 +37,49 @@ void test_setup() {
   }
 }
 
+static mat4_t euroc_T_C1C0() {
+  // clang-format off
+  mat4_t T_C1C0;
+  T_C1C0 << 0.999997256477881, 0.002312067192424, 0.000376008102415, -0.110073808127187,
+            -0.002317135723281, 0.999898048506644, 0.014089835846648, 0.000399121547014,
+            -0.000343393120525, -0.014090668452714, 0.999900662637729, -0.000853702503357,
+            0.0, 0.0, 0.0, 1.0;
+  // clang-format on
+  return T_C1C0;
+}
+
+static int check_extrinsics(const mat4_t &T_C0C1) {
+  // Compare against the EuRoC extrinsics, within 5mm and 0.5 degrees
+  const mat4_t dT = euroc_T_C1C0() * T_C0C1;
+  const real_t dr = tf_trans(dT).norm();
+  const real_t dtheta = Eigen::AngleAxisd(tf_rot(dT)).angle();
+  MU_CHECK(dr < 5e-3);
+  MU_CHECK(rad2deg(dtheta) < 0.5);
+
+  return 0;
+}
+
+static int check_intrinsics(const calib_params_t &cam0_params,
+                            const calib_params_t &cam1_params) {
+  // Compare against the EuRoC intrinsics, within 1% focal length and 5 pixels
+  // principal point
+  const vec4_t cam0_ref{458.654, 457.296, 367.215, 248.375};
+  const vec4_t cam1_ref{457.587, 456.134, 379.999, 255.238};
+  const vecx_t *params[2] = {&cam0_params.proj_params,
+                             &cam1_params.proj_params};
+  const vec4_t *refs[2] = {&cam0_ref, &cam1_ref};
+  for (int i = 0; i < 2; i++) {
+    const vecx_t &p = *params[i];
+    const vec4_t &ref = *refs[i];
+    MU_CHECK(fabs(p(0) - ref(0)) < 0.01 * ref(0));
+    MU_CHECK(fabs(p(1) - ref(1)) < 0.01 * ref(1));
+    MU_CHECK(fabs(p(2) - ref(2)) < 5.0);
+    MU_CHECK(fabs(p(3) - ref(3)) < 5.0);
+  }
+
+  return 0;
+}
+
 int test_calib_stereo_residual() {
   // Test load
   std::vector<aprilgrid_t> cam0_aprilgrids;
@@ -76,15 +119,6 @@ int test_calib_stereo_residual() {
   const vec4_t cam1_intrinsics{cam1_fx, cam1_fy, cam1_cx, cam1_cy};
   const vec4_t cam1_distortion{0.01, 0.0001, 0.0001, 0.0001};
 
-  // Setup cam0 cam1 extrinsics
-  // clang-format off
-  mat4_t T_C1C0_data;
-  T_C1C0_data << 0.999997256477881, 0.002312067192424, 0.000376008102415, -0.110073808127187,
-                 -0.002317135723281, 0.999898048506644, 0.014089835846648, 0.000399121547014,
-                 -0.000343393120525, -0.014090668452714, 0.999900662637729, -0.000853702503357,
-                 0.0, 0.0, 0.0, 1.0;
-  // clang-format on
-
   for (size_t i = 0; i < cam0_aprilgrids.size(); i++) {
     // AprilGrid, keypoint and relative pose observed in cam0
     const auto &grid0 = cam0_aprilgrids[i];
@@ -103,38 +137,210 @@ int test_calib_stereo_residual() {
     const quat_t q_C0F{T_C0F.block<3, 3>(0, 0)};
     const vec3_t t_C0F{T_C0F.block<3, 1>(0, 3)};
 
-    // Form cam0-cam1 extrinsics
-    const quat_t q_C0C1{1.0, 0.0, 0.0, 0.0};
-    const vec3_t t_C0C1{0.0, 0.0, 0.0};
+    // Form cam1-cam0 extrinsics
+    const quat_t q_C1C0{1.0, 0.0, 0.0, 0.0};
+    const vec3_t t_C1C0{0.0, 0.0, 0.0};
 
     // Form residual and call the functor
-    // -- Get the object point
+    // -- Get the object point table
+    vec3s_t object_points;
+    if (aprilgrid_object_points(grid0, object_points) != 0) {
+      LOG_ERROR("Failed to calculate AprilGrid object points!");
+    }
     vec3_t p_F;
     if (aprilgrid_object_point(grid0, tag_id, corner_id, p_F) != 0) {
       LOG_ERROR("Failed to calculate AprilGrid object point!");
     }
+    const size_t point_idx = tag_id * 4 + corner_id;
+    MU_CHECK((object_points[point_idx] - p_F).norm() < 1e-10);
     // -- Form residual
-    // const calib_stereo_residual_t residual{cam0_kp, cam1_kp, p_F};
-
-    // // Calculate residual
-    // vec4_t result{0.0, 0.0, 0.0, 0.0};
-    // residual(cam0_intrinsics.data(),
-    //          cam0_distortion.data(),
-    //          cam1_intrinsics.data(),
-    //          cam1_distortion.data(),
-    //          q_C0C1.coeffs().data(),
-    //          t_C0C1.data(),
-    //          q_C0F.coeffs().data(),
-    //          t_C0F.data(),
-    //          result.data());
-
-    // Just some arbitrary test to make sure reprojection error is not larger
-    // than 300pixels in x or y direction. But often this can be the case ...
-    // MU_CHECK(fabs(result[0]) > 0.0);
-    // MU_CHECK(fabs(result[1]) > 0.0);
-    // MU_CHECK(fabs(result[2]) > 0.0);
-    // MU_CHECK(fabs(result[3]) > 0.0);
+    const calib_stereo_residual_t residual{PINHOLE_RADTAN4,
+                                           PINHOLE_RADTAN4,
+                                           cam0_kp,
+                                           cam1_kp,
+                                           &object_points,
+                                           point_idx};
+
+    // Calculate residual
+    vec4_t result{0.0, 0.0, 0.0, 0.0};
+    residual(cam0_intrinsics.data(),
+             cam0_distortion.data(),
+             cam1_intrinsics.data(),
+             cam1_distortion.data(),
+             q_C1C0.coeffs().data(),
+             t_C1C0.data(),
+             q_C0F.coeffs().data(),
+             t_C0F.data(),
+             result.data());
+
+    // With identity extrinsics both cameras see the same point
+    vec2_t z_C0_hat;
+    vec2_t z_C1_hat;
+    const vec3_t p_C0 = tf_point(T_C0F, p_F);
+    camera_project(PINHOLE_RADTAN4,
+                   cam0_intrinsics.data(),
+                   cam0_distortion.data(),
+                   p_C0,
+                   z_C0_hat);
+    camera_project(PINHOLE_RADTAN4,
+                   cam1_intrinsics.data(),
+                   cam1_distortion.data(),
+                   p_C0,
+                   z_C1_hat);
+    MU_CHECK(fabs(result[0] - (cam0_kp(0) - z_C0_hat(0))) < 1e-8);
+    MU_CHECK(fabs(result[1] - (cam0_kp(1) - z_C0_hat(1))) < 1e-8);
+    MU_CHECK(fabs(result[2] - (cam1_kp(0) - z_C1_hat(0))) < 1e-8);
+    MU_CHECK(fabs(result[3] - (cam1_kp(1) - z_C1_hat(1))) < 1e-8);
+  }
+
+  return 0;
+}
+
+int test_calib_stereo_cam0_residual() {
+  // Load calibration data
+  aprilgrids_t aprilgrids;
+  timestamps_t timestamps;
+  int retval = load_camera_calib_data(CAM0_APRILGRID_DATA,
+                                      aprilgrids,
+                                      timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  const vec4_t proj_params{458.654, 457.296, 367.215, 248.375};
+  const vec4_t dist_params{-0.2834, 0.0740, 0.0002, 0.00002};
+  const aprilgrid_t &grid = aprilgrids[0];
+  const mat4_t &T_C0F = grid.T_CF;
+  const quat_t q_C0F = tf_quat(T_C0F);
+  const vec3_t r_C0F = tf_trans(T_C0F);
+  vec3s_t object_points;
+  MU_CHECK(aprilgrid_object_points(grid, object_points) == 0);
+
+  for (size_t i = 0; i < grid.ids.size(); i++) {
+    for (size_t k = 0; k < 4; k++) {
+      // Residual against the mono residual and scalar projection
+      const size_t point_idx = grid.ids[i] * 4 + k;
+      const vec2_t &z = grid.keypoints[i * 4 + k];
+      const vec3_t &p_F = object_points[point_idx];
+      const calib_stereo_cam0_residual_t residual{PINHOLE_RADTAN4,
+                                                  z,
+                                                  &object_points,
+                                                  point_idx};
+      const calib_mono_residual_t mono_residual{"pinhole", "radtan4", z, p_F};
+      vec2_t result;
+      vec2_t mono_result;
+      MU_CHECK(residual(proj_params.data(),
+                        dist_params.data(),
+                        q_C0F.coeffs().data(),
+                        r_C0F.data(),
+                        result.data()));
+      MU_CHECK(mono_residual(proj_params.data(),
+                             dist_params.data(),
+                             q_C0F.coeffs().data(),
+                             r_C0F.data(),
+                             mono_result.data()));
+      MU_CHECK((result - mono_result).norm() < 1e-8);
+
+      vec2_t z_hat;
+      camera_project(PINHOLE_RADTAN4,
+                     proj_params.data(),
+                     dist_params.data(),
+                     tf_point(T_C0F, p_F),
+                     z_hat);
+      MU_CHECK((result - (z - z_hat)).norm() < 1e-8);
+    }
+  }
+
+  return 0;
+}
+
+int test_calib_stereo_add_frame() {
+  // Load all stereo calibration data
+  aprilgrids_t cam0_aprilgrids;
+  aprilgrids_t cam1_aprilgrids;
+  int retval = load_stereo_calib_data(CAM0_APRILGRID_DATA,
+                                      CAM1_APRILGRID_DATA,
+                                      cam0_aprilgrids,
+                                      cam1_aprilgrids,
+                                      false);
+  MU_CHECK(retval == 0);
+
+  // First frame observed by both cameras
+  size_t idx = 0;
+  while (idx < cam0_aprilgrids.size()) {
+    if (cam0_aprilgrids[idx].ids.size() && cam1_aprilgrids[idx].ids.size()) {
+      break;
+    }
+    idx++;
   }
+  MU_CHECK(idx < cam0_aprilgrids.size());
+  const aprilgrid_t &grid0 = cam0_aprilgrids[idx];
+  const aprilgrid_t &grid1 = cam1_aprilgrids[idx];
+
+  // Count tags observed by both cameras and by a single camera
+  const auto has_tag = [](const aprilgrid_t &grid, const int tag_id) {
+    const auto &ids = grid.ids;
+    return std::find(ids.begin(), ids.end(), tag_id) != ids.end();
+  };
+  int nb_common = 0;
+  int nb_single = 0;
+  for (const auto tag_id : grid0.ids) {
+    (has_tag(grid1, tag_id)) ? nb_common++ : nb_single++;
+  }
+  for (const auto tag_id : grid1.ids) {
+    nb_single += (has_tag(grid0, tag_id)) ? 0 : 1;
+  }
+
+  // Setup parameters
+  vec3s_t object_points;
+  MU_CHECK(aprilgrid_object_points(grid0, object_points) == 0);
+  calib_params_t cam0_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_params_t cam1_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_pose_t T_C1C0{euroc_T_C1C0()};
+  calib_pose_t T_C0F{grid0.T_CF};
+
+  // Every corner forms one residual block, 4 residuals if observed by both
+  // cameras and 2 if observed by a single camera
+  ceres::Problem problem;
+  retval = calib_stereo_add_frame(grid0,
+                                  grid1,
+                                  &object_points,
+                                  cam0_params,
+                                  cam1_params,
+                                  &T_C1C0,
+                                  &T_C0F,
+                                  &problem);
+  MU_CHECK(retval == 0);
+  MU_CHECK(problem.NumResidualBlocks() == 4 * (nb_common + nb_single));
+  MU_CHECK(problem.NumResiduals() == 16 * nb_common + 8 * nb_single);
+  MU_CHECK(problem.NumParameterBlocks() == 8);
+
+  // Frame observed by cam0 only does not involve cam1 or the extrinsics
+  ceres::Problem problem_cam0;
+  retval = calib_stereo_add_frame(grid0,
+                                  aprilgrid_t{},
+                                  &object_points,
+                                  cam0_params,
+                                  cam1_params,
+                                  &T_C1C0,
+                                  &T_C0F,
+                                  &problem_cam0);
+  MU_CHECK(retval == 0);
+  MU_CHECK(problem_cam0.NumResidualBlocks() == 4 * (int) grid0.ids.size());
+  MU_CHECK(problem_cam0.NumResiduals() == 8 * (int) grid0.ids.size());
+  MU_CHECK(problem_cam0.NumParameterBlocks() == 4);
+
+  // Unsupported camera model
+  ceres::Problem problem_bad;
+  calib_params_t cam_bad("pinhole", "fov", 752, 480, 98.0, 73.0);
+  retval = calib_stereo_add_frame(grid0,
+                                  grid1,
+                                  &object_points,
+                                  cam0_params,
+                                  cam_bad,
+                                  &T_C1C0,
+                                  &T_C0F,
+                                  &problem_bad);
+  MU_CHECK(retval == -1);
 
   return 0;
 }
@@ -143,15 +349,11 @@ int test_calib_stereo_solve() {
   // Load stereo calibration data
   aprilgrids_t cam0_aprilgrids;
   aprilgrids_t cam1_aprilgrids;
-  int retval = 0;
-  load_stereo_calib_data(CAM0_APRILGRID_DATA,
-                         CAM1_APRILGRID_DATA,
-                         cam0_aprilgrids,
-                         cam1_aprilgrids);
-  if (retval != 0) {
-    LOG_ERROR("Failed to local calibration data!");
-    return -1;
-  }
+  int retval = load_stereo_calib_data(CAM0_APRILGRID_DATA,
+                                      CAM1_APRILGRID_DATA,
+                                      cam0_aprilgrids,
+                                      cam1_aprilgrids);
+  MU_CHECK(retval == 0);
 
   // Setup camera intrinsics and distortion
   calib_params_t cam0_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
@@ -166,10 +368,120 @@ int test_calib_stereo_solve() {
                               cam1_params,
                               T_C0C1,
                               poses);
-  if (retval != 0) {
-    LOG_ERROR("Failed to calibrate stereo cameras!");
-    return -1;
-  }
+  MU_CHECK(retval == 0);
+  MU_CHECK(poses.size() == cam0_aprilgrids.size());
+  MU_CHECK(check_extrinsics(T_C0C1) == 0);
+  MU_CHECK(check_intrinsics(cam0_params, cam1_params) == 0);
+
+  // Show results
+  std::cout << std::endl << cam0_params.toString(0) << std::endl;
+  std::cout << std::endl << cam1_params.toString(1) << std::endl;
+  std::cout << "T_C0C1:\n" << T_C0C1 << std::endl;
+
+  return 0;
+}
+
+int test_calib_stereo_solve_all_obs() {
+  // Load all stereo calibration data
+  aprilgrids_t cam0_aprilgrids;
+  aprilgrids_t cam1_aprilgrids;
+  int retval = load_stereo_calib_data(CAM0_APRILGRID_DATA,
+                                      CAM1_APRILGRID_DATA,
+                                      cam0_aprilgrids,
+                                      cam1_aprilgrids,
+                                      false);
+  MU_CHECK(retval == 0);
+
+  // Setup camera intrinsics and distortion
+  calib_params_t cam0_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_params_t cam1_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+
+  // Test
+  mat4_t T_C0C1 = I(4);
+  mat4s_t poses;
+  retval = calib_stereo_solve(cam0_aprilgrids,
+                              cam1_aprilgrids,
+                              cam0_params,
+                              cam1_params,
+                              T_C0C1,
+                              poses);
+  MU_CHECK(retval == 0);
+  MU_CHECK(poses.size() == cam0_aprilgrids.size());
+  MU_CHECK(check_extrinsics(T_C0C1) == 0);
+  MU_CHECK(check_intrinsics(cam0_params, cam1_params) == 0);
+
+  // Show results
+  std::cout << std::endl << cam0_params.toString(0) << std::endl;
+  std::cout << std::endl << cam1_params.toString(1) << std::endl;
+  std::cout << "T_C0C1:\n" << T_C0C1 << std::endl;
+
+  return 0;
+}
+
+int test_calib_stereo_solve_two_stage() {
+  // Load stereo calibration data
+  aprilgrids_t cam0_aprilgrids;
+  aprilgrids_t cam1_aprilgrids;
+  int retval = load_stereo_calib_data(CAM0_APRILGRID_DATA,
+                                      CAM1_APRILGRID_DATA,
+                                      cam0_aprilgrids,
+                                      cam1_aprilgrids);
+  MU_CHECK(retval == 0);
+
+  // Load all observations of each camera
+  aprilgrids_t cam0_mono_aprilgrids;
+  aprilgrids_t cam1_mono_aprilgrids;
+  timestamps_t cam0_timestamps;
+  timestamps_t cam1_timestamps;
+  retval = load_camera_calib_data(CAM0_APRILGRID_DATA,
+                                  cam0_mono_aprilgrids,
+                                  cam0_timestamps);
+  MU_CHECK(retval == 0);
+  retval = load_camera_calib_data(CAM1_APRILGRID_DATA,
+                                  cam1_mono_aprilgrids,
+                                  cam1_timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(cam0_mono_aprilgrids.size() >= cam0_aprilgrids.size());
+
+  // Setup camera intrinsics and distortion
+  calib_params_t cam0_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_params_t cam1_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+
+  // Test
+  calib_solver_options_t opts;
+  opts.verbose = false;
+  mat4_t T_C0C1 = I(4);
+  mat4s_t poses;
+  retval = calib_stereo_solve(cam0_mono_aprilgrids,
+                              cam1_mono_aprilgrids,
+                              cam0_aprilgrids,
+                              cam1_aprilgrids,
+                              cam0_params,
+                              cam1_params,
+                              T_C0C1,
+                              poses,
+                              10,
+                              opts);
+  MU_CHECK(retval == 0);
+  MU_CHECK(poses.size() == cam0_aprilgrids.size());
+  MU_CHECK(check_extrinsics(T_C0C1) == 0);
+  MU_CHECK(check_intrinsics(cam0_params, cam1_params) == 0);
+
+  // Solving again must replace the poses rather than append to them
+  retval = calib_stereo_solve(cam0_mono_aprilgrids,
+                              cam1_mono_aprilgrids,
+                              cam0_aprilgrids,
+                              cam1_aprilgrids,
+                              cam0_params,
+                              cam1_params,
+                              T_C0C1,
+                              poses,
+                              10,
+                              opts);
+  MU_CHECK(retval == 0);
+  MU_CHECK(poses.size() == cam0_aprilgrids.size());
+  MU_CHECK(check_extrinsics(T_C0C1) == 0);
+  MU_CHECK(check_intrinsics(cam0_params, cam1_params) == 0);
 
   // Show results
   std::cout << std::endl << cam0_params.toString(0) << std::endl;
@@ -228,7 +540,11 @@ void test_suite() {
 
   // Stereo camera tests
   MU_ADD_TEST(test_calib_stereo_residual);
+  MU_ADD_TEST(test_calib_stereo_cam0_residual);
+  MU_ADD_TEST(test_calib_stereo_add_frame);
   MU_ADD_TEST(test_calib_stereo_solve);
+  MU_ADD_TEST(test_calib_stereo_solve_all_obs);
+  MU_ADD_TEST(test_calib_stereo_solve_two_stage);
   // MU_ADD_TEST(test_calib_stereo_stats);
 }
 
@@ -0,0 +1,378 @@
+#include "munit.hpp"
+#include "calib_undistort.hpp"
+
+namespace yac {
+
+#ifndef TEST_PATH
+  #define TEST_PATH "."
+#endif
+
+#define CAM0_IMAGE TEST_PATH "/test_data/calib/stereo/cam0_1403709395937837056.png"
+#define CAM1_IMAGE TEST_PATH "/test_data/calib/stereo/cam1_1403709395937837056.png"
+#define TEST_OUTPUT_DIR "/tmp/calib_undistort_test"
+
+static calib_params_t setup_camera(const std::string &dist_model) {
+  const int img_w = 752;
+  const int img_h = 480;
+  vecx_t proj_params{4};
+  vecx_t dist_params{4};
+  if (dist_model == "none") {
+    // Double sphere with a field of view beyond 180 degrees
+    proj_params << 200.0, 200.0, 376.0, 240.0;
+    dist_params << -0.2, 0.6, 0.0, 0.0;
+    return calib_params_t{"double_sphere", dist_model, img_w, img_h,
+                          proj_params, dist_params};
+  }
+  proj_params << 458.654, 457.296, 367.215, 248.375;
+  if (dist_model == "radtan4") {
+    dist_params << -0.28340811, 0.07395907, 0.00019359, 1.76187114e-05;
+  } else {
+    dist_params << -0.0068, 0.0154, -0.0152, 0.0050;
+  }
+
+  return calib_params_t{"pinhole", dist_model, img_w, img_h,
+                        proj_params, dist_params};
+}
+
+int test_cvmats_save_load() {
+  dir_create(TEST_OUTPUT_DIR);
+  const std::string fpath = TEST_OUTPUT_DIR "/mats.bin";
+
+  cv::Mat A(3, 3, CV_64F);
+  cv::Mat B(7, 5, CV_16SC2);
+  cv::randu(A, -1.0, 1.0);
+  cv::randu(B, -100, 100);
+  MU_CHECK(cvmats_save(fpath, {A, B}) == 0);
+
+  std::vector<cv::Mat> mats;
+  std::shared_ptr<void> mapping;
+  MU_CHECK(cvmats_load(fpath, mats, mapping) == 0);
+  MU_CHECK(mats.size() == 2);
+  MU_CHECK(mats[0].type() == A.type());
+  MU_CHECK(mats[1].type() == B.type());
+  MU_CHECK(mats[1].size() == B.size());
+  MU_CHECK(cv::norm(mats[0], A, cv::NORM_INF) == 0.0);
+  MU_CHECK(cv::norm(mats[1], B, cv::NORM_INF) == 0.0);
+
+  // Data is aligned in the mapped file
+  MU_CHECK((uintptr_t) mats[0].data % 64 == 0);
+  MU_CHECK((uintptr_t) mats[1].data % 64 == 0);
+
+  // Invalid file
+  MU_CHECK(cvmats_load(TEST_OUTPUT_DIR "/missing.bin", mats, mapping) != 0);
+
+  return 0;
+}
+
+int test_undistort_map() {
+  dir_create(TEST_OUTPUT_DIR);
+  const cv::Mat image = cv::imread(CAM0_IMAGE);
+
+  for (const std::string dist_model : {"radtan4", "equi4"}) {
+    const calib_params_t cam = setup_camera(dist_model);
+    undistort_map_t map;
+    MU_CHECK(undistort_map_init(map, cam) == 0);
+    MU_CHECK(map.img_w == cam.img_w);
+    MU_CHECK(map.img_h == cam.img_h);
+    MU_CHECK(map.map1.type() == CV_16SC2);
+    MU_CHECK(map.map2.type() == CV_16UC1);
+
+    // Save and load
+    const std::string fpath = TEST_OUTPUT_DIR "/" + dist_model + ".bin";
+    MU_CHECK(undistort_map_save(map, fpath) == 0);
+    undistort_map_t map_loaded;
+    MU_CHECK(undistort_map_load(map_loaded, fpath) == 0);
+    MU_CHECK(map_loaded.img_w == map.img_w);
+    MU_CHECK(map_loaded.img_h == map.img_h);
+    MU_CHECK((map_loaded.K_new - map.K_new).norm() < 1e-12);
+
+    // Loaded map undistorts the same as the map it was built from
+    cv::Mat image_ud;
+    cv::Mat image_ud_loaded;
+    MU_CHECK(undistort_map_apply(map, image, image_ud) == 0);
+    MU_CHECK(undistort_map_apply(map_loaded, image, image_ud_loaded) == 0);
+    MU_CHECK(cv::norm(image_ud, image_ud_loaded, cv::NORM_INF) == 0.0);
+
+    // Close to undistorting the image directly
+    const vecx_t D = cam.dist_params;
+    const mat3_t K = pinhole_K(cam.proj_params.head(4));
+    cv::Mat image_ref;
+    if (dist_model == "radtan4") {
+      image_ref = radtan_undistort_image(K, D, image);
+    } else {
+      cv::Mat Knew;
+      image_ref = equi_undistort_image(K, D, image, 0.0, Knew);
+    }
+    const real_t diff = cv::norm(image_ud, image_ref, cv::NORM_L1);
+    MU_CHECK(diff / image.total() < 1.0);
+  }
+
+  // Image size mismatch
+  undistort_map_t map;
+  MU_CHECK(undistort_map_init(map, setup_camera("radtan4")) == 0);
+  cv::Mat image_small(240, 376, CV_8UC1);
+  cv::Mat image_ud;
+  MU_CHECK(undistort_map_apply(map, image_small, image_ud) != 0);
+
+  return 0;
+}
+
+int test_rectify_map() {
+  dir_create(TEST_OUTPUT_DIR);
+  const cv::Mat image0 = cv::imread(CAM0_IMAGE);
+  const cv::Mat image1 = cv::imread(CAM1_IMAGE);
+
+  // Stereo pair with a 11cm baseline and slightly rotated cam1
+  const mat3_t C_C0C1 = euler321(vec3_t{deg2rad(0.5), deg2rad(-1.0), 0.0});
+  const mat4_t T_C0C1 = tf(C_C0C1, vec3_t{0.11, 0.002, -0.001});
+  const mat4_t T_C1C0 = T_C0C1.inverse();
+
+  for (const std::string dist_model : {"radtan4", "equi4"}) {
+    const calib_params_t cam0 = setup_camera(dist_model);
+    const calib_params_t cam1 = setup_camera(dist_model);
+    rectify_map_t map;
+    MU_CHECK(rectify_map_init(map, cam0, cam1, T_C0C1) == 0);
+    MU_CHECK(map.img_w == cam0.img_w);
+    MU_CHECK(map.img_h == cam0.img_h);
+    MU_CHECK(map.cam0_map1.type() == CV_16SC2);
+    MU_CHECK(map.cam0_map2.type() == CV_16UC1);
+    MU_CHECK(map.cam1_map1.type() == CV_16SC2);
+    MU_CHECK(map.cam1_map2.type() == CV_16UC1);
+
+    // Points project to the same row in both rectified cameras
+    for (int i = 0; i < 100; i++) {
+      const vec3_t p_C0{randf(-1.0, 1.0), randf(-1.0, 1.0), randf(2.0, 5.0)};
+      const vec3_t p_C1 = tf_point(T_C1C0, p_C0);
+      const vec3_t r_C0 = map.R0 * p_C0;
+      const vec3_t r_C1 = map.R1 * p_C1;
+      const vec3_t z0 = map.P0 * r_C0.homogeneous();
+      const vec3_t z1 = map.P1 * r_C1.homogeneous();
+      MU_CHECK(fabs(z0(1) / z0(2) - z1(1) / z1(2)) < 1e-6);
+    }
+
+    // Save and load
+    const std::string fpath = TEST_OUTPUT_DIR "/rect_" + dist_model + ".bin";
+    MU_CHECK(rectify_map_save(map, fpath) == 0);
+    rectify_map_t map_loaded;
+    MU_CHECK(rectify_map_load(map_loaded, fpath) == 0);
+    MU_CHECK(map_loaded.img_w == map.img_w);
+    MU_CHECK(map_loaded.img_h == map.img_h);
+    MU_CHECK((map_loaded.R0 - map.R0).norm() < 1e-12);
+    MU_CHECK((map_loaded.R1 - map.R1).norm() < 1e-12);
+    MU_CHECK((map_loaded.P0 - map.P0).norm() < 1e-12);
+    MU_CHECK((map_loaded.P1 - map.P1).norm() < 1e-12);
+    MU_CHECK((map_loaded.Q - map.Q).norm() < 1e-12);
+
+    // Loaded map rectifies the same as the map it was built from
+    cv::Mat image0_rect;
+    cv::Mat image1_rect;
+    cv::Mat image0_rect_loaded;
+    cv::Mat image1_rect_loaded;
+    MU_CHECK(rectify_map_apply(map,
+                               image0,
+                               image1,
+                               image0_rect,
+                               image1_rect) == 0);
+    MU_CHECK(rectify_map_apply(map_loaded,
+                               image0,
+                               image1,
+                               image0_rect_loaded,
+                               image1_rect_loaded) == 0);
+    MU_CHECK(cv::norm(image0_rect, image0_rect_loaded, cv::NORM_INF) == 0.0);
+    MU_CHECK(cv::norm(image1_rect, image1_rect_loaded, cv::NORM_INF) == 0.0);
+  }
+
+  // Mismatched camera models
+  rectify_map_t map;
+  const calib_params_t cam0 = setup_camera("radtan4");
+  const calib_params_t cam1 = setup_camera("equi4");
+  MU_CHECK(rectify_map_init(map, cam0, cam1, T_C0C1) != 0);
+
+  // Image size mismatch
+  MU_CHECK(rectify_map_init(map, cam0, cam0, T_C0C1) == 0);
+  cv::Mat image_small(240, 376, CV_8UC1);
+  cv::Mat image0_rect;
+  cv::Mat image1_rect;
+  MU_CHECK(rectify_map_apply(map,
+                             image_small,
+                             image1,
+                             image0_rect,
+                             image1_rect) != 0);
+
+  return 0;
+}
+
+int test_undistort_poly() {
+  dir_create(TEST_OUTPUT_DIR);
+
+  for (const std::string dist_model : {"radtan4", "equi4"}) {
+    const calib_params_t cam = setup_camera(dist_model);
+    camera_model_t model;
+    MU_CHECK(calib_camera_model(cam, model) == 0);
+
+    undistort_poly_t poly;
+    MU_CHECK(undistort_poly_fit(poly, cam) == 0);
+    MU_CHECK(poly.radial.size() == 8);
+    MU_CHECK(poly.max_error <= poly.tolerance);
+    MU_CHECK(poly.rms_error <= poly.max_error);
+
+    // Polynomial agrees with iterative undistortion
+    const size_t n = 1000;
+    std::vector<real_t> u(n), v(n), x(n), y(n), x_ref(n), y_ref(n);
+    std::vector<uint8_t> converged(n);
+    for (size_t i = 0; i < n; i++) {
+      u[i] = randf(0.0, cam.img_w - 1.0);
+      v[i] = randf(0.0, cam.img_h - 1.0);
+    }
+    undistort_poly_batch(poly, n, u.data(), v.data(), x.data(), y.data());
+    camera_undistort_batch(model,
+                           cam.proj_params.data(),
+                           cam.dist_params.data(),
+                           n,
+                           u.data(),
+                           v.data(),
+                           x_ref.data(),
+                           y_ref.data(),
+                           converged.data());
+    const real_t fx = cam.proj_params(0);
+    for (size_t i = 0; i < n; i++) {
+      if (converged[i]) {
+        const vec2_t p{x[i], y[i]};
+        const vec2_t p_ref{x_ref[i], y_ref[i]};
+        MU_CHECK(fx * (p - p_ref).norm() < 1.0);
+      }
+    }
+
+    // Single point matches batch
+    const vec2_t p = undistort_poly_point(poly, vec2_t{u[0], v[0]});
+    MU_CHECK(fabs(p(0) - x[0]) < 1e-12);
+    MU_CHECK(fabs(p(1) - y[0]) < 1e-12);
+
+    // Save and load
+    const std::string fpath = TEST_OUTPUT_DIR "/poly_" + dist_model + ".yaml";
+    MU_CHECK(undistort_poly_save(poly, fpath) == 0);
+    undistort_poly_t poly_loaded;
+    MU_CHECK(undistort_poly_load(poly_loaded, fpath) == 0);
+    MU_CHECK(poly_loaded.img_w == poly.img_w);
+    MU_CHECK(poly_loaded.img_h == poly.img_h);
+    MU_CHECK((poly_loaded.proj_params - poly.proj_params).norm() < 1e-12);
+    MU_CHECK((poly_loaded.radial - poly.radial).norm() < 1e-9);
+    MU_CHECK((poly_loaded.tangential - poly.tangential).norm() < 1e-12);
+  }
+
+  // Tolerance not met
+  undistort_poly_t poly;
+  MU_CHECK(undistort_poly_fit(poly, setup_camera("radtan4"), 2, 0.01) != 0);
+  MU_CHECK(poly.max_error > 0.01);
+
+  return 0;
+}
+
+int test_bearing_lut() {
+  dir_create(TEST_OUTPUT_DIR);
+
+  for (const std::string dist_model : {"radtan4", "equi4", "none"}) {
+    const calib_params_t cam = setup_camera(dist_model);
+    camera_model_t model;
+    MU_CHECK(calib_camera_model(cam, model) == 0);
+    const real_t params[8] = {cam.proj_params(0), cam.proj_params(1),
+                              cam.proj_params(2), cam.proj_params(3),
+                              cam.dist_params(0), cam.dist_params(1),
+                              cam.dist_params(2), cam.dist_params(3)};
+
+    for (const int step : {1, 4}) {
+      bearing_lut_t lut;
+      MU_CHECK(bearing_lut_init(lut, cam, step) == 0);
+      MU_CHECK(lut.bearings.type() == CV_32FC3);
+      MU_CHECK(lut.bearings.rows == (cam.img_h - 1 + step - 1) / step + 1);
+      MU_CHECK(lut.bearings.cols == (cam.img_w - 1 + step - 1) / step + 1);
+
+      // Interpolated bearings agree with iterative undistortion, or for the
+      // double sphere with the closed form unprojection. The interpolation
+      // error grows with the step and the lens curvature, the double sphere
+      // camera is far wider than the pinhole ones.
+      const real_t fov_scale = (model == DOUBLE_SPHERE) ? 100.0 : 1.0;
+      const real_t tol = fov_scale * ((step == 1) ? 1e-5 : 1e-4);
+      const real_t px_tol = (step == 1) ? 0.02 : 0.5;
+      int nb_behind = 0;
+      for (int i = 0; i < 1000; i++) {
+        const real_t u = randf(0.0, cam.img_w - 1.0);
+        const real_t v = randf(0.0, cam.img_h - 1.0);
+        vec3_t bearing_ref;
+        if (model == DOUBLE_SPHERE) {
+          MU_CHECK(double_sphere_unproject(params, {u, v}, bearing_ref) == 0);
+        } else {
+          real_t x = 0.0;
+          real_t y = 0.0;
+          uint8_t converged = 0;
+          camera_undistort_batch(model,
+                                 cam.proj_params.data(),
+                                 cam.dist_params.data(),
+                                 1,
+                                 &u,
+                                 &v,
+                                 &x,
+                                 &y,
+                                 &converged);
+          bearing_ref = vec3_t{x, y, 1.0}.normalized();
+        }
+
+        vec3_t bearing;
+        MU_CHECK(bearing_lut_lookup(lut, vec2_t{u, v}, bearing) == 0);
+        MU_CHECK(fabs(bearing.norm() - 1.0) < 1e-12);
+        MU_CHECK(acos(std::min(1.0, bearing.dot(bearing_ref))) < tol);
+        nb_behind += (bearing(2) < 0.0);
+
+        // Bearing reprojects onto the pixel it was looked up at
+        vec2_t z_hat;
+        MU_CHECK(camera_project(model,
+                                cam.proj_params.data(),
+                                cam.dist_params.data(),
+                                bearing,
+                                z_hat) == 0);
+        MU_CHECK((z_hat - vec2_t{u, v}).norm() < px_tol);
+      }
+
+      // Only the double sphere camera sees beyond 90 degrees
+      if (model == DOUBLE_SPHERE) {
+        MU_CHECK(nb_behind > 0);
+      } else {
+        MU_CHECK(nb_behind == 0);
+      }
+
+      // Outside of table
+      vec3_t bearing;
+      MU_CHECK(bearing_lut_lookup(lut, vec2_t{-1.0, 0.0}, bearing) != 0);
+      MU_CHECK(bearing_lut_lookup(lut, vec2_t{0.0, 1e4}, bearing) != 0);
+
+      // Save and load
+      const std::string fpath = TEST_OUTPUT_DIR "/bearings.bin";
+      MU_CHECK(bearing_lut_save(lut, fpath) == 0);
+      bearing_lut_t lut_loaded;
+      MU_CHECK(bearing_lut_load(lut_loaded, fpath) == 0);
+      MU_CHECK(lut_loaded.img_w == lut.img_w);
+      MU_CHECK(lut_loaded.img_h == lut.img_h);
+      MU_CHECK(lut_loaded.step == lut.step);
+      MU_CHECK(cv::norm(lut_loaded.bearings, lut.bearings, cv::NORM_INF) == 0);
+      MU_CHECK((uintptr_t) lut_loaded.bearings.data % 64 == 0);
+    }
+  }
+
+  // Invalid step
+  bearing_lut_t lut;
+  MU_CHECK(bearing_lut_init(lut, setup_camera("radtan4"), 0) != 0);
+
+  return 0;
+}
+
+void test_suite() {
+  MU_ADD_TEST(test_cvmats_save_load);
+  MU_ADD_TEST(test_undistort_map);
+  MU_ADD_TEST(test_rectify_map);
+  MU_ADD_TEST(test_undistort_poly);
+  MU_ADD_TEST(test_bearing_lut);
+}
+
+} // namespace yac
+
+MU_RUN_TESTS(yac::test_suite);
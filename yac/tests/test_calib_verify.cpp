@@ -0,0 +1,80 @@
+#include "munit.hpp"
+#include "calib_verify.hpp"
+
+namespace yac {
+
+#ifndef TEST_PATH
+  #define TEST_PATH "."
+#endif
+
+#define IMAGE_DIR "/data/euroc_mav/cam_april/mav0/cam0/data"
+#define APRILGRID_CONF TEST_PATH "/test_data/calib/aprilgrid/target.yaml"
+#define APRILGRID_DATA "/tmp/aprilgrid_test/mono/cam0"
+
+void test_setup() {
+  // Setup calibration target
+  calib_target_t target;
+  if (calib_target_load(target, APRILGRID_CONF) != 0) {
+    FATAL("Failed to load calib target [%s]!", APRILGRID_CONF);
+  }
+
+  // Test preprocess data
+  const std::string image_dir = IMAGE_DIR;
+  const vec2_t image_size{752, 480};
+  const double lens_hfov = 98.0;
+  const double lens_vfov = 73.0;
+  int retval = preprocess_camera_data(target,
+                                      image_dir,
+                                      image_size,
+                                      lens_hfov,
+                                      lens_vfov,
+                                      APRILGRID_DATA);
+  if (retval == -1) {
+    FATAL("Failed to preprocess camera data!");
+  }
+}
+
+int test_calib_verify_mono() {
+  // Load calibration data
+  aprilgrids_t aprilgrids;
+  timestamps_t timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  // Calibrate camera
+  calib_params_t calib_params("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  mat4s_t T_CF;
+  MU_CHECK(calib_mono_solve(aprilgrids, calib_params, T_CF) == 0);
+
+  // Verify calibration against the same data
+  calib_verify_stats_t stats;
+  retval = calib_verify_mono(aprilgrids, calib_params, 1.0, stats);
+  MU_CHECK(retval == 0);
+  MU_CHECK(stats.nb_frames == aprilgrids.size());
+  MU_CHECK(stats.reproj.nb_residuals > 0);
+  MU_CHECK(stats.reproj.frame_rmse.size() == aprilgrids.size());
+  MU_CHECK(stats.reproj.rmse < 1.0);
+  MU_CHECK(stats.pass);
+
+  // Verify a perturbed calibration
+  calib_params_t perturbed = calib_params;
+  perturbed.proj_params(0) += 20.0;
+  perturbed.proj_params(2) += 20.0;
+  calib_verify_stats_t perturbed_stats;
+  retval = calib_verify_mono(aprilgrids, perturbed, 1.0, perturbed_stats);
+  MU_CHECK(retval == 0);
+  MU_CHECK(perturbed_stats.reproj.rmse > stats.reproj.rmse);
+
+  return 0;
+}
+
+void test_suite() {
+  test_setup();
+
+  MU_ADD_TEST(test_calib_verify_mono);
+}
+
+} // namespace yac
+
+MU_RUN_TESTS(yac::test_suite);
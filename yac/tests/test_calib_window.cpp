@@ -0,0 +1,201 @@
+#include "munit.hpp"
+#include "calib_window.hpp"
+
+namespace yac {
+
+#ifndef TEST_PATH
+  #define TEST_PATH "."
+#endif
+
+#define IMAGE_DIR "/data/euroc_mav/cam_april/mav0/cam0/data"
+#define APRILGRID_CONF TEST_PATH "/test_data/calib/aprilgrid/target.yaml"
+#define APRILGRID_DATA "/tmp/aprilgrid_test/mono/cam0"
+#define CAM0_APRILGRID_DATA "/tmp/aprilgrid_test/stereo/cam0"
+#define CAM1_APRILGRID_DATA "/tmp/aprilgrid_test/stereo/cam1"
+
+void test_setup() {
+  // Setup calibration target
+  calib_target_t target;
+  if (calib_target_load(target, APRILGRID_CONF) != 0) {
+    FATAL("Failed to load calib target [%s]!", APRILGRID_CONF);
+  }
+
+  // Test preprocess data
+  const std::string image_dir = IMAGE_DIR;
+  const vec2_t image_size{752, 480};
+  const double lens_hfov = 98.0;
+  const double lens_vfov = 73.0;
+  int retval = preprocess_camera_data(target,
+                                      image_dir,
+                                      image_size,
+                                      lens_hfov,
+                                      lens_vfov,
+                                      APRILGRID_DATA);
+  if (retval == -1) {
+    FATAL("Failed to preprocess camera data!");
+  }
+}
+
+static int check_window(const calib_params_t &batch,
+                        const calib_params_t &window) {
+  // Compare against batch calibration, within 2% focal length and principal
+  // point, 0.02 radial and 0.002 tangential distortion
+  for (int i = 0; i < 4; i++) {
+    const real_t proj_batch = batch.proj_params(i);
+    const real_t proj_window = window.proj_params(i);
+    MU_CHECK(fabs(proj_window - proj_batch) < 0.02 * proj_batch);
+  }
+  const vecx_t &dist_batch = batch.dist_params;
+  const vecx_t &dist_window = window.dist_params;
+  MU_CHECK(fabs(dist_window(0) - dist_batch(0)) < 0.02);
+  MU_CHECK(fabs(dist_window(1) - dist_batch(1)) < 0.02);
+  MU_CHECK(fabs(dist_window(2) - dist_batch(2)) < 0.002);
+  MU_CHECK(fabs(dist_window(3) - dist_batch(3)) < 0.002);
+
+  return 0;
+}
+
+int test_calib_prior_residual() {
+  // Random information matrix over a vector and a quaternion block
+  const matx_t A = matx_t::Random(10, 7);
+  const matx_t H = A.transpose() * A;
+  const vecx_t b = vecx_t::Random(7);
+  const std::vector<bool> quaternions = {false, true};
+  const vec4_t q0{0.0, 0.0, 0.0, 1.0};
+  const std::vector<vecx_t> x0 = {vec4_t{1.0, 2.0, 3.0, 4.0}, q0};
+  const calib_prior_residual_t prior{quaternions, x0, H, b};
+
+  // Perturb parameters
+  vec4_t x{1.1, 1.9, 3.0, 4.2};
+  quat_t q{1.0, 0.01, -0.02, 0.03};
+  q.normalize();
+  vec4_t q_xyzw{q.x(), q.y(), q.z(), q.w()};
+  double *params[2] = {x.data(), q_xyzw.data()};
+
+  // Residual cost should match quadratic cost up to a constant
+  vecx_t dx;
+  calib_prior_diff(quaternions, params, x0, dx);
+  vecx_t r(prior.num_residuals());
+  prior.Evaluate(params, r.data(), NULL);
+  const real_t cost = 0.5 * r.squaredNorm();
+  const real_t expected = 0.5 * dx.transpose() * H * dx - b.dot(dx);
+  const real_t constant = 0.5 * prior.t_.squaredNorm();
+  MU_CHECK(fabs(cost - constant - expected) < 1e-8);
+
+  return 0;
+}
+
+int test_calib_window_mono() {
+  // Load calibration data
+  aprilgrids_t aprilgrids;
+  timestamps_t timestamps;
+  int retval = load_camera_calib_data(APRILGRID_DATA, aprilgrids, timestamps);
+  MU_CHECK(retval == 0);
+  MU_CHECK(aprilgrids.size() > 0);
+
+  // Batch calibration
+  calib_params_t batch("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  mat4s_t T_CF;
+  MU_CHECK(calib_mono_solve(aprilgrids, batch, T_CF) == 0);
+
+  // Sliding window calibration
+  calib_params_t cam0("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_window_t window;
+  calib_solver_options_t opts;
+  opts.verbose = false;
+  MU_CHECK(calib_window_init(window, cam0, 5, opts) == 0);
+  size_t nb_frames = 0;
+  for (const auto &grid : aprilgrids) {
+    MU_CHECK(calib_window_add(window, grid) == 0);
+    MU_CHECK(window.T_C0F.size() <= 5);
+    nb_frames += (grid.ids.size()) ? 1 : 0;
+  }
+  MU_CHECK(nb_frames > 5);
+  MU_CHECK(window.nb_frames == nb_frames);
+  MU_CHECK(window.nb_marginalized == nb_frames - 5);
+
+  // Compare against batch calibration
+  MU_CHECK(check_window(batch, window.cam0) == 0);
+
+  return 0;
+}
+
+int test_calib_window_stereo() {
+  // Load stereo calibration data
+  aprilgrids_t cam0_aprilgrids;
+  aprilgrids_t cam1_aprilgrids;
+  int retval = load_stereo_calib_data(CAM0_APRILGRID_DATA,
+                                      CAM1_APRILGRID_DATA,
+                                      cam0_aprilgrids,
+                                      cam1_aprilgrids);
+  MU_CHECK(retval == 0);
+  MU_CHECK(cam0_aprilgrids.size() > 0);
+  MU_CHECK(cam0_aprilgrids.size() == cam1_aprilgrids.size());
+
+  // Batch calibration
+  calib_solver_options_t opts;
+  opts.verbose = false;
+  calib_params_t cam0_batch("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_params_t cam1_batch("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  mat4_t T_C0C1_batch = I(4);
+  mat4s_t T_C0F;
+  retval = calib_stereo_solve(cam0_aprilgrids,
+                              cam1_aprilgrids,
+                              cam0_batch,
+                              cam1_batch,
+                              T_C0C1_batch,
+                              T_C0F,
+                              opts);
+  MU_CHECK(retval == 0);
+
+  // Initialize extrinsics from the first frame seen by both cameras
+  mat4_t T_C0C1 = I(4);
+  for (size_t k = 0; k < cam0_aprilgrids.size(); k++) {
+    const aprilgrid_t &grid0 = cam0_aprilgrids[k];
+    const aprilgrid_t &grid1 = cam1_aprilgrids[k];
+    if (grid0.ids.size() && grid1.ids.size()) {
+      T_C0C1 = grid0.T_CF * grid1.T_CF.inverse();
+      break;
+    }
+  }
+
+  // Sliding window calibration
+  calib_params_t cam0("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_params_t cam1("pinhole", "radtan4", 752, 480, 98.0, 73.0);
+  calib_window_t window;
+  MU_CHECK(calib_window_init(window, cam0, cam1, T_C0C1, 5, opts) == 0);
+  size_t nb_frames = 0;
+  for (size_t k = 0; k < cam0_aprilgrids.size(); k++) {
+    const aprilgrid_t &grid0 = cam0_aprilgrids[k];
+    const aprilgrid_t &grid1 = cam1_aprilgrids[k];
+    MU_CHECK(calib_window_add(window, grid0, grid1) == 0);
+    MU_CHECK(window.T_C0F.size() <= 5);
+    nb_frames += (grid0.ids.size() || grid1.ids.size()) ? 1 : 0;
+  }
+  MU_CHECK(nb_frames > 5);
+  MU_CHECK(window.nb_frames == nb_frames);
+  MU_CHECK(window.nb_marginalized == nb_frames - 5);
+
+  // Compare against batch calibration, extrinsics within 5mm and 0.5 degrees
+  MU_CHECK(check_window(cam0_batch, window.cam0) == 0);
+  MU_CHECK(check_window(cam1_batch, window.cam1) == 0);
+  const mat4_t dT = T_C0C1_batch.inverse() * calib_window_extrinsics(window);
+  const real_t dr = tf_trans(dT).norm();
+  const real_t dtheta = Eigen::AngleAxisd(tf_rot(dT)).angle();
+  MU_CHECK(dr < 5e-3);
+  MU_CHECK(rad2deg(dtheta) < 0.5);
+
+  return 0;
+}
+
+void test_suite() {
+  test_setup();
+
+  MU_ADD_TEST(test_calib_prior_residual);
+  MU_ADD_TEST(test_calib_window_mono);
+  MU_ADD_TEST(test_calib_window_stereo);
+}
+
+} // namespace yac
+
+MU_RUN_TESTS(yac::test_suite);
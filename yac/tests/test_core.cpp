@@ -0,0 +1,177 @@
+#include "munit.hpp"
+#include "core.hpp"
+
+namespace yac {
+
+template <typename CM>
+static int check_camera_jacobians(const CM &cam) {
+  // Parameter jacobians are fixed size
+  const int proj_size = CM::proj_params_size;
+  const int dist_size = CM::dist_params_size;
+  const vec2_t p{0.1, -0.2};
+  const auto J_proj = cam.J_proj(cam.distortion.distort(p));
+  const auto J_dist = cam.J_dist(p);
+  MU_CHECK((std::is_same<decltype(J_proj), const mat_t<2, proj_size>>::value));
+  MU_CHECK((std::is_same<decltype(J_dist), const mat_t<2, dist_size>>::value));
+
+  // Check against finite differences
+  const real_t step = 1e-6;
+  const vec3_t p_C{p(0), p(1), 1.0};
+  vec2_t z;
+  MU_CHECK(cam.project(p_C, z) == 0);
+
+  mat_t<2, proj_size> J_proj_fd;
+  for (int i = 0; i < proj_size; i++) {
+    CM cam_fd = cam;
+    cam_fd.params(i) += step;
+    vec2_t z_fd;
+    cam_fd.project(p_C, z_fd);
+    J_proj_fd.col(i) = (z_fd - z) / step;
+  }
+  MU_CHECK((J_proj - J_proj_fd).norm() < 1e-4);
+
+  mat_t<2, dist_size> J_dist_fd;
+  for (int i = 0; i < dist_size; i++) {
+    CM cam_fd = cam;
+    cam_fd.distortion.params(i) += step;
+    vec2_t z_fd;
+    cam_fd.project(p_C, z_fd);
+    J_dist_fd.col(i) = (z_fd - z) / step;
+  }
+  MU_CHECK((J_dist - J_dist_fd).norm() < 1e-4);
+
+  // Check project_jacobians() against the individual Jacobians
+  vec2_t z_pj;
+  mat_t<2, 3> J_h;
+  mat_t<2, 3> J_h_pj;
+  typename CM::J_proj_t J_proj_pj;
+  typename CM::J_dist_t J_dist_pj;
+  MU_CHECK(cam.project(p_C, z, J_h) == 0);
+  MU_CHECK(cam.project_jacobians(p_C, z_pj, J_h_pj, J_proj_pj, J_dist_pj) == 0);
+  MU_CHECK((z - z_pj).norm() < 1e-10);
+  MU_CHECK((J_h - J_h_pj).norm() < 1e-10);
+  MU_CHECK((J_proj - J_proj_pj).norm() < 1e-10);
+  MU_CHECK((J_dist - J_dist_pj).norm() < 1e-10);
+
+  return 0;
+}
+
+int test_pinhole_jacobians() {
+  const vec4_t proj_params{458.654, 457.296, 367.215, 248.375};
+  const vec4_t radtan4_params{-0.2834, 0.0740, 0.0002, 0.00002};
+  const vec4_t equi4_params{0.0034, 0.0007, -0.0019, 0.0004};
+  const pinhole_radtan4_t radtan4{752, 480, proj_params, radtan4_params};
+  const pinhole_equi4_t equi4{752, 480, proj_params, equi4_params};
+  MU_CHECK(check_camera_jacobians(radtan4) == 0);
+  MU_CHECK(check_camera_jacobians(equi4) == 0);
+
+  return 0;
+}
+
+/**
+ * Distortion model behind a virtual interface, how the models were dispatched
+ * before they were statically typed. Each method is a separate call, so the
+ * work they share is repeated.
+ */
+struct distortion_iface_t {
+  virtual ~distortion_iface_t() {}
+  virtual vec2_t distort(const vec2_t &p) const = 0;
+  virtual mat2_t J_point(const vec2_t &p) const = 0;
+  virtual mat_t<2, 4> J_dist(const vec2_t &p) const = 0;
+};
+
+template <typename DM>
+struct distortion_virtual_t : distortion_iface_t {
+  const DM dist;
+
+  distortion_virtual_t(const DM &dist_) : dist{dist_} {}
+
+  vec2_t distort(const vec2_t &p) const { return dist.distort(p); }
+  mat2_t J_point(const vec2_t &p) const { return dist.J_point(p); }
+  mat_t<2, 4> J_dist(const vec2_t &p) const { return dist.J_dist(p); }
+};
+
+static real_t project_virtual(const vec4_t &proj_params,
+                              const distortion_iface_t &dist,
+                              const vec3s_t &points) {
+  const mat2_t J_K = proj_params.head<2>().asDiagonal();
+  real_t sum = 0.0;
+  for (const auto &p_C : points) {
+    const real_t z_inv = 1.0 / p_C(2);
+    const vec2_t p{p_C(0) * z_inv, p_C(1) * z_inv};
+    mat_t<2, 3> J_norm;
+    J_norm << z_inv, 0.0, -p(0) * z_inv,
+              0.0, z_inv, -p(1) * z_inv;
+
+    const vec2_t p_dist = dist.distort(p);
+    const vec2_t z_hat = J_K * p_dist + proj_params.tail<2>();
+    const mat_t<2, 3> J_h = J_K * dist.J_point(p) * J_norm;
+    mat_t<2, 4> J_proj;
+    J_proj << p_dist(0), 0.0, 1.0, 0.0,
+              0.0, p_dist(1), 0.0, 1.0;
+    const mat_t<2, 4> J_dist = J_K * dist.J_dist(p);
+    sum += z_hat.sum() + J_h.sum() + J_proj.sum() + J_dist.sum();
+  }
+  return sum;
+}
+
+template <typename CM>
+static real_t project_static(const CM &cam, const vec3s_t &points) {
+  real_t sum = 0.0;
+  for (const auto &p_C : points) {
+    vec2_t z_hat;
+    mat_t<2, 3> J_h;
+    mat_t<2, 4> J_proj;
+    mat_t<2, 4> J_dist;
+    cam.project_jacobians(p_C, z_hat, J_h, J_proj, J_dist);
+    sum += z_hat.sum() + J_h.sum() + J_proj.sum() + J_dist.sum();
+  }
+  return sum;
+}
+
+int test_pinhole_dispatch_benchmark() {
+  const vec4_t proj_params{458.654, 457.296, 367.215, 248.375};
+  const vec4_t radtan4_params{-0.2834, 0.0740, 0.0002, 0.00002};
+  const vec4_t equi4_params{0.0034, 0.0007, -0.0019, 0.0004};
+  const pinhole_radtan4_t radtan4{752, 480, proj_params, radtan4_params};
+  const pinhole_equi4_t equi4{752, 480, proj_params, equi4_params};
+
+  const size_t n = 1000000;
+  vec3s_t points;
+  for (size_t i = 0; i < n; i++) {
+    const real_t z = randf(0.5, 5.0);
+    points.emplace_back(randf(-0.7, 0.7) * z, randf(-0.5, 0.5) * z, z);
+  }
+
+  const distortion_virtual_t<radtan4_t> radtan4_virtual{radtan4.distortion};
+  const distortion_virtual_t<equi4_t> equi4_virtual{equi4.distortion};
+  const distortion_iface_t *dists[2] = {&radtan4_virtual, &equi4_virtual};
+  const char *names[2] = {"pinhole-radtan4", "pinhole-equi4"};
+
+  for (int m = 0; m < 2; m++) {
+    struct timespec t_start = tic();
+    const real_t sum_virtual = project_virtual(proj_params, *dists[m], points);
+    const real_t t_virtual = toc(&t_start);
+
+    t_start = tic();
+    const real_t sum_static = (m == 0) ? project_static(radtan4, points)
+                                       : project_static(equi4, points);
+    const real_t t_static = toc(&t_start);
+
+    printf("%s virtual dispatch: %f [s]\n", names[m], t_virtual);
+    printf("%s static dispatch: %f [s]\n", names[m], t_static);
+    printf("speed up: %.2fx\n", t_virtual / t_static);
+    MU_CHECK(fabs(sum_virtual - sum_static) < 1e-9 * fabs(sum_static));
+  }
+
+  return 0;
+}
+
+void test_suite() {
+  MU_ADD_TEST(test_pinhole_jacobians);
+  MU_ADD_TEST(test_pinhole_dispatch_benchmark);
+}
+
+} // namespace yac
+
+MU_RUN_TESTS(yac::test_suite);
@@ -0,0 +1,24 @@
+#include "yac.hpp"
+#include "ros.hpp"
+
+int main(int argc, char *argv[]) {
+  // Setup ROS Node
+  const std::string node_name = yac::ros_node_name(argc, argv);
+  if (ros::isInitialized() == false) {
+    ros::init(argc, argv, node_name, ros::init_options::NoSigintHandler);
+  }
+
+  // Get ROS params
+  const ros::NodeHandle ros_nh;
+  std::string config_file;
+  ROS_PARAM(ros_nh, node_name + "/config_file", config_file);
+
+  // Calibrate all configs in batch, the camera data of each config is
+  // expected to be extracted already
+  if (yac::calib_batch_solve(config_file) != 0) {
+    LOG_WARN("Not all batch calibrations succeeded, see summary!");
+    return -1;
+  }
+
+  return 0;
+}
@@ -155,9 +155,7 @@ static void load_body_poses(const std::string &fpath,
   }
 }
 
-static mat4_t load_fiducial_pose(const std::string &fpath) {
-  mat4_t T_WF;
-
+static int load_fiducial_pose(const std::string &fpath, mat4_t &T_WF) {
   // Open file for loading
   int nb_rows = 0;
   FILE *fp = file_open(fpath.c_str(), "r", &nb_rows);
@@ -192,94 +190,13 @@ static mat4_t load_fiducial_pose(const std::string &fpath) {
     // Just need 1 pose
     quat_t q{qw, qx, qy, qz};
     vec3_t r{px, py, pz};
-    return tf(q, r);
+    T_WF = tf(q, r);
+    fclose(fp);
+    return 0;
   }
+  fclose(fp);
 
-  return I(4);
-}
-
-mat4_t lerp_pose(const timestamp_t &t0,
-                 const mat4_t &pose0,
-                 const timestamp_t &t1,
-                 const mat4_t &pose1,
-                 const timestamp_t &t_lerp) {
-  // Calculate alpha
-  const double numerator = (t_lerp - t0) * 1e-9;
-  const double denominator = (t1 - t0) * 1e-9;
-  const double alpha = numerator / denominator;
-
-  // Decompose start pose
-  const vec3_t trans0 = tf_trans(pose0);
-  const quat_t quat0{tf_rot(pose0)};
-
-  // Decompose end pose
-  const vec3_t trans1 = tf_trans(pose1);
-  const quat_t quat1{tf_rot(pose1)};
-
-  // Interpolate translation and rotation
-  const auto trans_interp = lerp(trans0, trans1, alpha);
-  const auto quat_interp = quat1.slerp(alpha, quat0);
-
-  return tf(quat_interp, trans_interp);
-}
-
-void lerp_body_poses(const aprilgrids_t &grids,
-                     const timestamps_t &body_timestamps,
-                     const mat4s_t &body_poses,
-                     aprilgrids_t &lerped_grids,
-                     mat4s_t &lerped_poses,
-                     timestamp_t ts_offset = 0) {
-  // Make sure AprilGrids are between body poses else we can't lerp poses
-  timestamps_t grid_timestamps;
-  for (const auto &grid : grids) {
-    if (grid.timestamp > body_timestamps.front() &&
-        grid.timestamp < body_timestamps.back()) {
-      lerped_grids.push_back(grid);
-      grid_timestamps.push_back(grid.timestamp);
-    }
-  }
-
-  // Lerp body poses using AprilGrid timestamps
-  assert(body_poses.size() == body_timestamps.size());
-  assert(body_timestamps.front() < grid_timestamps.front());
-  timestamp_t t0 = 0;
-  mat4_t pose0 = I(4);
-  timestamp_t t1 = 0;
-  mat4_t pose1 = I(4);
-
-  size_t grid_idx = 0;
-  for (size_t i = 0; i < body_timestamps.size(); i++) {
-    // Make sure we're not going out of bounds
-    if (grid_idx > (grid_timestamps.size() - 1)) {
-      break;
-    }
-
-    // Get time now and desired lerp time
-    const auto t_now = body_timestamps[i] + ts_offset;
-    const auto t_lerp = grid_timestamps[grid_idx];
-
-    // Update t0
-    if (t_now < t_lerp) {
-      t0 = t_now;
-      pose0 = body_poses[i];
-    }
-
-    // Update t1
-    if (t_now > t_lerp) {
-      // Lerp
-      t1 = t_now;
-      pose1 = body_poses[i];
-      const auto pose = lerp_pose(t0, pose0, t1, pose1, t_lerp);
-      lerped_poses.push_back(pose);
-      grid_idx++;
-
-      // Reset
-      t0 = t_now;
-      pose0 = body_poses[i];
-      t1 = 0;
-      pose1 = I(4);
-    }
-  }
+  return -1;
 }
 
 struct dataset_t {
@@ -288,6 +205,12 @@ struct dataset_t {
   mat4s_t T_WM;
   mat4_t T_MC;
   mat4_t T_WF;
+  real_t td = 0.0;
+
+  // Unsynchronized data, for estimating the time offset td
+  aprilgrids_t aprilgrids;
+  timestamps_t body_timestamps;
+  mat4s_t body_poses;
 };
 
 dataset_t process_dataset(const std::string &data_path,
@@ -349,7 +272,7 @@ dataset_t process_dataset(const std::string &data_path,
   dataset_t ds;
   // -- April Grid
   std::cout << "---- Loading AprilGrids" << std::endl;
-  aprilgrids_t aprilgrids = load_aprilgrids(grid0_path);
+  ds.aprilgrids = load_aprilgrids(grid0_path);
   // -- Camera proj_params and dist_params
   int img_w = resolution(0);
   int img_h = resolution(1);
@@ -358,21 +281,39 @@ dataset_t process_dataset(const std::string &data_path,
                           proj_params, dist_params};
   // -- Vicon marker pose
   std::cout << "---- Loading body poses" << std::endl;
-  timestamps_t body_timestamps;
-  mat4s_t body_poses;
-  load_body_poses(body0_csv_path, body_timestamps, body_poses);
+  load_body_poses(body0_csv_path, ds.body_timestamps, ds.body_poses);
   // -- Synchronize aprilgrids and body poses
   std::cout << "---- Synchronizing ApilGrids" << std::endl;
-  lerp_body_poses(aprilgrids, body_timestamps, body_poses, ds.grids, ds.T_WM);
+  lerp_body_poses(ds.aprilgrids,
+                  ds.body_timestamps,
+                  ds.body_poses,
+                  ds.grids,
+                  ds.T_WM);
   // ds.grids, ds.T_WM, 0.05e9);
-  // -- Vicon Marker to Camera transform
-  const vec3_t euler{-90.0, 0.0, -90.0};
-  // const vec3_t euler{-180.0, 0.0, -90.0};
-  const mat3_t C = euler321(deg2rad(euler));
-  ds.T_MC = tf(C, zeros(3, 1));
   // -- Fiducial target pose
   std::cout << "---- Loading fiducial pose" << std::endl;
-  ds.T_WF = load_fiducial_pose(target0_csv_path);
+  ds.T_WF = I(4);
+  const bool T_WF_measured =
+      (load_fiducial_pose(target0_csv_path, ds.T_WF) == 0);
+  // -- Vicon Marker to Camera transform
+  std::cout << "---- Initializing T_MC with hand-eye calibration" << std::endl;
+  mat4s_t T_CF;
+  for (auto &grid : ds.grids) {
+    if (grid.estimated == false) {
+      aprilgrid_calc_relative_pose(grid, pinhole_K(proj_params), dist_params);
+    }
+    T_CF.push_back(grid.T_CF);
+  }
+  mat4_t T_WF_init;
+  if (calib_mocap_marker_init(ds.T_WM, T_CF, ds.T_MC, T_WF_init) != 0) {
+    LOG_WARN("Hand-eye init failed, falling back to a default T_MC guess!");
+    const vec3_t euler{-90.0, 0.0, -90.0};
+    const mat3_t C = euler321(deg2rad(euler));
+    ds.T_MC = tf(C, zeros(3, 1));
+  } else if (T_WF_measured == false) {
+    // Only use the estimated fiducial pose if it was not measured
+    ds.T_WF = T_WF_init;
+  }
 
   // Show dataset stats
   std::cout << std::endl;
@@ -429,11 +370,10 @@ void detect_aprilgrids(const calib_target_t &calib_target,
   }
 }
 
-double loop_test_dataset(const std::string test_path,
-                         const calib_target_t &calib_target,
-                         const dataset_t &ds,
-                         bool imshow,
-                         long long ts_offset = 0) {
+int sweep_test_dataset(const std::string test_path,
+                       const calib_target_t &calib_target,
+                       const dataset_t &ds,
+                       const std::vector<int64_t> &ts_offsets) {
   const auto cam0_path = test_path + "/cam0/data";
   const auto grids_path = test_path + "/grid0/cam0/data";
   const auto body0_csv_path = test_path + "/body0/data.csv";
@@ -452,135 +392,31 @@ double loop_test_dataset(const std::string test_path,
   mat4s_t body_poses;
   load_body_poses(body0_csv_path, body_timestamps, body_poses);
 
-  // Synchronize grids and body poses
-  aprilgrids_t grids_sync;
-  mat4s_t body_poses_sync;
-  lerp_body_poses(aprilgrids,
-                  body_timestamps,
-                  body_poses,
-                  grids_sync,
-                  body_poses_sync,
-                  ts_offset);
-
-  // // Optimized parameters
-  // vec_t<8> cam_params;
-  // cam_params << ds.cam_model.fx(),
-  //               ds.cam_model.fy(),
-  //               ds.cam_model.cx(),
-  //               ds.cam_model.cy(),
-  //               ds.cam_model.distortion.k1(),
-  //               ds.cam_model.distortion.k2(),
-  //               ds.cam_model.distortion.p1(),
-  //               ds.cam_model.distortion.p2();
-  // const mat4_t T_MC = ds.T_MC;
-  // const mat4_t T_WF = ds.T_WF;
-  //
-  // // Loop over test dataset
-  // size_t pose_idx = 0;
-  // vec2s_t residuals;
-  //
-  // for (const auto &image_file : image_paths) {
-  //   // LOG_INFO("Image [%s]", image_file.c_str());
-  //
-  //   // Load image
-  //   auto image = cv::imread(paths_combine(cam0_path, image_file));
-  //   const auto img_w = image.cols;
-  //   const auto img_h = image.rows;
-  //
-  //   // Predict where aprilgrid points should be
-  //   const mat4_t T_WM_ = body_poses_sync[pose_idx];
-  //   const mat4_t T_WC = T_WM_ * T_MC;
-  //   const mat4_t T_CW = T_WC.inverse();
-  //
-  //   // Setup grid
-  //   const auto grid = grids_sync[pose_idx];
-  //
-  //   for (const auto tag_id : grid.ids) {
-  //     // Get keypoints
-  //     vec2s_t keypoints;
-  //     if (aprilgrid_get(grid, tag_id, keypoints) != 0) {
-  //       FATAL("Failed to get AprilGrid keypoints!");
-  //     }
-  //
-  //     // Get object points
-  //     vec3s_t object_points;
-  //     if (aprilgrid_object_points(grid, tag_id, object_points) != 0) {
-  //       FATAL("Failed to calculate AprilGrid object points!");
-  //     }
-  //
-  //     // Calculate reprojection error
-  //     for (size_t i = 0; i < 4; i++) {
-  //       const vec3_t p_F = object_points[i];
-  //       const vec3_t p_C = (T_CW * T_WF * p_F.homogeneous()).head(3);
-  //
-  //       vec2_t z_hat;
-  //       if (pinhole_radtan4_project(cam_params, p_C, z_hat) != 0) {
-  //         continue;
-  //       }
-  //       residuals.emplace_back(keypoints[i] - z_hat);
-  //     }
-  //   }
-  //
-  //   // Project object point in fiducial frame to image plane
-  //   vec3s_t object_points;
-  //   vec2s_t image_points;
-  //   aprilgrid_object_points(grid, object_points);
-  //   for (const auto &p_F : object_points) {
-  //     const vec3_t p_C = (T_CW * T_WF * p_F.homogeneous()).head(3);
-  //
-  //     // {
-  //     //   double fx = K(0, 0);
-  //     //   double fy = K(1, 1);
-  //     //   double cx = K(0, 2);
-  //     //   double cy = K(1, 2);
-  //     //   double x = fx * (p_C(0) / p_C(2)) + cx;
-  //     //   double y = fy * (p_C(1) / p_C(2)) + cy;
-  //     //   const bool x_ok = (x > 0 && x < img_w);
-  //     //   const bool y_ok = (y > 0 && y < img_h);
-  //     //   if (!x_ok && !y_ok) {
-  //     //     continue;
-  //     //   }
-  //     // }
-  //
-  //     vec2_t img_pt;
-  //     if (pinhole_radtan4_project(cam_params, p_C, img_pt) != 0) {
-  //       continue;
-  //     }
-  //
-  //     const bool x_ok = (img_pt(0) > 0 && img_pt(0) < img_w);
-  //     const bool y_ok = (img_pt(1) > 0 && img_pt(1) < img_h);
-  //     if (x_ok && y_ok) {
-  //       image_points.push_back(img_pt);
-  //     }
-  //   }
-  //
-  //   // Draw on image
-  //   if (imshow) {
-  //     for (const auto &img_pt : image_points) {
-  //       cv::Point2f p(img_pt(0), img_pt(1));
-  //       cv::circle(image, p, 3, cv::Scalar(0, 0, 255), -1);
-  //     }
-  //     cv::imshow("Image", image);
-  //     cv::waitKey(0);
-  //   }
-  //
-  //   pose_idx++;
-  // }
-  //
-  // // Calculate RMSE reprojection error
-  // double err_sum = 0.0;
-  // for (auto &residual : residuals) {
-  //   const double err = residual.norm();
-  //   const double err_sq = err * err;
-  //   err_sum += err_sq;
-  // }
-  // const double err_mean = err_sum / (double) residuals.size();
-  // const double rmse = sqrt(err_mean);
-  // std::cout << "TS OFFSET: " << ts_offset * 1e-9 << "s\t";
-  // std::cout << "RMSE Reprojection Error [px]: " << rmse << std::endl;
+  // Sweep time offsets
+  mocap_marker_sweep_t sweep;
+  if (calib_mocap_marker_sweep(aprilgrids,
+                               body_timestamps,
+                               body_poses,
+                               ds.cam,
+                               ds.T_MC,
+                               ds.T_WF,
+                               ts_offsets,
+                               sweep) != 0) {
+    LOG_ERROR("Failed to sweep time offsets!");
+    return -1;
+  }
 
-  // return rmse;
-  return 0.0;
+  // Show results
+  for (size_t k = 0; k < sweep.ts_offsets.size(); k++) {
+    std::cout << "TS OFFSET: " << sweep.ts_offsets[k] * 1e-9 << "s\t";
+    std::cout << "RMSE Reprojection Error [px]: " << sweep.rmses[k];
+    std::cout << std::endl;
+  }
+  std::cout << "Best TS OFFSET: ";
+  std::cout << sweep.ts_offsets[sweep.best_idx] * 1e-9 << "s ";
+  std::cout << "(" << sweep.nb_frames << " frames)" << std::endl;
+
+  return 0;
 }
 
 void show_results(const dataset_t &ds) {
@@ -614,6 +450,7 @@ void show_results(const dataset_t &ds) {
          q_MC.y(),
          q_MC.z(),
          q_MC.w());
+  printf("td: %f [s]\n", ds.td);
 }
 
 void save_results(const std::string &output_path, const dataset_t &ds) {
@@ -711,6 +548,9 @@ void save_results(const std::string &output_path, const dataset_t &ds) {
     fprintf(fp, "%lf\n", T_MC(3, 3));
     fprintf(fp, "  ]\n");
     fprintf(fp, "\n");
+
+    // Camera to mocap time offset
+    fprintf(fp, "td: %f  # [s]\n", ds.td);
     fclose(fp);
   }
 
@@ -795,6 +635,18 @@ int main(int argc, char *argv[]) {
   parse(config, "ros.cam0_topic", cam0_topic);
   parse(config, "ros.body0_topic", body0_topic);
   parse(config, "ros.target0_topic", target0_topic);
+  bool estimate_td = false;
+  real_t td_max = 0.1;
+  parse(config, "settings.estimate_time_offset", estimate_td, true);
+  parse(config, "settings.time_offset_max", td_max, true);
+  bool sweep_td = false;
+  real_t sweep_td_step = 0.005;
+  parse(config, "settings.sweep_time_offset", sweep_td, true);
+  parse(config, "settings.sweep_time_offset_step", sweep_td_step, true);
+  calib_solver_options_t solver_opts;
+  if (calib_solver_options_load(solver_opts, config_file) != 0) {
+    FATAL("Failed to load solver options!");
+  }
 
   // Calibrate camera intrinsics
   process_rosbag(train_bag_path,
@@ -808,22 +660,59 @@ int main(int argc, char *argv[]) {
 
   // Calibrate mocap object to camera transform
   dataset_t ds = process_dataset(data_path, calib_results_path, calib_target);
-  calib_mocap_marker_solve(ds.grids,
-                           ds.cam,
-                           ds.T_WM,
-                           ds.T_MC,
-                           ds.T_WF);
+  if (estimate_td) {
+    int retval = calib_mocap_marker_solve(ds.aprilgrids,
+                                          ds.body_timestamps,
+                                          ds.body_poses,
+                                          ds.cam,
+                                          ds.T_MC,
+                                          ds.T_WF,
+                                          ds.td,
+                                          td_max,
+                                          solver_opts);
+    if (retval != 0) {
+      FATAL("Failed to calibrate mocap marker!");
+    }
+
+    // Re-synchronize aprilgrids and body poses with estimated time offset
+    ds.grids.clear();
+    ds.T_WM.clear();
+    lerp_body_poses(ds.aprilgrids,
+                    ds.body_timestamps,
+                    ds.body_poses,
+                    ds.grids,
+                    ds.T_WM,
+                    (int64_t) (ds.td * 1e9));
+  } else {
+    calib_mocap_marker_solve(ds.grids,
+                             ds.cam,
+                             ds.T_WM,
+                             ds.T_MC,
+                             ds.T_WF,
+                             solver_opts);
+  }
   show_results(ds);
   save_results(calib_results_path, ds);
 
-  // // Process test ROS bag
-  // process_rosbag(test_bag_path,
-  //                test_out_path,
-  //                cam0_topic,
-  //                body0_topic,
-  //                target0_topic);
-  // loop_test_dataset(test_out_path, calib_target, ds, true, 0.0);
-  // clear_test_output();
+  // Sweep time offsets around the calibrated one on the test ROS bag
+  if (sweep_td) {
+    process_rosbag(test_bag_path,
+                   test_out_path,
+                   cam0_topic,
+                   body0_topic,
+                   target0_topic);
+    const int nb_steps = td_max / sweep_td_step;
+    std::vector<int64_t> ts_offsets;
+    for (int i = -nb_steps; i <= nb_steps; i++) {
+      ts_offsets.push_back((ds.td + i * sweep_td_step) * 1e9);
+    }
+    const int retval =
+        sweep_test_dataset(test_out_path, calib_target, ds, ts_offsets);
+    clear_test_output();
+    if (retval != 0) {
+      FATAL("Failed to sweep time offsets!");
+    }
+  }
 
   return 0;
 }